@@ -0,0 +1,123 @@
+#include "header.h"
+
+// ##################################
+// Tick jitter with and without real-time mode: runs the real ./referee on the wall clock
+// twice, first under the default scheduler and then with `realtime <spec>`, while busy
+// processes compete for the CPUs, and compares the tick periods and wake-up latencies the
+// referee reports at the end of each match. Use a config with a short tick period and
+// duration; the jitter comes from the match as it is, with its players and visualizer.
+// ##################################
+
+const char* config_path;
+const char* transport = "shm";
+
+typedef struct {
+    long periods;
+    double mean_ms, stddev_us, min_ms, max_ms;
+    long p50_us, p99_us;
+    double max_us;
+} Jitter;
+
+// Starts count processes that spin until killed
+pid_t* start_load(int count) {
+    pid_t* pids = calloc(count ? count : 1, sizeof(pid_t));
+    for (int k = 0; k < count; k++) {
+        pids[k] = fork();
+        if (pids[k] == 0) {
+            for (volatile unsigned long spin = 0;; spin++);
+        }
+    }
+    return pids;
+}
+
+void stop_load(pid_t* pids, int count) {
+    for (int k = 0; k < count; k++) {
+        kill(pids[k], SIGKILL);
+        waitpid(pids[k], NULL, 0);
+    }
+    free(pids);
+}
+
+// ##################################
+// Plays one match and reads the referee's tick jitter line off its stderr
+// ##################################
+Jitter run_referee(const char* spec) {
+    int err[2];
+    if (pipe(err) < 0) {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        close(err[0]);
+        close(err[1]);
+        if (spec) execl("./referee", "referee", config_path, transport, "output", "quiet", "realtime", spec, NULL);
+        else execl("./referee", "referee", config_path, transport, "output", "quiet", NULL);
+        perror("execl failed");
+        _exit(1);
+    }
+    close(err[1]);
+
+    FILE* in = fdopen(err[0], "r");
+    char* line = NULL;
+    size_t size = 0;
+    Jitter j;
+    int found = 0;
+    while (getline(&line, &size, in) > 0) {
+        if (sscanf(line, "Tick jitter: %ld periods, mean %lf ms, stddev %lf us, min %lf ms, max %lf ms; "
+                         "wake-up latency p50 %ld us, p99 %ld us, max %lf us",
+                   &j.periods, &j.mean_ms, &j.stddev_us, &j.min_ms, &j.max_ms, &j.p50_us, &j.p99_us, &j.max_us) == 8)
+            found = 1;
+        else if (strncmp(line, "freeglut", 8) != 0)
+            fputs(line, stderr);        // Errors, lost players; the visualizer needs no display here
+    }
+    free(line);
+    fclose(in);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!found || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Error: Referee failed (%s)\n", spec ? spec : "default scheduler");
+        exit(EXIT_FAILURE);
+    }
+    return j;
+}
+
+void report(const char* name, const Jitter* j) {
+    printf("%-10s %8ld %10.3f %12.1f %9.3f %9.3f %9ld %9ld %10.1f\n", name, j->periods, j->mean_ms, j->stddev_us,
+           j->min_ms, j->max_ms, j->p50_us, j->p99_us, j->max_us);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 5) {
+        fprintf(stderr, "Usage: %s <config_file> [realtime spec] [busy processes] [pipe|shm]\n", argv[0]);
+        return 1;
+    }
+    config_path = argv[1];
+    const char* spec = (argc > 2) ? argv[2] : "fifo";
+    int load = (argc > 3) ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 4) transport = strcmp(argv[4], "pipe") == 0 ? "pipe" : "shm";
+    if (load < 0) {
+        fprintf(stderr, "Error: busy processes must not be negative\n");
+        return 1;
+    }
+
+    printf("== tick jitter over %s with %d busy processes, realtime '%s' ==\n", transport, load, spec);
+    printf("period: time between tick starts; wake: referee wake-up after each tick deadline\n");
+    printf("%-10s %8s %10s %12s %9s %9s %9s %9s %10s\n", "mode", "periods", "mean (ms)", "stddev (us)",
+           "min (ms)", "max (ms)", "p50 wake", "p99 wake", "max wake");
+
+    pid_t* pids = start_load(load);
+    Jitter off = run_referee(NULL);
+    report("default", &off);
+    Jitter on = run_referee(spec);
+    report("realtime", &on);
+    stop_load(pids, load);
+
+    if (on.stddev_us > 0) printf("period stddev %.1fx lower in real-time mode\n", off.stddev_us / on.stddev_us);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "header.h"
+#include "constants.h"
+#include "structs.h"
+#include "config.h"
+#include "rules.h"
+#include "tick_kernel.h"
+
+// ##################################
+// Checks every batch kernel level against the scalar rules, then measures how many
+// player updates per second each level sustains on a large store.
+// ##################################
+
+GameConfig config;
+
+// Reads the player rules from a config file; the seed and team layout are fixed here
+void read_config(const char* filename) {
+    char error[256];
+    if (config_load(filename, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+    config.seed = 42;
+    config.team_size = DEFAULT_TEAM_SIZE;
+    config.num_teams = DEFAULT_NUM_TEAMS;
+}
+
+// Returns the current monotonic time in seconds
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fills a store the way the referee does: player i at position i % team_size
+void fill_store(PlayerStore* s, int players) {
+    player_store_init(s, players);
+    for (int i = 0; i < players; i++) {
+        init_player(s, i, &config, i % config.team_size, i, config.seed);
+        s->position[i] = i % config.team_size + 1;
+    }
+}
+
+int same_store(const PlayerStore* a, const PlayerStore* b, int players) {
+    size_t n = players * sizeof(int);
+    return memcmp(a->energy, b->energy, n) == 0 && memcmp(a->effort, b->effort, n) == 0 &&
+           memcmp(a->active, b->active, n) == 0 && memcmp(a->recovery, b->recovery, n) == 0 &&
+           memcmp(a->key, b->key, n) == 0 && memcmp(a->ticks, b->ticks, n) == 0;
+}
+
+// ##################################
+// Runs the scalar rules and one kernel level side by side, comparing after every tick.
+// An odd player count leaves a tail for the scalar remainder path.
+// ##################################
+int verify(KernelLevel level, int players, int ticks) {
+    PlayerStore expected, actual;
+    fill_store(&expected, players);
+    fill_store(&actual, players);
+
+    int ok = 1;
+    for (int t = 0; t < ticks && ok; t++) {
+        for (int i = 0; i < players; i++) {
+            player_round(&expected, i, &config);
+            player_effort(&expected, i);
+        }
+        tick_kernel_round(&actual, 0, players, &config, level);
+        tick_kernel_effort(&actual, 0, players);
+        if (!same_store(&expected, &actual, players)) {
+            fprintf(stderr, "%s differs from the scalar rules at tick %d\n", tick_kernel_name(level), t);
+            ok = 0;
+        }
+    }
+    player_store_free(&expected);
+    player_store_free(&actual);
+    return ok;
+}
+
+void bench(KernelLevel level, int players, int ticks) {
+    PlayerStore s;
+    fill_store(&s, players);
+
+    double start = now_sec();
+    for (int t = 0; t < ticks; t++) {
+        tick_kernel_round(&s, 0, players, &config, level);
+        tick_kernel_effort(&s, 0, players);
+    }
+    double seconds = now_sec() - start;
+
+    printf("%-8s %10d %8d %12.3f %18.0f\n", tick_kernel_name(level), players, ticks, seconds,
+           (double)players * ticks / seconds);
+    player_store_free(&s);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s <config_file> [players] [ticks]\n", argv[0]);
+        return 1;
+    }
+    read_config(argv[1]);
+    int players = (argc > 2) ? atoi(argv[2]) : 1000000;
+    int ticks = (argc > 3) ? atoi(argv[3]) : 100;
+
+    KernelLevel best = tick_kernel_best();
+    for (KernelLevel level = KERNEL_SCALAR; level <= best; level++) {
+        if (!verify(level, 10007, 500)) return 1;
+    }
+    printf("Kernels up to %s are identical to the scalar rules\n\n", tick_kernel_name(best));
+
+    printf("%-8s %10s %8s %12s %18s\n", "kernel", "players", "ticks", "seconds", "players/s");
+    for (KernelLevel level = KERNEL_SCALAR; level <= best; level++)
+        bench(level, players, ticks);
+
+    return 0;
+}
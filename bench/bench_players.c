@@ -0,0 +1,169 @@
+#include "header.h"
+#include "constants.h"
+#include "structs.h"
+#include "config.h"
+#include "coro_runtime.h"
+#include "protocol.h"
+#include <sys/resource.h>
+
+// ##################################
+// Compares the coroutine player runtime with one process per player.
+// Both are driven through the referee's tick protocol for a fixed number of ticks.
+// ##################################
+
+GameConfig config;
+
+// Reads the player rules from a config file; the seed and team layout are fixed here
+void read_config(const char* filename) {
+    char error[256];
+    if (config_load(filename, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+    config.seed = 42;
+    config.team_size = DEFAULT_TEAM_SIZE;
+    config.num_teams = DEFAULT_NUM_TEAMS;
+}
+
+// Returns the current monotonic time in seconds
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Proportional memory (PSS) of a process in KB, so shared library pages are not counted N times
+long memory_kb(pid_t pid) {
+    char path[64], line[128];
+    sprintf(path, "/proc/%d/smaps_rollup", (int)pid);
+    FILE* f = fopen(path, "r");
+    long kb = 0;
+    if (!f) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Pss: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb;
+}
+
+void report(const char* mode, int players, int ticks, double seconds, long kb) {
+    printf("%-8s %8d %12.0f %16.0f %12ld %10.1f\n", mode, players, ticks / seconds,
+           (double)ticks * players / seconds, kb, (double)kb / players);
+}
+
+// ##################################
+// Coroutine runtime: all players in this process on a pool of worker threads
+// ##################################
+void bench_coro(int players, int ticks) {
+    long before = memory_kb(getpid());
+    CoroRuntime* rt = coro_runtime_create(&config, players, 0);
+    PlayerStore* store = coro_runtime_store(rt);
+    for (int i = 0; i < players; i++) store->position[i] = i % config.team_size + 1;
+
+    double start = now_sec();
+    for (int t = 0; t < ticks; t++) {
+        coro_runtime_signal(rt, PHASE_TICK);
+        coro_runtime_wait(rt);
+    }
+    double seconds = now_sec() - start;
+    long kb = memory_kb(getpid()) - before;
+
+    coro_runtime_destroy(rt);
+    report("coro", players, ticks, seconds, kb);
+}
+
+// ##################################
+// Process per player: the real ./player binary over pipes, driven with tick requests
+// ##################################
+void bench_processes(int config_fd, int players, int ticks) {
+    pid_t* pids = malloc(players * sizeof(pid_t));
+    int (*to_player)[2] = malloc(players * sizeof(*to_player));
+    int (*from_player)[2] = malloc(players * sizeof(*from_player));
+    Message msg;
+
+    for (int i = 0; i < players; i++) {
+        if (pipe(to_player[i]) < 0 || pipe(from_player[i]) < 0) {
+            perror("pipe");
+            exit(EXIT_FAILURE);
+        }
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            char pos[16], rfd[16], wfd[16], cfd[16], slot[16];
+            sprintf(pos, "%d", i % config.team_size);
+            sprintf(rfd, "%d", to_player[i][0]);
+            sprintf(wfd, "%d", from_player[i][1]);
+            sprintf(cfd, "%d", config_fd);
+            sprintf(slot, "%d", i);
+            execl("./player", "player", pos, rfd, wfd, cfd, slot, NULL);
+            perror("execl failed");
+            exit(1);
+        }
+        close(to_player[i][0]);
+        close(from_player[i][1]);
+    }
+
+    // Wait for every player's ready message
+    for (int i = 0; i < players; i++) protocol_receive(from_player[i][0], &msg, MSG_HELLO);
+
+    double start = now_sec();
+    for (int t = 0; t < ticks; t++) {
+        for (int i = 0; i < players; i++) {
+            msg.tick.tick = t + 1;
+            msg.tick.follows = 0;
+            msg.tick.position = i % config.team_size + 1;
+            protocol_send(to_player[i][1], &msg, MSG_TICK);
+        }
+        for (int i = 0; i < players; i++) protocol_receive(from_player[i][0], &msg, MSG_REPLY);
+    }
+    double seconds = now_sec() - start;
+
+    long kb = 0;
+    for (int i = 0; i < players; i++) kb += memory_kb(pids[i]);
+
+    for (int i = 0; i < players; i++) {
+        kill(pids[i], SIGTERM);
+        close(to_player[i][1]);
+        close(from_player[i][0]);
+    }
+    for (int i = 0; i < players; i++) waitpid(pids[i], NULL, 0);
+    free(pids);
+    free(to_player);
+    free(from_player);
+
+    report("process", players, ticks, seconds, kb);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s <config_file> [ticks] [max_processes]\n", argv[0]);
+        return 1;
+    }
+    read_config(argv[1]);
+    int ticks = (argc > 2) ? atoi(argv[2]) : 200;
+    int max_processes = (argc > 3) ? atoi(argv[3]) : 256;
+
+    // Each player process needs two pipe ends in this process
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    printf("%-8s %8s %12s %16s %12s %10s\n", "mode", "players", "ticks/s", "player-ticks/s", "memory KB", "KB/player");
+
+    // Player processes read the config from a shared copy, as under the referee
+    int config_fd;
+    if (!config_share(&config, &config_fd)) {
+        perror("Failed to share config");
+        return 1;
+    }
+
+    int process_counts[] = { 8, 64, 256, 1024 };
+    for (int k = 0; k < 4 && process_counts[k] <= max_processes; k++)
+        bench_processes(config_fd, process_counts[k], ticks);
+
+    int coro_counts[] = { 8, 64, 256, 1024, 10000, 50000 };
+    for (int k = 0; k < 6; k++)
+        bench_coro(coro_counts[k], ticks);
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "header.h"
+#include "constants.h"
+#include "structs.h"
+#include "config.h"
+#include "rules.h"
+#include "tick_kernel.h"
+#include "rank_index.h"
+
+// ##################################
+// Checks the rank index against a full sort of the team after every tick, then times it
+// against re-sorting the team with qsort, for a sweep of team sizes. Ticks follow the
+// player rules (every active player tires, fallen ones recover) or change the energy of
+// a number or a share of the players, to find where the index's sort takes over (see
+// rank_index.h).
+// ##################################
+
+GameConfig config;
+
+// Reads the player rules from a config file; the seed is fixed here
+void read_config(const char* filename) {
+    char error[256];
+    if (config_load(filename, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+    config.seed = 42;
+}
+
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+const int* sort_energies;
+
+// Orders players by energy, then by player number, as the rank index does
+int compare_players(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    if (sort_energies[x] != sort_energies[y]) return sort_energies[x] < sort_energies[y] ? -1 : 1;
+    return (x > y) - (x < y);
+}
+
+// Positions from a full sort of the team
+void sort_positions(const int energies[], int order[], int positions[], int players) {
+    sort_energies = energies;
+    for (int i = 0; i < players; i++) order[i] = i;
+    qsort(order, players, sizeof(int), compare_players);
+    for (int rank = 1; rank <= players; rank++) positions[order[rank - 1]] = rank;
+}
+
+// Energy changes per tick: the player rules, a number of players, or a share of the team
+// (in per mille), changed at random
+typedef struct {
+    const char* name;
+    int players, permille;
+} Changes;
+
+void play_tick(PlayerStore* s, int players, const Changes* changes, unsigned int* rng) {
+    if (!changes->players && !changes->permille) {
+        tick_kernel_round(s, 0, players, &config, KERNEL_SCALAR);
+        return;
+    }
+    int count = changes->players ? changes->players : (int)((long)players * changes->permille / 1000);
+    for (int n = 0; n < count; n++) {
+        int i = rand_r(rng) % players;
+        s->energy[i] = rand_r(rng) % (config.energy_max + 1);
+    }
+}
+
+// ##################################
+// Plays ticks on one team with the index and with full sorts side by side. Returns 0 if
+// the positions ever differ; the seconds spent by each are added up.
+// ##################################
+int run(int players, int ticks, const Changes* changes, double* index_seconds, double* sort_seconds) {
+    PlayerStore s;
+    player_store_init(&s, players);
+    for (int i = 0; i < players; i++) init_player(&s, i, &config, i, i, config.seed);
+
+    int* expected = malloc(players * sizeof(int));
+    int* order = malloc(players * sizeof(int));
+    int* changed = malloc(players * sizeof(int));
+    char* flagged = calloc(players, 1);
+    int num_changed = 0;
+    RankIndex index;
+    if (rank_index_init(&index, players, 0, s.energy, s.position) < 0) {
+        perror("Failed to build rank index");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int rng = 7;
+    int ok = 1;
+    *index_seconds = *sort_seconds = 0;
+    for (int t = 0; t < ticks && ok; t++) {
+        play_tick(&s, players, changes, &rng);
+
+        double start = now_sec();
+        rank_index_update(&index, 0, s.energy, s.position, changed, &num_changed, flagged);
+        *index_seconds += now_sec() - start;
+        for (int c = 0; c < num_changed; c++) flagged[changed[c]] = 0;
+        num_changed = 0;
+
+        start = now_sec();
+        sort_positions(s.energy, order, expected, players);
+        *sort_seconds += now_sec() - start;
+
+        if (memcmp(expected, s.position, players * sizeof(int)) != 0) {
+            fprintf(stderr, "Rank index differs from a full sort at tick %d (%d players, changes %s)\n", t,
+                    players, changes->name);
+            ok = 0;
+        }
+    }
+
+    rank_index_free(&index);
+    player_store_free(&s);
+    free(expected);
+    free(order);
+    free(changed);
+    free(flagged);
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <config_file> [ticks]\n", argv[0]);
+        return 1;
+    }
+    read_config(argv[1]);
+    int ticks = (argc > 2) ? atoi(argv[2]) : 200;
+
+    const int sizes[] = { 4, 100, 1000, 10000, 100000 };
+    const Changes changes[] = { { "rules", 0, 0 }, { "1", 1, 0 }, { "2", 2, 0 }, { "4", 4, 0 }, { "8", 8, 0 },
+                                { "32", 32, 0 }, { "1%", 0, 10 }, { "10%", 0, 100 } };
+    printf("%-8s %10s %14s %14s\n", "changes", "players", "index (ms)", "qsort (ms)");
+    for (size_t c = 0; c < sizeof(changes) / sizeof(changes[0]); c++) {
+        for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+            double index_seconds, sort_seconds;
+            if (!run(sizes[k], ticks, &changes[c], &index_seconds, &sort_seconds)) return 1;
+            printf("%-8s %10d %14.4f %14.4f\n", changes[c].name, sizes[k], index_seconds * 1e3 / ticks,
+                   sort_seconds * 1e3 / ticks);
+        }
+    }
+    printf("\nms per tick; positions matched a full sort after every tick\n");
+    return 0;
+}
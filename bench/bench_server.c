@@ -0,0 +1,185 @@
+#include "header.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+
+// ##################################
+// Match server throughput and fairness: keeps a window of requests in flight on every
+// connection to a running match_server and reports matches per second and the turnaround
+// of each match. With a long config, the same load runs again next to one long match,
+// to show whether the short matches still get through.
+// ##################################
+
+#define WINDOW 8                // Requests in flight per connection
+#define MAX_CONNECTIONS 64
+
+const char* socket_path;
+const char* config_path;
+
+typedef struct {
+    int fd;
+    long sent, answered;
+    long* sent_ns;              // Per request id, to time its turnaround
+    char buffer[4096];
+    int length;
+} Client;
+
+long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+int connect_server() {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Failed to connect to match server");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+void send_line(int fd, const char* line) {
+    if (write(fd, line, strlen(line)) != (ssize_t)strlen(line)) {
+        perror("Failed to send request");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Sends the next match request of a client; seeds differ so every match is different
+void send_request(Client* c, int client, long per_client) {
+    char line[512];
+    long seed = (long)client * per_client + c->sent + 1;
+    snprintf(line, sizeof(line), "match %s %ld\n", config_path, seed);
+    c->sent_ns[++c->sent] = now_ns();
+    send_line(c->fd, line);
+}
+
+// Reads the replies that arrived; each one's turnaround goes into latencies
+void read_replies(Client* c, long* latencies, long* count) {
+    ssize_t n = read(c->fd, c->buffer + c->length, sizeof(c->buffer) - 1 - c->length);
+    if (n <= 0) {
+        fprintf(stderr, "Error: Match server closed the connection\n");
+        exit(EXIT_FAILURE);
+    }
+    c->length += n;
+    c->buffer[c->length] = '\0';
+
+    long now = now_ns();
+    char* start = c->buffer;
+    char* end;
+    while ((end = strchr(start, '\n')) != NULL) {
+        *end = '\0';
+        long id;
+        char* field = strstr(start, "\"id\":");
+        if (strncmp(start, "{\"event\":\"match\"", 16) != 0 || !field || sscanf(field + 5, "%ld", &id) != 1 ||
+            id < 1 || id > c->sent) {
+            fprintf(stderr, "Error: Unexpected reply %s\n", start);
+            exit(EXIT_FAILURE);
+        }
+        latencies[(*count)++] = now - c->sent_ns[id];
+        c->answered++;
+        start = end + 1;
+    }
+    c->length -= start - c->buffer;
+    memmove(c->buffer, start, c->length);
+}
+
+int compare_longs(const void* a, const void* b) {
+    return (*(const long*)a > *(const long*)b) - (*(const long*)a < *(const long*)b);
+}
+
+double percentile_ms(const long sorted[], int n, double fraction) {
+    int k = (int)(fraction * n);
+    if (k >= n) k = n - 1;
+    return sorted[k] / 1e6;
+}
+
+// ##################################
+// Plays matches over the given connections, WINDOW at a time on each
+// ##################################
+void bench(const char* label, long matches, int connections) {
+    long per_client = matches / connections;
+    Client* clients = calloc(connections, sizeof(Client));
+    struct pollfd* fds = calloc(connections, sizeof(struct pollfd));
+    long* latencies = malloc(per_client * connections * sizeof(long));
+    long count = 0;
+
+    long start = now_ns();
+    for (int k = 0; k < connections; k++) {
+        clients[k].fd = connect_server();
+        clients[k].sent_ns = malloc((per_client + 1) * sizeof(long));
+        while (clients[k].sent < per_client && clients[k].sent < WINDOW) send_request(&clients[k], k, per_client);
+        fds[k].fd = clients[k].fd;
+        fds[k].events = POLLIN;
+    }
+
+    long remaining = per_client * connections;
+    while (remaining > 0) {
+        if (poll(fds, connections, -1) < 0) continue;
+        for (int k = 0; k < connections; k++) {
+            if (!(fds[k].revents & (POLLIN | POLLHUP))) continue;
+            Client* c = &clients[k];
+            long before = c->answered;
+            read_replies(c, latencies, &count);
+            remaining -= c->answered - before;
+            while (c->sent < per_client && c->sent - c->answered < WINDOW) send_request(c, k, per_client);
+        }
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    qsort(latencies, count, sizeof(long), compare_longs);
+    printf("%-12s %8ld %10.0f %10.2f %10.2f %10.2f\n", label, count, count / seconds,
+           percentile_ms(latencies, count, 0.50), percentile_ms(latencies, count, 0.99), latencies[count - 1] / 1e6);
+
+    for (int k = 0; k < connections; k++) {
+        close(clients[k].fd);
+        free(clients[k].sent_ns);
+    }
+    free(clients);
+    free(fds);
+    free(latencies);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 6) {
+        fprintf(stderr, "Usage: %s <socket> <config_file> [matches] [connections] [long_config_file]\n", argv[0]);
+        return 1;
+    }
+    socket_path = argv[1];
+    config_path = argv[2];
+    long matches = (argc > 3) ? atol(argv[3]) : 20000;
+    int connections = (argc > 4) ? atoi(argv[4]) : 4;
+    const char* long_config = (argc > 5) ? argv[5] : NULL;
+    if (matches <= 0 || connections <= 0 || connections > MAX_CONNECTIONS || matches < connections) {
+        fprintf(stderr, "Error: matches must be at least connections, which must be 1 to %d\n", MAX_CONNECTIONS);
+        return 1;
+    }
+
+    printf("turnaround: request sent to result read, %d requests in flight per connection\n", WINDOW);
+    printf("%-12s %8s %10s %10s %10s %10s\n", "load", "matches", "matches/s", "p50 (ms)", "p99 (ms)", "max (ms)");
+    bench("short", matches, connections);
+
+    if (long_config) {
+        // One long match is started first and runs alongside the whole short load
+        int fd = connect_server();
+        char line[512];
+        snprintf(line, sizeof(line), "match %s 1\n", long_config);
+        long start = now_ns();
+        send_line(fd, line);
+        bench("short+long", matches, connections);
+
+        char reply[1024];
+        ssize_t n = read(fd, reply, sizeof(reply) - 1);
+        if (n <= 0) {
+            fprintf(stderr, "Error: No reply for the long match\n");
+            return 1;
+        }
+        reply[n] = '\0';
+        printf("long match done %.1f ms after it was sent: %s", (now_ns() - start) / 1e6, reply);
+        close(fd);
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "header.h"
+#include "structs.h"
+#include "config.h"
+#include "player_pool.h"
+
+// ##################################
+// Match startup: runs the real ./referee back to back on the virtual clock and times each
+// one from its fork to its first tick record, with players fork+exec'd per match and then
+// taken from a zygote pool (see player_pool.h). Also reports whole matches per second.
+// ##################################
+
+// Matches run before measuring, so the page cache and the pool are warm
+#define WARMUP_RUNS 3
+
+const char* config_path;
+const char* transport = "pipe";
+
+long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// ##################################
+// Plays one match and returns the nanoseconds from launching the referee to its first
+// tick record; the match is read to the end before returning
+// ##################################
+long run_referee(const char* pool_path) {
+    int out[2];
+    if (pipe(out) < 0) {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+
+    long start = now_ns();
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(out[1]);
+        if (pool_path)
+            execl("./referee", "referee", config_path, transport, "virtual", "output", "jsonl", "pool", pool_path, NULL);
+        else
+            execl("./referee", "referee", config_path, transport, "virtual", "output", "jsonl", NULL);
+        perror("execl failed");
+        _exit(1);
+    }
+    close(out[1]);
+
+    FILE* in = fdopen(out[0], "r");
+    char* line = NULL;
+    size_t size = 0;
+    long first_tick = -1;
+    while (getline(&line, &size, in) > 0) {
+        if (first_tick < 0 && strncmp(line, "{\"event\":\"tick\"", 15) == 0) first_tick = now_ns() - start;
+    }
+    free(line);
+    fclose(in);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (first_tick < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Error: Referee failed (%s)\n", pool_path ? "pool" : "exec");
+        exit(EXIT_FAILURE);
+    }
+    return first_tick;
+}
+
+// Starts `player pool` and waits until it takes connections
+pid_t start_pool(const char* path, int size) {
+    char count[16];
+    sprintf(count, "%d", size);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execl("./player", "player", "pool", path, count, NULL);
+        perror("execl failed");
+        _exit(1);
+    }
+    for (int tries = 0; tries < 5000; tries++) {
+        int fd = pool_connect(path);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        usleep(1000);
+    }
+    fprintf(stderr, "Error: Player pool did not start on %s\n", path);
+    kill(pid, SIGTERM);
+    exit(EXIT_FAILURE);
+}
+
+int compare_longs(const void* a, const void* b) {
+    return (*(const long*)a > *(const long*)b) - (*(const long*)a < *(const long*)b);
+}
+
+// Value below which the given fraction of the sorted samples fall
+double percentile_ms(const long sorted[], int n, double fraction) {
+    int k = (int)(fraction * n);
+    if (k >= n) k = n - 1;
+    return sorted[k] / 1e6;
+}
+
+void bench(const char* name, const char* pool_path, int runs) {
+    for (int r = 0; r < WARMUP_RUNS; r++) run_referee(pool_path);
+
+    long* samples = malloc(runs * sizeof(long));
+    long start = now_ns();
+    for (int r = 0; r < runs; r++) samples[r] = run_referee(pool_path);
+    double seconds = (now_ns() - start) / 1e9;
+
+    qsort(samples, runs, sizeof(long), compare_longs);
+    printf("%-8s %10.2f %10.2f %10.2f %12.1f\n", name, percentile_ms(samples, runs, 0.50),
+           percentile_ms(samples, runs, 0.90), samples[runs - 1] / 1e6, runs / seconds);
+    free(samples);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s <config_file> [runs] [pipe|shm]\n", argv[0]);
+        return 1;
+    }
+    config_path = argv[1];
+    int runs = (argc > 2) ? atoi(argv[2]) : 50;
+    if (argc > 3) transport = strcmp(argv[3], "shm") == 0 ? "shm" : "pipe";
+    if (runs <= 0) {
+        fprintf(stderr, "Error: runs must be positive\n");
+        return 1;
+    }
+
+    GameConfig config;
+    char error[256];
+    if (config_load(config_path, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
+        return 1;
+    }
+    int num_players = config.team_size * config.num_teams;
+
+    char pool_path[64];
+    sprintf(pool_path, "/tmp/rope_bench_pool_%d.sock", (int)getpid());
+    pid_t pool = start_pool(pool_path, num_players);
+
+    printf("== %d players over %s, %d matches each ==\n", num_players, transport, runs);
+    printf("launch: referee fork to first tick record; matches/s: whole matches back to back\n");
+    printf("%-8s %10s %10s %10s %12s\n", "players", "p50 (ms)", "p90 (ms)", "max (ms)", "matches/s");
+    bench("exec", NULL, runs);
+    bench("pool", pool_path, runs);
+
+    kill(pool, SIGTERM);
+    waitpid(pool, NULL, 0);
+    return 0;
+}
@@ -0,0 +1,371 @@
+#include "header.h"
+#include "constants.h"
+#include "structs.h"
+#include "config.h"
+#include "player_store.h"
+#include "protocol.h"
+#include "transport.h"
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// ##################################
+// End-to-end tick latency of the referee/player protocol: drives the real ./player
+// binary with tick requests as fast as it answers, and reports latency percentiles per
+// phase, ticks per second and context switches, for a sweep of player counts, over any
+// of the backends (pipes, shm, and Unix and TCP sockets on loopback) or all of them.
+// ##################################
+
+// Ticks played before measuring, so page faults and first wake-ups are not counted
+#define WARMUP_TICKS 20
+
+// Phases timed on every tick
+enum { FANOUT, TICK, NUM_PHASES };
+const char* phase_names[] = { "fan-out", "tick" };
+
+// Backends the players can be reached over
+enum { BACKEND_PIPE, BACKEND_SHM, BACKEND_UNIX, BACKEND_TCP, NUM_BACKENDS };
+const char* backend_names[] = { "pipe", "shm", "unix", "tcp" };
+
+GameConfig config;
+int config_fd = -1;         // Shared copy of the config the pipe and shm players read
+int backend = BACKEND_PIPE;
+int use_shm = 0;
+
+// Players of the current run; over a stream, requests go to request_fd and replies come from reply_fd
+int num_players;
+pid_t* pids;
+int* request_fd;
+int* reply_fd;
+SharedTick* tick = NULL;
+PlayerStore shared_store;
+size_t tick_size;
+
+// Reads the player rules from a config file; the seed and team layout are fixed here
+void read_config(const char* filename) {
+    char error[256];
+    if (config_load(filename, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+    config.seed = 42;
+    config.team_size = DEFAULT_TEAM_SIZE;
+    config.num_teams = DEFAULT_NUM_TEAMS;
+}
+
+long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Voluntary plus involuntary context switches of a process so far
+long context_switches(pid_t pid) {
+    char path[64], line[128];
+    sprintf(path, "/proc/%d/status", (int)pid);
+    FILE* f = fopen(path, "r");
+    long total = 0, n;
+    if (!f) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "voluntary_ctxt_switches: %ld", &n) == 1 ||
+            sscanf(line, "nonvoluntary_ctxt_switches: %ld", &n) == 1)
+            total += n;
+    }
+    fclose(f);
+    return total;
+}
+
+long own_context_switches() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// ##################################
+// Socket players connect on their own: listens on loopback (TCP on a free port), starts
+// them, and welcomes each connection with a slot, position and the settings
+// ##################################
+void connect_players() {
+    TransportAddress address;
+    char text[64], target[64];
+    if (backend == BACKEND_UNIX) sprintf(text, "/tmp/rope_bench_tick_%d.sock", (int)getpid());
+    else strcpy(text, "127.0.0.1:0");
+    transport_parse(backend_names[backend], text, &address);
+    int listen_fd = transport_listen(&address);
+    if (listen_fd < 0) {
+        perror("Failed to listen for players");
+        exit(EXIT_FAILURE);
+    }
+    if (backend == BACKEND_TCP) {
+        struct sockaddr_in bound;
+        socklen_t length = sizeof(bound);
+        getsockname(listen_fd, (struct sockaddr*)&bound, &length);
+        sprintf(target, "127.0.0.1:%d", ntohs(bound.sin_port));
+    } else {
+        strcpy(target, text);
+    }
+
+    for (int i = 0; i < num_players; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            execl("./player", "player", backend_names[backend], target, NULL);
+            perror("execl failed");
+            exit(1);
+        }
+    }
+
+    Message msg;
+    msg.welcome.config = config;
+    for (int i = 0; i < num_players; i++) {
+        int fd = transport_accept(listen_fd);
+        msg.welcome.slot = i;
+        msg.welcome.player_id = i % config.team_size;
+        if (fd < 0 || protocol_send(fd, &msg, MSG_WELCOME) < 0) {
+            perror("Failed to welcome player");
+            exit(EXIT_FAILURE);
+        }
+        request_fd[i] = reply_fd[i] = fd;
+    }
+    transport_unlisten(listen_fd, &address);
+}
+
+// ##################################
+// Starts the players the way the referee does, over pipes, one shared segment or sockets
+// ##################################
+void start_players() {
+    pids = malloc(num_players * sizeof(pid_t));
+    request_fd = malloc(num_players * sizeof(int));
+    reply_fd = malloc(num_players * sizeof(int));
+    if (backend == BACKEND_UNIX || backend == BACKEND_TCP) {
+        connect_players();
+        return;
+    }
+
+    int tick_fd = -1;
+    if (use_shm) {
+        tick_size = shared_tick_size(num_players);
+        tick_fd = memfd_create("bench_tick", 0);
+        if (tick_fd < 0 || ftruncate(tick_fd, tick_size) < 0) {
+            perror("Failed to create shared tick segment");
+            exit(EXIT_FAILURE);
+        }
+        tick = mmap(NULL, tick_size, PROT_READ | PROT_WRITE, MAP_SHARED, tick_fd, 0);
+        if (tick == MAP_FAILED) {
+            perror("Failed to map shared tick segment");
+            exit(EXIT_FAILURE);
+        }
+        memset(tick, 0, tick_size);
+        tick->num_players = num_players;
+        tick->version = PROTOCOL_VERSION;
+        tick->referee = getpid();
+        sem_init(&tick->replies, 1, 0);
+        shared_tick_attach(tick, &shared_store);
+    }
+
+    for (int i = 0; i < num_players; i++) {
+        int to_player[2], from_player[2];
+        if (!use_shm && (pipe(to_player) < 0 || pipe(from_player) < 0)) {
+            perror("pipe");
+            exit(EXIT_FAILURE);
+        }
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            char pos[16], rfd[16], wfd[16], sfd[16], cfd[16], slot[16];
+            sprintf(pos, "%d", i % config.team_size);
+            sprintf(slot, "%d", i);
+            sprintf(cfd, "%d", config_fd);
+            if (use_shm) {
+                sprintf(sfd, "%d", tick_fd);
+                execl("./player", "player", pos, "-1", "-1", cfd, slot, sfd, NULL);
+            } else {
+                sprintf(rfd, "%d", to_player[0]);
+                sprintf(wfd, "%d", from_player[1]);
+                execl("./player", "player", pos, rfd, wfd, cfd, slot, NULL);
+            }
+            perror("execl failed");
+            exit(1);
+        }
+        if (!use_shm) {
+            close(to_player[0]);
+            close(from_player[1]);
+            request_fd[i] = to_player[1];
+            reply_fd[i] = from_player[0];
+        }
+    }
+    if (use_shm) close(tick_fd);
+}
+
+// Waits for one reply (or hello) from every player
+void collect_replies(int type) {
+    if (use_shm) {
+        for (int i = 0; i < num_players; i++) {
+            while (sem_wait(&tick->replies) == -1 && errno == EINTR);
+        }
+        return;
+    }
+    Message msg;
+    for (int i = 0; i < num_players; i++) {
+        if (protocol_receive(reply_fd[i], &msg, type) <= 0) {
+            perror("Bad reply");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void stop_players() {
+    for (int i = 0; i < num_players; i++) {
+        kill(pids[i], SIGTERM);
+        if (!use_shm) {
+            close(request_fd[i]);
+            if (reply_fd[i] != request_fd[i]) close(reply_fd[i]);
+        }
+    }
+    for (int i = 0; i < num_players; i++) waitpid(pids[i], NULL, 0);
+    if (use_shm) {
+        sem_destroy(&tick->replies);
+        munmap(tick, tick_size);
+        tick = NULL;
+    }
+    free(pids);
+    free(request_fd);
+    free(reply_fd);
+}
+
+// ##################################
+// One tick of the protocol, timed phase by phase (nanoseconds)
+// ##################################
+void play_tick(int t, long sample[NUM_PHASES]) {
+    long start = now_ns();
+
+    // Every position changes, the worst case for the hand-off
+    Message msg;
+    msg.tick.tick = t + 1;
+    msg.tick.follows = 0;
+    for (int i = 0; i < num_players; i++) {
+        int position = (i + t) % config.team_size + 1;
+        if (use_shm) shared_store.position[i] = position;
+        else {
+            msg.tick.position = position;
+            protocol_send(request_fd[i], &msg, MSG_TICK);
+        }
+    }
+    if (use_shm) protocol_shm_start(tick, t + 1);
+    long fanned_out = now_ns();
+
+    collect_replies(MSG_REPLY);
+    long end = now_ns();
+
+    sample[FANOUT] = fanned_out - start;
+    sample[TICK] = end - start;
+}
+
+int compare_longs(const void* a, const void* b) {
+    return (*(const long*)a > *(const long*)b) - (*(const long*)a < *(const long*)b);
+}
+
+// Value below which the given fraction of the sorted samples fall
+double percentile_us(const long sorted[], int n, double fraction) {
+    int k = (int)(fraction * n);
+    if (k >= n) k = n - 1;
+    return sorted[k] / 1000.0;
+}
+
+// Runs one player count over the current backend; returns the median tick in microseconds
+double bench(int players, int ticks) {
+    num_players = players;
+    start_players();
+    collect_replies(MSG_HELLO);     // Every player says hello once it is ready
+
+    long sample[NUM_PHASES];
+    for (int t = 0; t < WARMUP_TICKS; t++) play_tick(t, sample);
+
+    long* samples[NUM_PHASES];
+    for (int p = 0; p < NUM_PHASES; p++) samples[p] = malloc(ticks * sizeof(long));
+
+    long switches = -own_context_switches();
+    for (int i = 0; i < num_players; i++) switches -= context_switches(pids[i]);
+    long start = now_ns();
+    for (int t = 0; t < ticks; t++) {
+        play_tick(t, sample);
+        for (int p = 0; p < NUM_PHASES; p++) samples[p][t] = sample[p];
+    }
+    double seconds = (now_ns() - start) / 1e9;
+    switches += own_context_switches();
+    for (int i = 0; i < num_players; i++) switches += context_switches(pids[i]);
+
+    stop_players();
+
+    printf("\n== %d players over %s: %.0f ticks/s, %.1f context switches/tick ==\n", players,
+           backend_names[backend], ticks / seconds, (double)switches / ticks);
+    printf("%-10s %10s %10s %10s %10s\n", "phase (us)", "p50", "p99", "p99.9", "max");
+    for (int p = 0; p < NUM_PHASES; p++) {
+        qsort(samples[p], ticks, sizeof(long), compare_longs);
+        printf("%-10s %10.1f %10.1f %10.1f %10.1f\n", phase_names[p], percentile_us(samples[p], ticks, 0.50),
+               percentile_us(samples[p], ticks, 0.99), percentile_us(samples[p], ticks, 0.999),
+               samples[p][ticks - 1] / 1000.0);
+    }
+    double median = percentile_us(samples[TICK], ticks, 0.50);
+    for (int p = 0; p < NUM_PHASES; p++) free(samples[p]);
+    return median;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 5) {
+        fprintf(stderr, "Usage: %s <config_file> [ticks] [max_players] [pipe|shm|unix|tcp|all]\n", argv[0]);
+        return 1;
+    }
+    read_config(argv[1]);
+    int ticks = (argc > 2) ? atoi(argv[2]) : 2000;
+    int max_players = (argc > 3) ? atoi(argv[3]) : 256;
+    int first = BACKEND_PIPE, last = BACKEND_PIPE;
+    if (argc > 4) {
+        if (strcmp(argv[4], "all") == 0) last = NUM_BACKENDS - 1;
+        else {
+            while (first < NUM_BACKENDS && strcmp(argv[4], backend_names[first]) != 0) first++;
+            if (first == NUM_BACKENDS) {
+                fprintf(stderr, "Error: Unknown backend '%s'\n", argv[4]);
+                return 1;
+            }
+            last = first;
+        }
+    }
+    if (ticks <= 0) {
+        fprintf(stderr, "Error: ticks must be positive\n");
+        return 1;
+    }
+
+    // Each player process needs two pipe ends in this process
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+
+    if (!config_share(&config, &config_fd)) {
+        perror("Failed to share config");
+        return 1;
+    }
+
+    printf("fan-out: positions and tick request sent to every player; tick: until the last reply\n");
+
+    int counts[] = { 2, 8, 32, 128, 512, 2048 };
+    double median[NUM_BACKENDS][6];
+    int num_counts = 0;
+    while (num_counts < 6 && counts[num_counts] <= max_players) num_counts++;
+    for (backend = first; backend <= last; backend++) {
+        use_shm = backend == BACKEND_SHM;
+        for (int k = 0; k < num_counts; k++) median[backend][k] = bench(counts[k], ticks);
+    }
+
+    // Side by side when comparing backends
+    if (first != last) {
+        printf("\n== Median tick (us) ==\n%-8s", "players");
+        for (int b = first; b <= last; b++) printf(" %10s", backend_names[b]);
+        printf("\n");
+        for (int k = 0; k < num_counts; k++) {
+            printf("%-8d", counts[k]);
+            for (int b = first; b <= last; b++) printf(" %10.1f", median[b][k]);
+            printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "structs.h"
+#include "player_store.h"
+
+// ##################################
+// Match checkpoint: the whole state of a match at a tick boundary in a small memory-mapped
+// file, so a match can go on after the referee or its host went down. It holds the
+// referee's progress and scores, the live settings (seed and reloads included) and every
+// player's full state, down to the position of its random stream, which is all a player
+// needs to play on exactly as if the match had never stopped.
+//
+// The file has two copies that saves alternate between. Each carries a sequence number
+// and a checksum, so a save cut short (or pages lost with the host) leaves the other copy
+// to resume from. Saves are plain stores into the mapping, synced to disk at most once
+// every CHECKPOINT_SYNC_MS and when the match ends.
+// ##################################
+
+#define CHECKPOINT_MAGIC 0x4b435052u    // "RPCK"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_SYNC_MS 1000
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t num_players;
+    int32_t num_teams;
+    uint64_t copy_size;         // Bytes of each copy
+} CheckpointHeader;
+
+// Where the referee is in the match
+typedef struct {
+    GameConfig config;          // Live settings, as reloaded so far
+    int32_t round;              // Round being played, or the next one
+    int32_t round_ticks;        // Ticks of it already played
+    int32_t last_winner;
+    int32_t consecutive_wins;
+    int32_t finished;           // 1 once the game is over
+    uint32_t ticks_played;      // Tick requests sent so far
+    int64_t clock_tick;         // Game clock
+} CheckpointProgress;
+
+// One copy: this header, the score of every team, then the player store
+typedef struct {
+    uint64_t seq;               // Saves before and including this one; 0 if never written
+    uint64_t checksum;          // Of everything after it in the copy
+    CheckpointProgress progress;
+} CheckpointCopy;
+
+typedef struct {
+    int fd;
+    char* map;
+    size_t length;
+    CheckpointHeader* header;
+    uint64_t seq;               // Of the newest copy
+    long synced_ms;
+} Checkpoint;
+
+// Creates (or replaces) the file for a match; returns -1 on error (errno set)
+int checkpoint_create(Checkpoint* c, const char* path, int num_players, int num_teams);
+
+// Maps an existing file for resuming, and for saving on. Returns -1 (errno set) if it
+// cannot be read, is not a checkpoint, or has no intact copy (EINVAL).
+int checkpoint_open(Checkpoint* c, const char* path);
+
+// Copies the newest intact copy out: progress, scores (num_teams) and every player,
+// each skipped when NULL
+void checkpoint_restore(const Checkpoint* c, CheckpointProgress* progress, int* scores, PlayerStore* store);
+
+// Saves the match into the older copy; returns -1 if syncing it failed (errno set)
+int checkpoint_save(Checkpoint* c, const CheckpointProgress* progress, const int* scores, const PlayerStore* store);
+
+// Syncs and unmaps the file
+void checkpoint_close(Checkpoint* c);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "structs.h"
+
+// ##################################
+// Game configuration: one parser for every program, validation, a shared copy for the
+// player processes, and a file watch so a running match can be retuned.
+//
+// The file has one setting per line, either named ("threshold = 500") in any order, or
+// positional in the original order (energy, decrease, recovery, threshold, duration,
+// rounds, then optionally tick period, seed, team size and number of teams).
+// Anything after '#' is a comment.
+// ##################################
+
+// Loads and validates a config file; returns -1 and a message in error on failure
+int config_load(const char* path, GameConfig* cfg, char* error, size_t size);
+
+// Checks every range and count; returns -1 and a message in error on failure
+int config_validate(const GameConfig* cfg, char* error, size_t size);
+
+// Sets one number by its key: a single setting ("threshold") or one end of a range
+// ("energy_min", "energy_max"). Returns -1 (errno EINVAL) for an unknown key; the
+// result is not validated.
+int config_set(GameConfig* cfg, const char* key, int value);
+
+// Copies the settings a running match can take (energy, decrease and recovery ranges,
+// win threshold) from fresh into live. Returns 1 if fresh also changes settings that
+// only apply on restart (those are left alone), else 0.
+int config_apply_live(GameConfig* live, const GameConfig* fresh);
+
+// ##################################
+// Shared copy for player processes, passed to them as a memfd. The referee writes it
+// between ticks, but a player that missed its reply deadline may still be reading, so
+// the generation works as a sequence lock: it is odd during a write, and a reader
+// copies again until it gets the same even generation before and after.
+// ##################################
+typedef struct {
+    uint32_t generation;        // Bumped twice on every update, odd while writing
+    GameConfig config;
+} SharedConfig;
+
+// Creates the shared copy and returns it mapped read-write, with its fd in fd; NULL on error
+SharedConfig* config_share(const GameConfig* cfg, int* fd);
+
+// Maps a shared copy read-only from an inherited fd (the fd is closed); NULL on error
+const SharedConfig* config_attach(int fd);
+
+// Replaces the shared copy; call only between ticks
+void config_publish(SharedConfig* shared, const GameConfig* cfg);
+
+// Copies the shared config into cfg if it changed since generation *seen
+void config_refresh(const SharedConfig* shared, GameConfig* cfg, uint32_t* seen);
+
+// ##################################
+// inotify watch on the config file. The directory is watched so editors that save by
+// renaming a new file over the old one are seen too.
+// ##################################
+typedef struct {
+    int fd;
+    char name[256];             // File name within the watched directory
+} ConfigWatch;
+
+// Returns -1 on error (errno set)
+int config_watch_start(ConfigWatch* watch, const char* path);
+
+// Without blocking: 1 if the file was written or replaced since the last call, else 0
+int config_watch_changed(ConfigWatch* watch);
+
+void config_watch_stop(ConfigWatch* watch);
+
+#endif
@@ -1,9 +1,16 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
-// Game Configuration
-#define TEAM_SIZE 4
-#define NUM_PLAYERS 8
+// Game Configuration (defaults when the config file does not set the team layout)
+#define DEFAULT_TEAM_SIZE 4
+#define DEFAULT_NUM_TEAMS 2
+
+// Timing
+#define DEFAULT_TICK_MS 1000
+#define ROUND_PAUSE_MS 3000
+
+// Per-thread data is aligned to this, so no two threads write to the same cache line
+#define CACHE_LINE 64
 
 // Terminal Colors
 #define RED     "\033[1;31m"
@@ -0,0 +1,43 @@
+#ifndef CORO_RUNTIME_H
+#define CORO_RUNTIME_H
+
+#include "structs.h"
+#include "player_store.h"
+
+// Phases a player coroutine is woken for, mirroring the requests sent to player processes
+#define PHASE_TICK 1        // Update energy, then compute effort for the position handed out
+
+// Stack size of each player coroutine (pages are only committed when touched)
+#define CORO_STACK_SIZE (32 * 1024)
+
+// ##################################
+// M:N player runtime: every player is a coroutine, and a pool of worker threads
+// runs them with work stealing. The referee drives it with the same tick protocol
+// it uses for player processes: hand out positions, start a tick, collect replies.
+// ##################################
+typedef struct CoroRuntime CoroRuntime;
+
+// Creates the players (seeded like the player processes) and starts the workers.
+// num_workers <= 0 uses one worker per online CPU.
+CoroRuntime* coro_runtime_create(const GameConfig* cfg, int num_players, int num_workers);
+
+// State of all players; the referee writes positions into it before PHASE_TICK
+PlayerStore* coro_runtime_store(CoroRuntime* rt);
+
+// Replaces the rules the players use; call only between phases
+void coro_runtime_configure(CoroRuntime* rt, const GameConfig* cfg);
+
+// Wakes every player for a phase without waiting for it to finish
+void coro_runtime_signal(CoroRuntime* rt, int phase);
+
+// Blocks until every player has finished the current phase
+void coro_runtime_wait(CoroRuntime* rt);
+
+// From the next phase on, notes when each player finishes (CLOCK_MONOTONIC ns), and
+// returns where: entry i is player i's finish of the last phase. Call between phases.
+const long* coro_runtime_time_replies(CoroRuntime* rt);
+
+// Stops the workers and frees all players
+void coro_runtime_destroy(CoroRuntime* rt);
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef HEADER_H
 #define HEADER_H
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 // Standard libraries
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,6 +24,7 @@
 #include <sys/msg.h>
 #include <sys/sem.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
 #include <semaphore.h>
 #include <pthread.h>
 
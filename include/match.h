@@ -0,0 +1,71 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "structs.h"
+#include "player_store.h"
+#include "rank_index.h"
+#include "tick_kernel.h"
+
+// ##################################
+// One headless match with the referee's rules on the virtual clock, played a tick at a
+// time with the batch kernel. All of its state is in the Match, so any number of them
+// can run side by side, be paused between ticks and picked up by another thread.
+// ##################################
+
+// What a tick ended
+#define MATCH_PLAYING   0
+#define MATCH_ROUND_END 1       // A round ended; round_winner and round_length tell how
+#define MATCH_GAME_OVER 2       // The last round ended too; final_winner and end tell how
+
+// How a game ended
+#define MATCH_END_ROUNDS      0     // Every round was played
+#define MATCH_END_TWO_IN_ROW  1     // A team won two rounds in a row
+#define MATCH_END_OUT_OF_TIME 2     // The game duration ran out (a tie)
+
+typedef struct {
+    GameConfig config;
+    int num_players;
+    long game_ticks;            // Game duration in ticks
+    int pause_ticks;            // Pause between rounds in ticks
+    KernelLevel kernel;
+
+    PlayerStore store;
+    RankIndex* ranks;
+    int* changed;
+    int num_changed;
+    char* flagged;
+    int* was_active;
+    int* totals;                // Team efforts of the last tick
+    int* scores;                // Rounds won per team
+
+    // Progress of the current game
+    unsigned int seed;
+    int round;
+    int round_ticks;
+    long clock_ticks;
+    int last_winner;
+    int consecutive_wins;
+    long falls;
+
+    // Result of the last round and of the game
+    int round_winner;           // Team number or 0
+    int round_length;           // Ticks
+    int final_winner;           // Team number or 0
+    int end;                    // MATCH_END_*
+} Match;
+
+// Allocates a match for a config; returns -1 on error (errno set)
+int match_init(Match* m, const GameConfig* cfg, KernelLevel kernel);
+void match_free(Match* m);
+
+// Sets up a new game with the given seed; the same match can play any number of games
+int match_start(Match* m, unsigned int seed);
+
+// Plays one tick; returns MATCH_PLAYING, MATCH_ROUND_END or MATCH_GAME_OVER
+int match_tick(Match* m);
+
+// Seed of game number n of a series started from seed, spread over the seed space so
+// neighbouring games do not share streams
+unsigned int match_seed(unsigned int seed, long n);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include "player_store.h"
+
+// ##################################
+// Live referee metrics in Prometheus text format. The referee thread is the only writer:
+// every update is a relaxed load and store, with no locks and no system calls. A
+// background thread serves a snapshot to each client of a Unix domain socket, e.g.
+//   curl --unix-socket /tmp/rope.sock http://localhost/metrics
+// ##################################
+
+// Timed phases of a tick
+#define METRIC_PHASE_RANKING  0  // Re-ranking positions
+#define METRIC_PHASE_EXCHANGE 1  // Tick requests until the last reply
+#define METRIC_PHASE_TICK     2  // Whole tick
+#define METRIC_PHASES         3
+
+typedef struct Metrics Metrics;
+
+// Starts serving on a socket path (replacing a stale socket); NULL on error (errno set)
+Metrics* metrics_create(const char* socket_path, int num_players, int num_teams, const char* transport);
+void metrics_destroy(Metrics* m);
+
+// Monotonic clock in nanoseconds, for timing phases
+long metrics_now_ns(void);
+
+// A tick started; missed counts deadlines skipped before it
+void metrics_tick(Metrics* m, long missed);
+void metrics_phase(Metrics* m, int phase, long ns);
+
+// The reply of the player in slot arrived ns after its tick request was sent; counted
+// in the histogram of all replies and in the slot's own sum, count and maximum
+void metrics_reply(Metrics* m, int slot, long ns);
+
+// The referee had to block while waiting for replies
+void metrics_reply_wait(Metrics* m);
+
+// count players had not replied by the tick's reply deadline
+void metrics_late(Metrics* m, int count);
+
+// A lost player process was replaced
+void metrics_restart(Metrics* m);
+void metrics_positions_sent(Metrics* m, int count);
+
+// Counts falls and recoveries from the energies after a tick
+void metrics_players(Metrics* m, const PlayerStore* store);
+
+// A round ended with winner (0 = none) and the scores so far
+void metrics_round(Metrics* m, int round, int winner, const int scores[]);
+
+// Writes the current values in Prometheus text format
+void metrics_write(Metrics* m, FILE* out);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <stdio.h>
+#include "structs.h"
+#include "player_store.h"
+
+// ##################################
+// Asynchronous match output. The referee hands over raw records (tick, round result,
+// game over) through a single-producer ring; a background thread formats and writes
+// them, so the tick loop never waits on a terminal or a log collector. When the ring
+// is full, tick records are dropped and counted rather than blocking the referee;
+// round and game records always get through.
+// ##################################
+
+typedef enum { OUTPUT_HUMAN, OUTPUT_CSV, OUTPUT_JSONL, OUTPUT_QUIET } OutputFormat;
+
+// Why a round stopped
+#define ROUND_END_THRESHOLD 0   // A team reached the win threshold
+#define ROUND_END_DURATION  1   // The game ran out of time in the middle of the round
+
+// What happens after a round
+#define ROUND_NEXT_CONTINUE    0
+#define ROUND_NEXT_TWO_IN_ROW  1   // The winner took two rounds in a row, the game ends
+#define ROUND_NEXT_OUT_OF_TIME 2   // The game ran out of time, it ends with a tie
+
+// Setup of a match, shown once before its first tick (strings are copied)
+typedef struct {
+    unsigned int seed;
+    const char* transport;
+    const char* bus_name;
+    const char* metrics_path;   // NULL when not serving metrics
+    const char* kernel;         // Batch kernel in use, or NULL
+} OutputStart;
+
+// Result of a round
+typedef struct {
+    int round;
+    int ticks;                  // Ticks played in the round
+    int winner;                 // Team number or 0
+    int end;                    // ROUND_END_*
+    int next;                   // ROUND_NEXT_*
+    long clock_tick;
+    long exchange_us;           // Average tick exchange
+    long length_ms;
+    long missed;                // Tick deadlines missed in the round
+    long late;                  // Replies missing at their reply deadline, over the round
+    long restarted;             // Lost player processes replaced in the round
+} OutputRound;
+
+typedef struct OutputSink OutputSink;
+
+// Parses "human", "csv", "jsonl" or "quiet"; returns -1 for anything else
+int output_format_parse(const char* name);
+
+// Starts the writer thread on out; NULL on error (errno set)
+OutputSink* output_sink_create(OutputFormat format, FILE* out, const GameConfig* cfg, int num_players);
+
+void output_start(OutputSink* sink, const OutputStart* start);
+void output_tick(OutputSink* sink, int round, int tick, long clock_tick, const PlayerStore* store);
+void output_round(OutputSink* sink, const OutputRound* result, const PlayerStore* store);
+void output_game_over(OutputSink* sink, int winner, long clock_tick);
+
+// Writes everything still queued, then stops the thread
+void output_sink_close(OutputSink* sink);
+
+#endif
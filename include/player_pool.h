@@ -0,0 +1,47 @@
+#ifndef PLAYER_POOL_H
+#define PLAYER_POOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// ##################################
+// Zygote pool of player processes. `player pool <socket> [size]` keeps size players
+// forked and initialized (binary loaded, handlers installed, pages touched), waiting on
+// a Unix socket. A referee started with `pool <socket>` hands each slot of its match to
+// one of them instead of fork+exec: it sends an assignment with the slot's descriptors,
+// the pool passes it on to an idle player and answers with that player's pid. The player
+// plays the match exactly as an exec'd one would, then resets and goes back to the pool.
+//
+// Messages are SOCK_SEQPACKET datagrams; descriptors travel with them as SCM_RIGHTS.
+// ##################################
+
+#define POOL_DEFAULT_SIZE 16
+#define POOL_MAX_FDS 3
+
+// One slot of a match, sent with its descriptors: the shared config, then the shared tick
+// segment (shm) or the player's read and write pipe ends (pipes)
+typedef struct {
+    int32_t slot;
+    int32_t player_id;          // Position within its team
+    int32_t shm;                // 1: config and shm fds, 0: config, read and write fds
+} PoolAssignment;
+
+// The pool's answer to an assignment
+typedef struct {
+    int32_t slot;
+    int32_t pid;                // Player now on the slot, or -1
+    int32_t error;              // errno when pid is -1
+} PoolLease;
+
+// Connects to a pool; returns the socket or -1 (errno set)
+int pool_connect(const char* path);
+
+// Sends one message with num_fds descriptors; returns -1 on error
+int pool_send(int fd, const void* msg, size_t size, const int fds[], int num_fds);
+
+// Receives one message of exactly size bytes and up to POOL_MAX_FDS descriptors into fds
+// (count in num_fds): 1 when received, 0 when the peer closed, -1 on error (EPROTO for a
+// message of another size, whose descriptors are closed)
+int pool_receive(int fd, void* msg, size_t size, int fds[], int* num_fds);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PLAYER_STORE_H
+#define PLAYER_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "structs.h"
+
+// Arrays in the store start on their own cache line
+#define STORE_ALIGN 64
+
+// ##################################
+// Structure-of-arrays player state used by the referee, the players and the visualizer.
+// Players are stored team by team: player i is in team i / team_size at position
+// i % team_size. Every field is one contiguous array so per-tick passes stay cache friendly.
+// ##################################
+typedef struct {
+    int num_players;
+    int* energy;
+    int* effort;
+    int* position;
+    int* active;
+    int* recovery;          // Ticks of recovery left while fallen (0 = not drawn yet)
+    unsigned int* key;      // Random stream of each player (see player_draw)
+    unsigned int* ticks;    // Ticks the player has played, the counter of its stream
+} PlayerStore;
+
+// Bytes needed to hold the arrays of num_players players
+size_t player_store_size(int num_players);
+
+// Lays the arrays out in an existing block of player_store_size() bytes (e.g. shared memory)
+void player_store_attach(PlayerStore* store, void* memory, int num_players);
+
+// Allocates a zeroed store of its own; returns -1 when out of memory
+int player_store_init(PlayerStore* store, int num_players);
+void player_store_free(PlayerStore* store);
+
+// Copies every player of from into to (both hold the same number of players)
+void player_store_copy(PlayerStore* to, const PlayerStore* from);
+
+// Bytes of a shared tick segment for num_players: the SharedTick header, the store, the
+// number of the last tick each player answered, then when it answered
+size_t shared_tick_size(int num_players);
+
+// Attaches the store that follows the SharedTick header
+void shared_tick_attach(SharedTick* tick, PlayerStore* store);
+
+// Last tick answered by each player, written before its post on the replies semaphore
+uint32_t* shared_tick_replies(SharedTick* tick);
+
+// CLOCK_MONOTONIC nanoseconds of each player's last answer, written just before its tick
+int64_t* shared_tick_reply_times(SharedTick* tick);
+
+#endif
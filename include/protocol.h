@@ -0,0 +1,153 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include "structs.h"
+
+// ##################################
+// Referee/player tick protocol: one request and one reply per player and tick.
+// The request carries the tick number and the position the referee ranked the player
+// at from the previous tick's energies; the player updates its energy, computes its
+// effort at that position and replies with both, plus the rest of its state, so the
+// referee holds every player's full state (for checkpoints, see checkpoint.h). Players
+// block on their channel between ticks, so there are no signals in the tick path.
+//
+// Over the stream links (pipes, Unix and TCP sockets, see transport.h) every message is
+// a frame: a header with magic, version, type and payload length, then the payload.
+// Every field is a 32-bit word (the header's version and type 16-bit) in network byte
+// order, so players on other hosts can take part. Frames queued together go out in one
+// write (well under PIPE_BUF, so atomic on a pipe, and one segment on TCP).
+// Over shm the positions and replies live in the shared store, and the request is the
+// tick number in the SharedTick header, which players wait on with a futex.
+//
+// Local players read the settings from the referee's shared copy (config.h). Players on
+// sockets get them in the welcome frame, and a config frame follows the next tick request
+// after the referee reloaded its file. A player taking over a slot mid-match (a resumed
+// match, or a replacement for a lost player) gets a state frame the same way, and goes
+// on from there. With shm it finds its state in the store.
+// ##################################
+
+#define PROTOCOL_MAGIC   0x45504f52u    // "ROPE"
+#define PROTOCOL_VERSION 3
+
+// Message types
+#define MSG_HELLO 1     // Player -> referee once, when ready for the first tick
+#define MSG_TICK  2     // Referee -> player: play a tick
+#define MSG_REPLY 3     // Player -> referee: the tick's energy and effort
+#define MSG_WELCOME 4   // Referee -> socket player once connected: slot, position and settings
+#define MSG_CONFIG 5    // Referee -> socket player: new settings, after a flagged tick request
+#define MSG_STATE 6     // Referee -> player: the state to go on from, after a flagged tick request
+
+// Frames that follow a tick request, to apply before playing it
+#define FOLLOWS_CONFIG 1
+#define FOLLOWS_STATE  2
+
+// Tick number that ends the match over shm, for players that outlive it (see player_pool.h);
+// over pipes the referee closes the pipe instead
+#define PROTOCOL_TICK_STOP 0xffffffffu
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t length;            // Payload bytes after the header
+} FrameHeader;
+
+typedef struct {
+    int32_t slot;
+    int32_t player_id;
+} HelloMessage;
+
+typedef struct {
+    uint32_t tick;              // Ticks played in the match, from 1
+    int32_t position;           // Position for this tick's effort
+    int32_t follows;            // FOLLOWS_* frames that come next, in that order
+} TickMessage;
+
+typedef struct {
+    uint32_t tick;              // Echo of the request
+    int32_t energy;
+    int32_t effort;
+    int32_t active;
+    int32_t recovery;
+    uint32_t ticks;             // Ticks played, the counter of the player's random stream
+} ReplyMessage;
+
+typedef struct {
+    int32_t energy;
+    int32_t active;
+    int32_t recovery;
+    uint32_t ticks;
+} StateMessage;
+
+typedef struct {
+    GameConfig config;
+} ConfigMessage;
+
+typedef struct {
+    int32_t slot;
+    int32_t player_id;          // Position within its team
+    GameConfig config;
+} WelcomeMessage;
+
+typedef struct {
+    FrameHeader header;
+    union {
+        HelloMessage hello;
+        TickMessage tick;
+        ReplyMessage reply;
+        ConfigMessage config;
+        WelcomeMessage welcome;
+        StateMessage state;
+    };
+} Message;
+
+// Frames waiting to be written together
+#define FRAME_BATCH_SIZE 256
+typedef struct {
+    size_t length;
+    char data[FRAME_BATCH_SIZE];
+} FrameBatch;
+
+// Frames msg as the given type and appends it to batch (which must have room)
+void protocol_queue(FrameBatch* batch, const Message* msg, int type);
+
+// Writes every queued frame with one write and empties batch; returns -1 on error
+int protocol_flush(int fd, FrameBatch* batch);
+
+// Frames msg as the given type and writes it; returns -1 on error
+int protocol_send(int fd, Message* msg, int type);
+
+// Reads one frame of the expected type: 1 when read, 0 at end of file, -1 on error.
+// A frame with another magic, version, type or length fails with errno EPROTO;
+// a signal before the first byte fails with EINTR.
+int protocol_receive(int fd, Message* msg, int type);
+
+// A frame arriving in pieces on a non-blocking descriptor, kept between reads
+typedef struct {
+    size_t got;                 // Bytes of the frame so far
+    Message msg;
+} FrameReader;
+
+// Reads what has arrived of a frame of the expected type into reader, without blocking:
+// 1 once the frame is whole (in reader->msg, and the reader starts over for the next),
+// 0 at end of file before the frame began, -1 on error as protocol_receive, or with errno
+// EAGAIN while part of it is still missing
+int protocol_receive_part(int fd, FrameReader* reader, int type);
+
+// Shared-memory channel: starts tick number t for every player waiting on the segment
+void protocol_shm_start(SharedTick* tick, uint32_t t);
+
+// How often a player waiting for a tick over shm checks that the referee is still there
+#define PROTOCOL_SHM_CHECK_MS 200
+
+// Opens a pidfd on the referee that created the segment, for protocol_shm_wait; -1 if
+// there is none (no pid in the segment, or a kernel before Linux 5.3)
+int protocol_shm_referee(const SharedTick* tick);
+
+// Blocks until a tick after last starts and returns its number; 0 if a signal came first.
+// Every PROTOCOL_SHM_CHECK_MS it checks on the referee (its pidfd, or with referee -1 the
+// pid in the segment) and returns PROTOCOL_TICK_STOP once the referee is gone.
+uint32_t protocol_shm_wait(SharedTick* tick, uint32_t last, int referee);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef RANK_INDEX_H
+#define RANK_INDEX_H
+
+// ##################################
+// Incremental position ranking for one team: an order-statistic treap keyed by
+// (energy, player), so equal energies are ranked by player number. A player's
+// position is its rank, 1 for the lowest energy.
+//
+// A team is re-ranked once per tick. When few players changed energy, each is moved
+// in the treap in O(log n) and only the ranks between old and new places are walked,
+// O(c log n + m) for c changed players and m ranks passed over. With more than
+// RANK_SPARSE_MAX changed players, as on most ticks when every active player tires, the
+// team is ranked with one counting sort over its energy range instead, O(n) (a qsort when
+// the range is wide), and the treap is only rebuilt from that order, in O(n), on the next
+// tick with few changes. The cutoff comes from bench/bench_rank.c: the ranks a moved
+// player passes over are walked through the treap, which outweighs the linear sort at
+// about as many changed players on teams of 100 as of 100 000.
+// ##################################
+#define RANK_SPARSE_MAX 4
+
+typedef struct {
+    int size;
+    int root;
+    int* left;
+    int* right;
+    int* count;             // Nodes in the subtree
+    unsigned int* priority;
+    int* energy;            // Energy the player is currently ranked with
+    unsigned int rng;
+    int* moved;             // Scratch: players that changed
+    unsigned long long* keys;   // Scratch: sort keys, or rank spans to walk
+    int* order;             // Players in rank order after a sort; the treap is rebuilt from it
+    int stale;              // The treap lags behind order[]
+    int* counts;            // Counting sort buckets, one per energy in the range
+    long counts_size;
+} RankIndex;
+
+// The index covers players base .. base + size - 1 of the energies[] and positions[]
+// arrays; inside the index they are numbered from 0.
+
+// Builds the index over a team's energies and writes every position
+int rank_index_init(RankIndex* index, int size, int base, const int energies[], int positions[]);
+void rank_index_free(RankIndex* index);
+
+// Re-ranks the team by energies[base ..]. Every player whose position moves gets its new
+// position written and, unless already flagged, is appended to changed[] and flagged.
+void rank_index_update(RankIndex* index, int base, const int energies[], int positions[],
+                       int changed[], int* num_changed, char flagged[]);
+
+#endif
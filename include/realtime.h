@@ -0,0 +1,87 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+// ##################################
+// Real-time mode, for ticks that keep time whatever else the host is doing. The referee
+// and each player process are pinned to CPUs of their own from a list, and run under
+// SCHED_FIFO or SCHED_DEADLINE; memory is locked and prefaulted so no tick waits on a
+// page fault. It takes a spec of comma-separated items, e.g. "cpus=2-5,spread,fifo":
+//
+//   cpus=<list>       CPUs to use ("2-5", "1,3,5-7"). The first is the referee's, the rest
+//                     the players'; with a single CPU they all share it. Default: no pinning.
+//   packed|spread     Players on the same CPU as their neighbours in slot order (packed),
+//                     or dealt out to the CPUs in turn (spread, the default)
+//   fifo|deadline|other
+//                     Scheduling policy (default fifo). Under fifo the referee runs at
+//                     priority, the players one tier below, so the referee always gets to
+//                     start a tick but yields the CPU whenever it waits for replies.
+//                     Under deadline each process gets budget every tick period.
+//   priority=<n>      Referee's SCHED_FIFO priority, 2-99 (default 50)
+//   budget=<us>       SCHED_DEADLINE runtime per tick (default 1000)
+//   nolock            Leave memory unlocked
+//
+// Raising the policy needs CAP_SYS_NICE or an RLIMIT_RTPRIO, locking memory CAP_IPC_LOCK
+// or a large enough RLIMIT_MEMLOCK. The policy is reset on fork, so processes the referee
+// forks later (restarted players) start under the default scheduler until placed.
+// ##################################
+
+#define REALTIME_ENV "ROPE_REALTIME"        // Tells player processes to lock their memory
+#define REALTIME_MAX_CPUS 256
+#define REALTIME_STACK_PREFAULT (256 * 1024)
+
+typedef enum {
+    REALTIME_OTHER,
+    REALTIME_FIFO,
+    REALTIME_DEADLINE
+} RealtimePolicy;
+
+typedef struct {
+    int cpus[REALTIME_MAX_CPUS];
+    int num_cpus;               // 0: no pinning
+    int packed;
+    RealtimePolicy policy;
+    int priority;
+    long budget_us;
+    int lock_memory;
+} RealtimeConfig;
+
+// Parses a spec as above; returns -1 and a message in error on failure
+int realtime_parse(const char* spec, RealtimeConfig* rt, char* error, size_t size);
+
+// Pins and schedules the calling thread as the referee; returns -1 on error (errno set)
+int realtime_place_referee(const RealtimeConfig* rt, long period_ns);
+
+// Pins and schedules player process pid of the given slot; returns -1 on error (errno set)
+int realtime_place_player(const RealtimeConfig* rt, pid_t pid, int slot, int num_players, long period_ns);
+
+// Locks all memory, present and future, keeps freed heap from going back to the kernel,
+// and prefaults REALTIME_STACK_PREFAULT of stack; returns -1 on error (errno set)
+int realtime_lock_memory(void);
+
+// ##################################
+// Tick jitter on the real clock: the spread of the periods between tick starts, and how
+// late the referee woke up after each tick deadline
+// ##################################
+
+#define JITTER_LATENCY_BUCKETS 10000        // Wake-up latencies in 1 us buckets; later ones go in the last
+
+typedef struct {
+    long periods;
+    double sum, sum_squares;    // Of the periods, in ns
+    long min_period, max_period;
+    long last_start;            // Monotonic ns of the last tick start, 0 before the first
+    long wakeups;
+    long latency_us[JITTER_LATENCY_BUCKETS];
+    long max_latency;           // ns
+} TickJitter;
+
+// A tick started at now after its deadline (both monotonic ns)
+void tick_jitter_add(TickJitter* j, long now, long deadline);
+
+// Writes one summary line; nothing before two ticks
+void tick_jitter_print(const TickJitter* j, FILE* out);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stddef.h>
+#include "structs.h"
+#include "player_store.h"
+
+// ##################################
+// Binary match recording: a header (config, seed, team layout), one fixed-size frame
+// per tick with the PlayerStats of every player, then a round index. Frames all have
+// the same size, so tick k is at a fixed offset and a mapped file seeks in O(1).
+// ##################################
+
+#define RECORDING_MAGIC "ROPEREC"
+#define RECORDING_VERSION 1
+
+typedef struct {
+    char magic[8];
+    int version;
+    int num_players;
+    GameConfig config;          // Includes the seed and the team layout
+    int num_frames;
+    int num_rounds;
+    long index_offset;          // Round index; 0 while the match is still being recorded
+    int final_winner;           // Team number, 0 for a tie
+} RecordingHeader;
+
+// One tick; followed by the PlayerStats of every player
+typedef struct {
+    int round;
+    int tick;                   // Tick within the round, from 1
+    long clock_tick;            // Game clock when the tick was played
+} RecordFrame;
+
+// Where each round starts in the frames and how it ended
+typedef struct {
+    int first_frame;
+    int num_frames;
+    int winner;                 // Team number, 0 if nobody won the round
+    int reserved;
+} RoundEntry;
+
+// Writer used by the referee; frames are appended through a stdio buffer
+typedef struct {
+    FILE* file;
+    RecordingHeader header;
+    size_t frame_size;
+    PlayerStats* stats;         // One frame's worth of players, reused
+    RoundEntry* rounds;
+    int round_start;
+} Recording;
+
+// Reader: the whole file mapped read-only
+typedef struct {
+    const RecordingHeader* header;
+    const char* frames;
+    const RoundEntry* rounds;
+    size_t frame_size;
+    size_t length;
+    int num_frames;
+    int num_rounds;
+} Replay;
+
+// Creates the file and writes the header; returns -1 on error (errno set)
+int recording_create(Recording* rec, const char* path, const GameConfig* cfg, int num_players);
+
+// Appends the state of every player after a tick's effort phase
+void recording_frame(Recording* rec, int round, int tick, long clock_tick, const PlayerStore* store);
+
+// Closes the current round, covering the frames since the previous one
+void recording_round(Recording* rec, int winner);
+
+// Writes the round index and the final header
+void recording_close(Recording* rec, int final_winner);
+
+// Maps a recording; returns -1 if it cannot be read or is not a recording.
+// An unfinished recording (no index) still replays the frames it has.
+int replay_open(Replay* rep, const char* path);
+void replay_close(Replay* rep);
+
+// Frame k (0 .. num_frames - 1) and its players
+const RecordFrame* replay_frame(const Replay* rep, int k);
+const PlayerStats* replay_players(const RecordFrame* frame);
+
+// Frame where round r (1 .. num_rounds) starts
+const RoundEntry* replay_round(const Replay* rep, int r);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ##################################
+// Content-addressed cache of simulation results on disk. An entry is found by the hash
+// of its key (every input that decides the result: settings, seeds, rules version), and
+// lives in <dir>/<first two hex digits>/<hash>. The file holds the key itself as well, so
+// a hash collision reads as a miss rather than someone else's result. Entries are
+// written to a temporary file and renamed into place, so any number of threads and
+// processes can share a cache directory.
+// ##################################
+
+#define RESULT_CACHE_MAGIC 0x48434552u      // "RECH"
+#define RESULT_CACHE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key_size;
+    uint32_t value_size;
+} ResultCacheHeader;
+
+// 64-bit FNV-1a of a key
+uint64_t result_cache_hash(const void* key, size_t key_size);
+
+// Creates the cache directory if needed; returns -1 on error (errno set)
+int result_cache_open(const char* dir);
+
+// Reads the value stored under key into value; returns 1 if found, 0 if not
+int result_cache_get(const char* dir, const void* key, size_t key_size, void* value, size_t value_size);
+
+// Stores value under key, replacing any older entry; returns -1 on error (errno set)
+int result_cache_put(const char* dir, const void* key, size_t key_size, const void* value, size_t value_size);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "structs.h"
+#include "player_store.h"
+
+// Player rules shared by the player process and the in-process coroutine runtime.
+// Each rule works on one player of a store. Random numbers are counter based: a draw
+// is a hash of the player's key, the tick and the draw number within the tick, so
+// any draw of any player can be recomputed directly from (seed, slot, tick).
+
+// Bumped whenever a change to the rules (or to the referee's scoring in match.c) changes
+// how a seeded game plays out, so results cached under the old rules are not reused
+#define RULES_VERSION 1
+
+// Constants of the counter hash
+#define RULES_HASH_MUL1 0x7feb352du
+#define RULES_HASH_MUL2 0x846ca68bu
+#define RULES_TICK_MUL 0x9e3779b9u
+#define RULES_DRAW_MUL 0x85ebca6bu
+
+// Chance (in percent) that an active player falls on a tick
+#define FALL_CHANCE 5
+
+// Key of the player in a slot for a master seed
+unsigned int player_key(unsigned int seed, int slot);
+
+// Draw number `draw` of a player's stream at a tick (tick 0 is the starting energy)
+unsigned int player_draw(unsigned int key, unsigned int tick, unsigned int draw);
+
+// Maps a draw onto min .. max by multiply and shift (no modulo bias worth mentioning)
+int draw_range(unsigned int value, int min, int max);
+
+// Keys player i of the store and picks its starting energy: the player_id-th smallest
+// of team_size draws, so energy grows with the position within the team
+void init_player(PlayerStore* s, int i, const GameConfig* cfg, int player_id, int slot, unsigned int seed);
+
+// One tick: lose energy, maybe fall, or count down recovery
+void player_round(PlayerStore* s, int i, const GameConfig* cfg);
+
+// Effort for the position stored for the player (0 while fallen)
+int player_effort(PlayerStore* s, int i);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef STATE_BUS_H
+#define STATE_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "structs.h"
+#include "player_store.h"
+
+// ##################################
+// Shared-memory state bus: the referee publishes a snapshot of every player after each
+// tick into a ring of slots, and any number of readers (visualizer, loggers, metrics)
+// map the same segment read-only. Each slot is a seqlock: the publisher never waits
+// for readers, and a reader that falls a whole ring behind skips ahead instead.
+// ##################################
+
+#define STATE_BUS_MAGIC "ROPEBUS"
+#define STATE_BUS_SLOTS 64
+
+// What a snapshot marks
+#define BUS_TICK      1     // Players after a tick's effort phase
+#define BUS_ROUND_END 2     // Final state of a round; winner is the round winner
+#define BUS_GAME_OVER 3     // winner is the final winner (round and tick are 0)
+
+typedef struct {
+    char magic[8];
+    int num_players;
+    int team_size;
+    int num_teams;
+    int slots;
+    size_t slot_size;
+    _Atomic uint64_t head;      // Snapshots published so far
+} StateBusHeader;
+
+// Snapshot header; the PlayerStats of every player follow it in the slot
+typedef struct {
+    int event;
+    int round;
+    int tick;                   // Tick within the round, from 1
+    int winner;                 // Team number or 0, for BUS_ROUND_END and BUS_GAME_OVER
+    long clock_tick;
+} BusSnapshot;
+
+typedef struct {
+    StateBusHeader* header;
+    size_t length;
+    int owner;                  // The publisher removes the segment name on close
+    char name[64];
+} StateBus;
+
+// A reader's position in the stream
+typedef struct {
+    StateBus* bus;
+    uint64_t next;              // Sequence number of the next snapshot to read
+    long skipped;               // Snapshots overwritten before this reader got to them
+} BusReader;
+
+// Creates the named segment (e.g. "/rope_bus_<pid>"); returns -1 on error (errno set)
+int state_bus_create(StateBus* bus, const char* name, const GameConfig* cfg, int num_players);
+
+// Attaches a reader to an existing segment; returns -1 on error
+int state_bus_open(StateBus* bus, const char* name);
+void state_bus_close(StateBus* bus);
+
+// Publishes the current state of every player
+void state_bus_publish(StateBus* bus, int event, int round, int tick, int winner, long clock_tick,
+                       const PlayerStore* store);
+
+// Starts at the oldest snapshot still in the ring
+void bus_reader_init(BusReader* reader, StateBus* bus);
+
+// Copies the next snapshot and its players (num_players entries) without blocking;
+// returns 1 if there was one, 0 if the reader is up to date
+int bus_reader_next(BusReader* reader, BusSnapshot* snapshot, PlayerStats stats[]);
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef STRUCTS_H
 #define STRUCTS_H
 
+#include <semaphore.h>
+#include <stdint.h>
+#include "constants.h"
+
 // Game Configuration Struct
 typedef struct {
     int energy_min, energy_max;
@@ -9,9 +13,13 @@ typedef struct {
     int win_threshold;
     int game_duration;
     int rounds_to_win;
+    int tick_ms;
+    unsigned int seed;
+    int team_size;
+    int num_teams;
 } GameConfig;
 
-// Stats exchanged between referee and players
+// Stats of one player, as published on the state bus and saved in recordings
 typedef struct {
     int player_id;
     int position;
@@ -19,16 +27,15 @@ typedef struct {
     int effort;
 } PlayerStats;
 
-// Player internal state
+// Shared-memory tick exchange (used instead of the pipes when transport is "shm").
+// The header is followed by the player store of the whole match and the tick each player
+// last answered, see player_store.h.
 typedef struct {
-    int player_id;
-    int position;
-    int energy;
-    int effort;
-    int read_fd;
-    int write_fd;
-    int active;
-    int recovering;
-} Player;
+    sem_t replies;                      // Posted once by every player after each tick
+    int num_players;
+    int version;                        // PROTOCOL_VERSION of the referee
+    uint32_t tick;                      // Tick being played, a futex word (see protocol.h)
+    int32_t referee;                    // Referee's pid, so waiting players notice it is gone
+} SharedTick;
 
 #endif
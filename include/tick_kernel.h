@@ -0,0 +1,26 @@
+#ifndef TICK_KERNEL_H
+#define TICK_KERNEL_H
+
+#include "structs.h"
+#include "player_store.h"
+
+// Instruction sets the batch kernel can run on
+typedef enum { KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX2 } KernelLevel;
+
+// ##################################
+// Batch version of the per-tick player rules (player_round / player_effort in rules.h)
+// over contiguous store arrays. Every lane computes its player's counter-based draws,
+// so the results are bit-identical to running the scalar rules player by player.
+// ##################################
+
+// Best level this CPU supports
+KernelLevel tick_kernel_best(void);
+const char* tick_kernel_name(KernelLevel level);
+
+// One tick (energy, fall, recovery) for players first .. first + count - 1
+void tick_kernel_round(PlayerStore* s, int first, int count, const GameConfig* cfg, KernelLevel level);
+
+// Effort of players first .. first + count - 1 from their stored positions
+void tick_kernel_effort(PlayerStore* s, int first, int count);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// ##################################
+// Cross-process tracing. Every process of a match (referee, players, visualizer) records
+// trace points into a buffer of its own: a file in the trace directory, mapped shared,
+// that threads append to by claiming slots with one atomic add. Timestamps are taken on
+// CLOCK_MONOTONIC, which every process on the host shares, so the buffers line up. At
+// the end of the match the referee merges them into one Chrome trace (JSON), which
+// chrome://tracing and ui.perfetto.dev open. Flow events tie each tick request to the
+// player that plays it and to the reply the referee reads back, and each published
+// snapshot to the visualizer reading it.
+//
+// The directory is passed to child processes in the ROPE_TRACE environment variable.
+// Without it trace_start records nothing, and a trace point costs a single well
+// predicted branch on trace_buffer.
+// ##################################
+
+#define TRACE_ENV "ROPE_TRACE"
+#define TRACE_MAGIC 0x43415254u     // "TRAC"
+#define TRACE_VERSION 1
+#define TRACE_CAPACITY (1 << 20)    // Events per process; later ones are counted and dropped
+
+// Trace points; names and categories are in trace.c
+typedef enum {
+    TRACE_TICK,             // Referee: one whole tick (span)
+    TRACE_WAIT,             // Referee: waiting for the tick deadline (span)
+    TRACE_RANKING,          // Referee: re-ranking the players (span)
+    TRACE_EXCHANGE,         // Referee: requests out, replies in (span)
+    TRACE_REPLIES,          // Referee: every reply of the tick is in, or the deadline passed (instant)
+    TRACE_LATE,             // Referee: players that missed the deadline (instant)
+    TRACE_PUBLISH,          // Referee: output, state bus and recording of the tick (span)
+    TRACE_ROUND_END,        // Referee: a round ended (instant)
+    TRACE_REQUEST,          // Tick request: sent, played, reply read (flow)
+    TRACE_PLAY,             // Player: playing one tick (span)
+    TRACE_REPLY_SENT,       // Player: reply written (instant)
+    TRACE_SNAPSHOT,         // State bus snapshot: published, taken in by the visualizer (flow)
+    TRACE_BUS_READ,         // Visualizer: taking in new snapshots (span)
+    TRACE_FRAME,            // Visualizer: drawing a frame (span)
+    TRACE_NAMES
+} TraceName;
+
+// Event phases, as in the Chrome trace format
+#define TRACE_BEGIN      'B'
+#define TRACE_END        'E'
+#define TRACE_INSTANT    'i'
+#define TRACE_FLOW_START 's'
+#define TRACE_FLOW_STEP  't'
+#define TRACE_FLOW_END   'f'
+
+typedef struct {
+    uint64_t ts;                // CLOCK_MONOTONIC in nanoseconds
+    uint64_t id;                // Flow id
+    int64_t arg;                // Tick number, or what the trace point counts
+    uint32_t tid;
+    uint16_t name;              // TraceName
+    _Atomic char phase;         // Written last; 0 while the slot is being filled
+    char pad;
+} TraceEvent;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;
+    uint32_t capacity;
+    _Atomic uint64_t count;     // Slots claimed, dropped ones included
+    char process[40];           // Name shown for the process
+} TraceHeader;
+
+typedef struct {
+    TraceHeader* header;
+    TraceEvent* events;
+    size_t length;
+} TraceBuffer;
+
+// This process's buffer, or NULL when not tracing
+extern TraceBuffer* trace_buffer;
+
+// Starts recording if ROPE_TRACE names a directory; returns -1 on error (errno set)
+int trace_start(const char* process);
+
+// Appends one event to this process's buffer
+void trace_record(TraceName name, char phase, int64_t arg, uint64_t id);
+
+static inline void trace(TraceName name, char phase, int64_t arg, uint64_t id) {
+    if (__builtin_expect(trace_buffer != NULL, 0)) trace_record(name, phase, arg, id);
+}
+
+// Flow id of a tick request to one player
+static inline uint64_t trace_request_id(uint32_t tick, int slot) {
+    return (uint64_t)tick << 32 | (uint32_t)slot;
+}
+
+// Writes every buffer in dir as one Chrome trace JSON file, then removes the buffers and
+// dir; returns -1 on error (errno set)
+int trace_merge(const char* dir, const char* path);
+
+// Stops recording and unmaps the buffer
+void trace_stop(void);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+// ##################################
+// Socket links between the referee and its players. Pipes only reach the children the
+// referee forks; a Unix or TCP socket also takes players started on their own, on this
+// host or (TCP) another one. All of them carry the same frames (see protocol.h), and
+// sockets are set up for small messages: TCP_NODELAY, so a frame is sent as soon as it
+// is written rather than held back for the next one.
+// On the command line an address is "unix <path>" or "tcp <host>:<port>".
+// ##################################
+
+typedef enum { TRANSPORT_FAMILY_UNIX, TRANSPORT_FAMILY_TCP } TransportFamily;
+
+typedef struct {
+    TransportFamily family;
+    char path[108];             // Unix socket path
+    char host[256];             // TCP host; empty or "*" listens on every interface
+    char port[16];
+} TransportAddress;
+
+// Parses "unix" or "tcp" and the address that follows; returns -1 (errno EINVAL) if invalid
+int transport_parse(const char* family, const char* text, TransportAddress* address);
+
+// Listening socket for players; returns -1 on error (errno set)
+int transport_listen(const TransportAddress* address);
+
+// Next player to connect; returns -1 on error (errno set)
+int transport_accept(int listen_fd);
+
+// Connects a player to the referee; returns -1 on error (errno set)
+int transport_connect(const TransportAddress* address);
+
+// Closes a listening socket and removes its Unix socket file
+void transport_unlisten(int listen_fd, const TransportAddress* address);
+
+// Writes the address as given on the command line
+void transport_format(const TransportAddress* address, char* text, int size);
+
+#endif
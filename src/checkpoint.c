@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+
+// Scores take whole cache lines so the store in each copy stays aligned
+static size_t scores_size(int num_teams) {
+    size_t bytes = num_teams * sizeof(int32_t);
+    return (bytes + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+}
+
+static size_t copy_offset(void) {
+    return (sizeof(CheckpointHeader) + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+}
+
+static size_t copy_header_size(void) {
+    return (sizeof(CheckpointCopy) + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+}
+
+static CheckpointCopy* copy_at(const Checkpoint* c, int k) {
+    return (CheckpointCopy*)(c->map + copy_offset() + k * c->header->copy_size);
+}
+
+static int32_t* copy_scores(CheckpointCopy* copy) {
+    return (int32_t*)((char*)copy + copy_header_size());
+}
+
+static void copy_store(const Checkpoint* c, CheckpointCopy* copy, PlayerStore* store) {
+    player_store_attach(store, (char*)copy_scores(copy) + scores_size(c->header->num_teams),
+                        c->header->num_players);
+}
+
+// FNV-1a over 64-bit words; every copy is a whole number of them
+static uint64_t checksum(const CheckpointCopy* copy, size_t size) {
+    const uint64_t* words = (const uint64_t*)&copy->progress;
+    size_t n = (size - offsetof(CheckpointCopy, progress)) / sizeof(uint64_t);
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t k = 0; k < n; k++) h = (h ^ words[k]) * 0x100000001b3ull;
+    return h;
+}
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+static int map_file(Checkpoint* c, int fd, size_t length) {
+    c->map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (c->map == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    c->fd = fd;
+    c->length = length;
+    c->header = (CheckpointHeader*)c->map;
+    c->synced_ms = now_ms();
+    return 0;
+}
+
+int checkpoint_create(Checkpoint* c, const char* path, int num_players, int num_teams) {
+    memset(c, 0, sizeof(*c));
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    size_t copy_size = copy_header_size() + scores_size(num_teams) + player_store_size(num_players);
+    size_t length = copy_offset() + 2 * copy_size;
+    if (fd < 0) return -1;
+    if (ftruncate(fd, length) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    if (map_file(c, fd, length) < 0) return -1;
+
+    CheckpointHeader header = { CHECKPOINT_MAGIC, CHECKPOINT_VERSION, num_players, num_teams, copy_size };
+    *c->header = header;
+    return 0;
+}
+
+int checkpoint_open(Checkpoint* c, const char* path) {
+    memset(c, 0, sizeof(*c));
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)copy_offset()) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    if (map_file(c, fd, st.st_size) < 0) return -1;
+
+    const CheckpointHeader* h = c->header;
+    size_t copy_size = copy_header_size() + scores_size(h->num_teams) + player_store_size(h->num_players);
+    if (h->magic != CHECKPOINT_MAGIC || h->version != CHECKPOINT_VERSION || h->num_players <= 0 ||
+        h->num_teams <= 0 || h->copy_size != copy_size || c->length < copy_offset() + 2 * copy_size) {
+        checkpoint_close(c);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // The newer copy unless it is torn
+    for (int k = 0; k < 2; k++) {
+        CheckpointCopy* copy = copy_at(c, k);
+        if (copy->seq > c->seq && copy->checksum == checksum(copy, copy_size)) c->seq = copy->seq;
+    }
+    const GameConfig* cfg = &copy_at(c, c->seq & 1)->progress.config;
+    if (c->seq == 0 || cfg->num_teams != h->num_teams || cfg->team_size * cfg->num_teams != h->num_players) {
+        checkpoint_close(c);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void checkpoint_restore(const Checkpoint* c, CheckpointProgress* progress, int* scores, PlayerStore* store) {
+    CheckpointCopy* copy = copy_at(c, c->seq & 1);
+    if (progress) *progress = copy->progress;
+    if (scores) memcpy(scores, copy_scores(copy), c->header->num_teams * sizeof(int32_t));
+    if (store) {
+        PlayerStore saved;
+        copy_store(c, copy, &saved);
+        player_store_copy(store, &saved);
+    }
+}
+
+// ##################################
+// Writes the older copy and numbers it last, so it only counts once it is complete
+// ##################################
+int checkpoint_save(Checkpoint* c, const CheckpointProgress* progress, const int* scores, const PlayerStore* store) {
+    uint64_t seq = c->seq + 1;
+    CheckpointCopy* copy = copy_at(c, seq & 1);
+    copy->seq = 0;
+    copy->progress = *progress;
+    memcpy(copy_scores(copy), scores, c->header->num_teams * sizeof(int32_t));
+    PlayerStore saved;
+    copy_store(c, copy, &saved);
+    player_store_copy(&saved, store);
+    copy->checksum = checksum(copy, c->header->copy_size);
+    __atomic_store_n(&copy->seq, seq, __ATOMIC_RELEASE);
+    c->seq = seq;
+
+    long now = now_ms();
+    if (!progress->finished && now - c->synced_ms < CHECKPOINT_SYNC_MS) return 0;
+    c->synced_ms = now;
+    return msync(c->map, c->length, MS_SYNC);
+}
+
+void checkpoint_close(Checkpoint* c) {
+    msync(c->map, c->length, MS_SYNC);
+    munmap(c->map, c->length);
+    close(c->fd);
+}
@@ -0,0 +1,256 @@
+#include "header.h"
+#include "constants.h"
+#include "config.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+
+// Every setting: its key, where it goes, how many numbers it takes and what it is called
+// in messages. Positional files list them in this order; the first REQUIRED_SETTINGS must be set.
+typedef struct {
+    const char* key;
+    size_t offset;
+    int count;
+    const char* what;
+} Setting;
+
+static const Setting settings[] = {
+    { "energy",    offsetof(GameConfig, energy_min),    2, "energy range" },
+    { "decrease",  offsetof(GameConfig, decrease_min),  2, "decrease range" },
+    { "recovery",  offsetof(GameConfig, recovery_min),  2, "recovery range" },
+    { "threshold", offsetof(GameConfig, win_threshold), 1, "win threshold" },
+    { "duration",  offsetof(GameConfig, game_duration), 1, "game duration" },
+    { "rounds",    offsetof(GameConfig, rounds_to_win), 1, "rounds to win" },
+    { "tick_ms",   offsetof(GameConfig, tick_ms),       1, "tick period" },
+    { "seed",      offsetof(GameConfig, seed),          1, "random seed" },
+    { "team_size", offsetof(GameConfig, team_size),     1, "team size" },
+    { "num_teams", offsetof(GameConfig, num_teams),     1, "number of teams" },
+};
+#define NUM_SETTINGS (int)(sizeof(settings) / sizeof(settings[0]))
+#define REQUIRED_SETTINGS 6
+#define SEED_SETTING 7
+
+// Strips the comment and surrounding blanks; returns the start of what is left
+static char* clean_line(char* line) {
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+    while (isspace((unsigned char)*line)) line++;
+    char* end = line + strlen(line);
+    while (end > line && isspace((unsigned char)end[-1])) *--end = '\0';
+    return line;
+}
+
+// Reads the numbers of one setting; 0 on success
+static int parse_values(const Setting* s, const char* text, GameConfig* cfg) {
+    char* field = (char*)cfg + s->offset;
+    char extra;
+    if (s - settings == SEED_SETTING)
+        return sscanf(text, "%u %c", (unsigned int*)field, &extra) == 1 ? 0 : -1;
+    int* values = (int*)field;
+    if (s->count == 2) return sscanf(text, "%d %d %c", &values[0], &values[1], &extra) == 2 ? 0 : -1;
+    return sscanf(text, "%d %c", &values[0], &extra) == 1 ? 0 : -1;
+}
+
+int config_validate(const GameConfig* cfg, char* error, size_t size) {
+    const char* bad = NULL;
+    if (cfg->energy_min < 1 || cfg->energy_min > cfg->energy_max) bad = "energy range";
+    else if (cfg->decrease_min < 0 || cfg->decrease_min > cfg->decrease_max) bad = "decrease range";
+    else if (cfg->recovery_min < 0 || cfg->recovery_min > cfg->recovery_max) bad = "recovery range";
+    else if (cfg->win_threshold <= 0) bad = "win threshold";
+    else if (cfg->game_duration <= 0) bad = "game duration";
+    else if (cfg->rounds_to_win <= 0) bad = "rounds to win";
+    else if (cfg->tick_ms <= 0) bad = "tick period";
+    else if (cfg->team_size <= 0) bad = "team size";
+    else if (cfg->num_teams < 2) bad = "number of teams";
+    if (!bad) return 0;
+    snprintf(error, size, "Invalid %s in config", bad);
+    return -1;
+}
+
+int config_load(const char* path, GameConfig* cfg, char* error, size_t size) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        snprintf(error, size, "Failed to open config file %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->tick_ms = DEFAULT_TICK_MS;
+    cfg->seed = 0;
+    cfg->team_size = DEFAULT_TEAM_SIZE;
+    cfg->num_teams = DEFAULT_NUM_TEAMS;
+
+    char buffer[256];
+    int seen[NUM_SETTINGS] = {0};
+    int named = -1, next = 0, line_no = 0, result = 0;
+    while (result == 0 && fgets(buffer, sizeof(buffer), file)) {
+        line_no++;
+        char* line = clean_line(buffer);
+        if (!*line) continue;
+
+        // The first setting decides whether the file is named or positional
+        char* equals = strchr(line, '=');
+        if (named < 0) named = equals != NULL;
+
+        const Setting* s = NULL;
+        char* values = line;
+        if (named) {
+            if (!equals) {
+                snprintf(error, size, "Expected 'key = value' on line %d of config", line_no);
+                result = -1;
+                break;
+            }
+            *equals = '\0';
+            char* key = clean_line(line);
+            values = equals + 1;
+            for (int k = 0; k < NUM_SETTINGS; k++) {
+                if (strcmp(key, settings[k].key) == 0) s = &settings[k];
+            }
+            if (!s) {
+                snprintf(error, size, "Unknown setting '%s' on line %d of config", key, line_no);
+                result = -1;
+                break;
+            }
+        } else if (next < NUM_SETTINGS) {
+            s = &settings[next++];
+        } else {
+            break;                          // Extra positional lines are ignored, as they always were
+        }
+
+        if (parse_values(s, values, cfg) < 0) {
+            snprintf(error, size, "Invalid %s in config (line %d)", s->what, line_no);
+            result = -1;
+        }
+        seen[s - settings] = 1;
+    }
+    fclose(file);
+    if (result < 0) return -1;
+
+    for (int k = 0; k < REQUIRED_SETTINGS; k++) {
+        if (!seen[k]) {
+            snprintf(error, size, "Missing %s in config", settings[k].what);
+            return -1;
+        }
+    }
+    return config_validate(cfg, error, size);
+}
+
+int config_set(GameConfig* cfg, const char* key, int value) {
+    for (int k = 0; k < NUM_SETTINGS; k++) {
+        const Setting* s = &settings[k];
+        size_t length = strlen(s->key);
+        if (strncmp(key, s->key, length) != 0) continue;
+
+        int* values = (int*)((char*)cfg + s->offset);
+        const char* end = key + length;
+        if (s->count == 1 && !*end) values[0] = value;
+        else if (s->count == 2 && strcmp(end, "_min") == 0) values[0] = value;
+        else if (s->count == 2 && strcmp(end, "_max") == 0) values[1] = value;
+        else continue;
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+int config_apply_live(GameConfig* live, const GameConfig* fresh) {
+    live->energy_min = fresh->energy_min;
+    live->energy_max = fresh->energy_max;
+    live->decrease_min = fresh->decrease_min;
+    live->decrease_max = fresh->decrease_max;
+    live->recovery_min = fresh->recovery_min;
+    live->recovery_max = fresh->recovery_max;
+    live->win_threshold = fresh->win_threshold;
+
+    // A fresh seed of 0 means "pick one", which the running match already did
+    return fresh->game_duration != live->game_duration || fresh->rounds_to_win != live->rounds_to_win ||
+           fresh->tick_ms != live->tick_ms || (fresh->seed && fresh->seed != live->seed) ||
+           fresh->team_size != live->team_size || fresh->num_teams != live->num_teams;
+}
+
+// ##################################
+// Shared copy for the player processes
+// ##################################
+SharedConfig* config_share(const GameConfig* cfg, int* fd) {
+    *fd = memfd_create("rope_config", 0);
+    if (*fd < 0) return NULL;
+    if (ftruncate(*fd, sizeof(SharedConfig)) < 0) {
+        close(*fd);
+        return NULL;
+    }
+    SharedConfig* shared = mmap(NULL, sizeof(SharedConfig), PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    if (shared == MAP_FAILED) {
+        close(*fd);
+        return NULL;
+    }
+    shared->config = *cfg;
+    shared->generation = 2;
+    return shared;
+}
+
+const SharedConfig* config_attach(int fd) {
+    SharedConfig* shared = mmap(NULL, sizeof(SharedConfig), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return shared == MAP_FAILED ? NULL : shared;
+}
+
+// The generation is odd while the copy is being written
+void config_publish(SharedConfig* shared, const GameConfig* cfg) {
+    __atomic_store_n(&shared->generation, shared->generation + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    shared->config = *cfg;
+    __atomic_store_n(&shared->generation, shared->generation + 1, __ATOMIC_RELEASE);
+}
+
+void config_refresh(const SharedConfig* shared, GameConfig* cfg, uint32_t* seen) {
+    uint32_t generation = __atomic_load_n(&shared->generation, __ATOMIC_ACQUIRE);
+    if (generation == *seen) return;
+
+    GameConfig copy;
+    do {
+        while ((generation = __atomic_load_n(&shared->generation, __ATOMIC_ACQUIRE)) & 1);
+        copy = shared->config;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&shared->generation, __ATOMIC_RELAXED) != generation);
+    *cfg = copy;
+    *seen = generation;
+}
+
+// ##################################
+// File watch
+// ##################################
+int config_watch_start(ConfigWatch* watch, const char* path) {
+    char dir_copy[PATH_MAX], name_copy[PATH_MAX];
+    snprintf(dir_copy, sizeof(dir_copy), "%s", path);
+    snprintf(name_copy, sizeof(name_copy), "%s", path);
+    snprintf(watch->name, sizeof(watch->name), "%s", basename(name_copy));
+
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) return -1;
+    if (inotify_add_watch(watch->fd, dirname(dir_copy), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(watch->fd);
+        watch->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int config_watch_changed(ConfigWatch* watch) {
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t n;
+    while ((n = read(watch->fd, events, sizeof(events))) > 0) {
+        for (char* p = events; p < events + n; ) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            if (ev->len && strcmp(ev->name, watch->name) == 0) changed = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return changed;
+}
+
+void config_watch_stop(ConfigWatch* watch) {
+    if (watch->fd >= 0) close(watch->fd);
+    watch->fd = -1;
+}
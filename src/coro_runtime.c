@@ -0,0 +1,260 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include "constants.h"
+#include "rules.h"
+#include "coro_runtime.h"
+
+typedef struct Worker Worker;
+
+// A player running as a coroutine: its own stack and context, its state is entry `slot` of the store
+typedef struct {
+    ucontext_t ctx;
+    void* stack;
+    int slot;
+    CoroRuntime* rt;
+    Worker* worker;         // Worker that resumed it last, yielded back to
+} Coroutine;
+
+// A worker thread with its own deque: it pops from the bottom, thieves take from the top
+struct Worker {
+    pthread_t thread;
+    ucontext_t ctx;
+    pthread_mutex_t lock;
+    Coroutine** deque;
+    int top, bottom;
+    unsigned int rng;
+    int index;
+    CoroRuntime* rt;
+};
+
+struct CoroRuntime {
+    GameConfig config;
+    int num_players, num_workers;
+    Coroutine* coros;
+    Worker* workers;
+    PlayerStore store;
+
+    int phase;
+    unsigned long generation;       // Bumped once per phase, wakes idle workers
+    atomic_int remaining;           // Players still running the current phase
+    long* finished_ns;              // When each player finished its phase; NULL when not timed
+    int shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+};
+
+// ##################################
+// Body of every player coroutine: one phase per resume, then yield to the worker
+// ##################################
+static void coroutine_main(unsigned int lo, unsigned int hi) {
+    Coroutine* c = (Coroutine*)(((uintptr_t)hi << 32) | lo);
+    CoroRuntime* rt = c->rt;
+
+    while (1) {
+        player_round(&rt->store, c->slot, &rt->config);
+        player_effort(&rt->store, c->slot);
+        swapcontext(&c->ctx, &c->worker->ctx);
+    }
+}
+
+// Takes the most recently queued coroutine from the worker's own deque
+static Coroutine* pop_own(Worker* w) {
+    Coroutine* c = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->bottom > w->top) c = w->deque[--w->bottom];
+    pthread_mutex_unlock(&w->lock);
+    return c;
+}
+
+// Takes the oldest coroutine from another worker, starting at a random victim
+static Coroutine* steal(Worker* w) {
+    CoroRuntime* rt = w->rt;
+    int start = rand_r(&w->rng) % rt->num_workers;
+    for (int k = 0; k < rt->num_workers; k++) {
+        Worker* victim = &rt->workers[(start + k) % rt->num_workers];
+        if (victim == w) continue;
+
+        Coroutine* c = NULL;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->bottom > victim->top) c = victim->deque[victim->top++];
+        pthread_mutex_unlock(&victim->lock);
+        if (c) return c;
+    }
+    return NULL;
+}
+
+// Counts a finished player; the last one of the phase wakes the referee
+static void finish_one(CoroRuntime* rt) {
+    if (atomic_fetch_sub(&rt->remaining, 1) == 1) {
+        pthread_mutex_lock(&rt->lock);
+        pthread_cond_signal(&rt->done);
+        pthread_mutex_unlock(&rt->lock);
+    }
+}
+
+// ##################################
+// Worker loop: run own coroutines, steal when empty, sleep until the next phase
+// ##################################
+static void* worker_main(void* arg) {
+    Worker* w = arg;
+    CoroRuntime* rt = w->rt;
+    unsigned long seen = 0;
+
+    while (1) {
+        Coroutine* c = pop_own(w);
+        if (!c) c = steal(w);
+        if (c) {
+            c->worker = w;
+            swapcontext(&w->ctx, &c->ctx);
+            if (rt->finished_ns) {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                rt->finished_ns[c->slot] = now.tv_sec * 1000000000L + now.tv_nsec;
+            }
+            // Counted only once the coroutine has yielded, so it can be resumed again safely
+            finish_one(rt);
+            continue;
+        }
+
+        pthread_mutex_lock(&rt->lock);
+        while (rt->generation == seen && !rt->shutdown)
+            pthread_cond_wait(&rt->wake, &rt->lock);
+        seen = rt->generation;
+        int stop = rt->shutdown;
+        pthread_mutex_unlock(&rt->lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+// ##################################
+// Creates the players and the worker pool
+// ##################################
+CoroRuntime* coro_runtime_create(const GameConfig* cfg, int num_players, int num_workers) {
+    if (num_workers <= 0) num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers <= 0) num_workers = 1;
+
+    CoroRuntime* rt = calloc(1, sizeof(CoroRuntime));
+    rt->config = *cfg;
+    rt->num_players = num_players;
+    rt->num_workers = num_workers;
+    rt->coros = calloc(num_players, sizeof(Coroutine));
+    rt->workers = calloc(num_workers, sizeof(Worker));
+    if (player_store_init(&rt->store, num_players) < 0) {
+        perror("Failed to allocate player store");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&rt->remaining, 0);
+    pthread_mutex_init(&rt->lock, NULL);
+    pthread_cond_init(&rt->wake, NULL);
+    pthread_cond_init(&rt->done, NULL);
+
+    for (int i = 0; i < num_players; i++) {
+        Coroutine* c = &rt->coros[i];
+        c->slot = i;
+        c->rt = rt;
+        init_player(&rt->store, i, cfg, i % cfg->team_size, i, cfg->seed);
+
+        c->stack = mmap(NULL, CORO_STACK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (c->stack == MAP_FAILED) {
+            perror("Failed to allocate coroutine stack");
+            exit(EXIT_FAILURE);
+        }
+        getcontext(&c->ctx);
+        c->ctx.uc_stack.ss_sp = c->stack;
+        c->ctx.uc_stack.ss_size = CORO_STACK_SIZE;
+        c->ctx.uc_link = NULL;
+        uintptr_t ptr = (uintptr_t)c;
+        makecontext(&c->ctx, (void (*)(void))coroutine_main, 2,
+                    (unsigned int)(ptr & 0xffffffffu), (unsigned int)(ptr >> 32));
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        Worker* w = &rt->workers[i];
+        w->index = i;
+        w->rt = rt;
+        w->rng = cfg->seed + i;
+        w->deque = calloc(num_players, sizeof(Coroutine*));
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_create(&w->thread, NULL, worker_main, w);
+    }
+    return rt;
+}
+
+PlayerStore* coro_runtime_store(CoroRuntime* rt) {
+    return &rt->store;
+}
+
+void coro_runtime_configure(CoroRuntime* rt, const GameConfig* cfg) {
+    rt->config = *cfg;
+}
+
+// ##################################
+// Deals the players out to the workers in even chunks, then wakes them
+// ##################################
+void coro_runtime_signal(CoroRuntime* rt, int phase) {
+    rt->phase = phase;
+    atomic_store(&rt->remaining, rt->num_players);
+
+    int chunk = (rt->num_players + rt->num_workers - 1) / rt->num_workers;
+    for (int i = 0; i < rt->num_workers; i++) {
+        Worker* w = &rt->workers[i];
+        pthread_mutex_lock(&w->lock);
+        w->top = w->bottom = 0;
+        for (int j = i * chunk; j < (i + 1) * chunk && j < rt->num_players; j++)
+            w->deque[w->bottom++] = &rt->coros[j];
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    pthread_mutex_lock(&rt->lock);
+    rt->generation++;
+    pthread_cond_broadcast(&rt->wake);
+    pthread_mutex_unlock(&rt->lock);
+}
+
+void coro_runtime_wait(CoroRuntime* rt) {
+    pthread_mutex_lock(&rt->lock);
+    while (atomic_load(&rt->remaining) > 0)
+        pthread_cond_wait(&rt->done, &rt->lock);
+    pthread_mutex_unlock(&rt->lock);
+}
+
+const long* coro_runtime_time_replies(CoroRuntime* rt) {
+    if (!rt->finished_ns) rt->finished_ns = calloc(rt->num_players, sizeof(long));
+    return rt->finished_ns;
+}
+
+void coro_runtime_destroy(CoroRuntime* rt) {
+    pthread_mutex_lock(&rt->lock);
+    rt->shutdown = 1;
+    pthread_cond_broadcast(&rt->wake);
+    pthread_mutex_unlock(&rt->lock);
+
+    for (int i = 0; i < rt->num_workers; i++) {
+        pthread_join(rt->workers[i].thread, NULL);
+        pthread_mutex_destroy(&rt->workers[i].lock);
+        free(rt->workers[i].deque);
+    }
+    for (int i = 0; i < rt->num_players; i++)
+        munmap(rt->coros[i].stack, CORO_STACK_SIZE);
+
+    pthread_cond_destroy(&rt->wake);
+    pthread_cond_destroy(&rt->done);
+    pthread_mutex_destroy(&rt->lock);
+    free(rt->coros);
+    free(rt->workers);
+    free(rt->finished_ns);
+    player_store_free(&rt->store);
+    free(rt);
+}
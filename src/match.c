@@ -0,0 +1,162 @@
+#include "header.h"
+#include "constants.h"
+#include "match.h"
+#include "rules.h"
+
+int match_init(Match* m, const GameConfig* cfg, KernelLevel kernel) {
+    memset(m, 0, sizeof(*m));
+    m->config = *cfg;
+    m->num_players = cfg->team_size * cfg->num_teams;
+    m->game_ticks = (cfg->game_duration * 1000L + cfg->tick_ms - 1) / cfg->tick_ms;
+    m->pause_ticks = (ROUND_PAUSE_MS + cfg->tick_ms - 1) / cfg->tick_ms;
+    m->kernel = kernel;
+
+    if (player_store_init(&m->store, m->num_players) < 0) return -1;
+    m->ranks = calloc(cfg->num_teams, sizeof(RankIndex));
+    m->changed = malloc(m->num_players * sizeof(int));
+    m->flagged = calloc(m->num_players, 1);
+    m->was_active = malloc(m->num_players * sizeof(int));
+    m->totals = calloc(cfg->num_teams, sizeof(int));
+    m->scores = calloc(cfg->num_teams, sizeof(int));
+    if (!m->ranks || !m->changed || !m->flagged || !m->was_active || !m->totals || !m->scores) {
+        match_free(m);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+void match_free(Match* m) {
+    if (m->ranks) {
+        for (int t = 0; t < m->config.num_teams; t++) rank_index_free(&m->ranks[t]);
+    }
+    player_store_free(&m->store);
+    free(m->ranks);
+    free(m->changed);
+    free(m->flagged);
+    free(m->was_active);
+    free(m->totals);
+    free(m->scores);
+    m->ranks = NULL;
+}
+
+int match_start(Match* m, unsigned int seed) {
+    const GameConfig* cfg = &m->config;
+    for (int i = 0; i < m->num_players; i++)
+        init_player(&m->store, i, cfg, i % cfg->team_size, i, seed);
+    for (int t = 0; t < cfg->num_teams; t++) {
+        rank_index_free(&m->ranks[t]);
+        if (rank_index_init(&m->ranks[t], cfg->team_size, t * cfg->team_size, m->store.energy,
+                            m->store.position) < 0)
+            return -1;
+        m->scores[t] = 0;
+    }
+    m->seed = seed;
+    m->round = 1;
+    m->round_ticks = 0;
+    m->clock_ticks = 0;
+    m->last_winner = 0;
+    m->consecutive_wins = 0;
+    m->falls = 0;
+    m->num_changed = 0;
+    return 0;
+}
+
+// Re-ranks every team by the last tick's energies (update_positions in the referee)
+static void match_positions(Match* m) {
+    int team_size = m->config.team_size;
+    for (int t = 0; t < m->config.num_teams; t++)
+        rank_index_update(&m->ranks[t], t * team_size, m->store.energy, m->store.position, m->changed,
+                          &m->num_changed, m->flagged);
+    for (int c = 0; c < m->num_changed; c++) m->flagged[m->changed[c]] = 0;
+    m->num_changed = 0;
+}
+
+// Effort phase plus team totals
+static void match_effort(Match* m) {
+    int team_size = m->config.team_size;
+    tick_kernel_effort(&m->store, 0, m->num_players);
+    for (int t = 0; t < m->config.num_teams; t++) {
+        int total = 0;
+        for (int k = 0; k < team_size; k++) total += m->store.effort[t * team_size + k];
+        m->totals[t] = total;
+    }
+}
+
+// ##################################
+// One tick exactly as the referee plays it on the virtual clock, then the round and game
+// decisions when the tick ends the round
+// ##################################
+int match_tick(Match* m) {
+    const GameConfig* cfg = &m->config;
+    PlayerStore* s = &m->store;
+    int num_teams = cfg->num_teams;
+
+    m->clock_ticks++;
+    m->round_ticks++;
+    match_positions(m);
+    memcpy(m->was_active, s->active, m->num_players * sizeof(int));
+    tick_kernel_round(s, 0, m->num_players, cfg, m->kernel);
+    int falls = 0;
+    for (int i = 0; i < m->num_players; i++) falls += m->was_active[i] & !s->active[i];
+    m->falls += falls;
+    match_effort(m);
+
+    int reached = 0, out_of_time = m->clock_ticks >= m->game_ticks;
+    for (int t = 0; t < num_teams; t++) {
+        if (m->totals[t] >= cfg->win_threshold) reached = 1;
+    }
+    if (!reached && !out_of_time) return MATCH_PLAYING;
+    if (out_of_time) {
+        for (int t = 0; t < num_teams; t++) m->scores[t] = 0;
+    }
+
+    // A team wins the round with the highest total if nobody ties it and it meets the threshold
+    int winner = 0, best = -1, tied = 0;
+    for (int t = 0; t < num_teams; t++) {
+        if (m->totals[t] > best) { best = m->totals[t]; winner = t + 1; tied = 0; }
+        else if (m->totals[t] == best) tied = 1;
+    }
+    if (tied || best < cfg->win_threshold) winner = 0;
+
+    if (winner) {
+        m->scores[winner - 1]++;
+        if (m->last_winner == winner) m->consecutive_wins++;
+        else { m->last_winner = winner; m->consecutive_wins = 1; }
+    } else {
+        m->last_winner = 0;
+        m->consecutive_wins = 0;
+    }
+    m->round_winner = winner;
+    m->round_length = m->round_ticks;
+    m->round_ticks = 0;
+
+    int over = 1;
+    if (m->consecutive_wins >= 2) m->end = MATCH_END_TWO_IN_ROW;
+    else if (m->clock_ticks >= m->game_ticks) {
+        for (int t = 0; t < num_teams; t++) m->scores[t] = 0;
+        m->end = MATCH_END_OUT_OF_TIME;
+    } else if (m->round == cfg->rounds_to_win) m->end = MATCH_END_ROUNDS;
+    else over = 0;
+
+    if (!over) {
+        m->round++;
+        m->clock_ticks += m->pause_ticks;
+        return MATCH_ROUND_END;
+    }
+
+    int final_winner = 0, best_score = -1;
+    for (int t = 0; t < num_teams; t++) {
+        if (m->scores[t] > best_score) { best_score = m->scores[t]; final_winner = t + 1; }
+        else if (m->scores[t] == best_score) final_winner = 0;
+    }
+    m->final_winner = final_winner;
+    return MATCH_GAME_OVER;
+}
+
+unsigned int match_seed(unsigned int seed, long n) {
+    uint64_t z = seed + (uint64_t)n * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return (unsigned int)(z ^ (z >> 31));
+}
@@ -0,0 +1,476 @@
+#include "header.h"
+#include "structs.h"
+#include "config.h"
+#include "match.h"
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+// ##################################
+// Match server: a long-running daemon that plays matches requested over a Unix socket.
+// Every match gets its own config and state (see match.h) and is queued for a fixed set
+// of worker threads. Workers take turns on the queue: a match plays at most MATCH_QUANTUM
+// ticks, then goes to the back, so a long match shares the workers with short ones
+// instead of holding one of them up until it ends.
+//
+// One request per line, one JSON reply per line:
+//   match <config_file> [seed]   the match result, once it is over
+//   stats                        counters of the server so far
+// Match replies come in the order the matches finish; their id is the number of the
+// request on its connection, from 1. Config paths are relative to the server's directory.
+//
+// Client sockets are non-blocking. Replies are queued on their connection and sent by the
+// main thread as the client takes them, so a client that does not read holds up nobody
+// but itself: past OUTPUT_HIGH_WATER bytes of unsent replies its requests are not read
+// any more, and past MAX_CONNECTION_JOBS matches in play its match requests are refused.
+// ##################################
+
+#define MATCH_QUANTUM 64        // Ticks a match plays before the next one in line gets a turn
+#define MAX_LINE 1024
+#define MAX_EVENTS 64
+#define MAX_CONNECTION_JOBS 256
+#define OUTPUT_HIGH_WATER (64 * 1024)
+
+// A client connection. The main thread reads requests and sends the replies; workers queue them.
+typedef struct {
+    int fd;
+    atomic_int refs;            // One for the main thread, one per match not yet answered
+    pthread_mutex_t lock;       // Guards everything below up to buffer
+    int reading;                // Input still open
+    int gone;                   // Dropped by the main thread; replies are discarded
+    int jobs;                   // Matches queued or being played
+    uint32_t events;            // What epoll watches the socket for
+    char* out;                  // Replies not sent yet, from out + out_sent
+    size_t out_length, out_sent, out_capacity;
+    char buffer[MAX_LINE];
+    int length;
+    long next_id;
+    char config_path[PATH_MAX]; // Last config file loaded for this client, reused while unchanged
+    struct timespec config_mtime;
+    GameConfig config;
+} Connection;
+
+// A requested match and where its result goes
+typedef struct Job {
+    Match match;
+    Connection* conn;
+    long id;
+    long queued_ns;
+    long started_ns;            // Start of its first turn
+    long turns;
+    struct Job* next;
+} Job;
+
+// Run queue: matches waiting for a worker, oldest first
+pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+Job* queue_head = NULL;
+Job* queue_tail = NULL;
+int queue_length = 0;
+int stopping = 0;
+
+int num_workers;
+KernelLevel kernel_level;
+long start_ns;
+atomic_long matches_done;
+atomic_long matches_active;     // Accepted and not finished
+atomic_long matches_refused;    // Over a connection's limit
+atomic_long ticks_played;
+atomic_uint seed_counter;
+
+int epoll_fd;
+volatile sig_atomic_t terminate = 0;
+
+void handle_termination(int signum) {
+    terminate = 1;
+}
+
+long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// ##################################
+// Connections are freed by whoever drops the last reference
+// ##################################
+void connection_release(Connection* c) {
+    if (atomic_fetch_sub(&c->refs, 1) != 1) return;
+    close(c->fd);
+    pthread_mutex_destroy(&c->lock);
+    free(c->out);
+    free(c);
+}
+
+// Points epoll at what the connection waits for: requests while its input is open and its
+// replies are not backed up, and room to send while any are queued. Call with the lock held.
+void connection_watch(Connection* c) {
+    uint32_t events = (c->reading && c->out_length - c->out_sent < OUTPUT_HIGH_WATER ? EPOLLIN : 0) |
+                      (c->out_length > c->out_sent ? EPOLLOUT : 0);
+    if (c->gone || events == c->events) return;
+    struct epoll_event ev = { .events = events, .data.ptr = c };
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+}
+
+// ##################################
+// Queues one reply line whole for the main thread to send; answers_job also counts off
+// one of the connection's matches. A client that went away just misses it. A reply that
+// finds no memory shuts the connection down instead, so the client sees it close rather
+// than wait for a result that never comes; the main thread drops it on the hang-up.
+// ##################################
+void connection_reply(Connection* c, const char* line, int length, int answers_job) {
+    pthread_mutex_lock(&c->lock);
+    if (answers_job) c->jobs--;
+    if (!c->gone) {
+        if (c->out_length + length > c->out_capacity) {
+            size_t capacity = c->out_capacity ? c->out_capacity : MAX_LINE;
+            while (capacity < c->out_length + length) capacity *= 2;
+            char* out = realloc(c->out, capacity);
+            if (out) {
+                c->out = out;
+                c->out_capacity = capacity;
+            }
+        }
+        if (c->out_length + length <= c->out_capacity) {
+            memcpy(c->out + c->out_length, line, length);
+            c->out_length += length;
+        } else {
+            perror("Failed to queue reply");
+            shutdown(c->fd, SHUT_RDWR);
+            c->reading = 0;
+            c->out_length = c->out_sent = 0;
+        }
+        connection_watch(c);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Sends as much of the queued replies as the socket takes; returns -1 if the client is gone
+int connection_flush(Connection* c) {
+    pthread_mutex_lock(&c->lock);
+    int result = 0;
+    while (c->out_sent < c->out_length) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_length - c->out_sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            result = -1;
+            break;
+        }
+        c->out_sent += n;
+    }
+    if (c->out_sent == c->out_length) c->out_length = c->out_sent = 0;
+    connection_watch(c);
+    pthread_mutex_unlock(&c->lock);
+    return result;
+}
+
+// ##################################
+// Main thread: lets go of a connection, at once when the client is gone (drop), or once its
+// input is closed and every match it asked for has been answered and sent
+// ##################################
+void connection_close(Connection* c, int drop) {
+    pthread_mutex_lock(&c->lock);
+    int done = !c->gone && (drop || (!c->reading && c->jobs == 0 && c->out_length == 0));
+    if (done) {
+        c->gone = 1;
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    }
+    pthread_mutex_unlock(&c->lock);
+    if (done) connection_release(c);
+}
+
+// ##################################
+// Run queue
+// ##################################
+void enqueue(Job* job) {
+    job->next = NULL;
+    pthread_mutex_lock(&queue_lock);
+    if (queue_tail) queue_tail->next = job;
+    else queue_head = job;
+    queue_tail = job;
+    queue_length++;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+// Blocks until a match is waiting; NULL once the server stops
+Job* dequeue() {
+    pthread_mutex_lock(&queue_lock);
+    while (!queue_head && !stopping) pthread_cond_wait(&queue_ready, &queue_lock);
+    Job* job = queue_head;
+    if (job && !stopping) {
+        queue_head = job->next;
+        if (!queue_head) queue_tail = NULL;
+        queue_length--;
+    } else {
+        job = NULL;
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return job;
+}
+
+// ##################################
+// Sends the result of a finished match and frees it
+// ##################################
+void finish(Job* job) {
+    static const char* ends[] = { "rounds", "two_in_a_row", "out_of_time" };
+    Match* m = &job->match;
+    long now = now_ns();
+    char line[MAX_LINE];
+    int n = snprintf(line, sizeof(line), "{\"event\":\"match\",\"id\":%ld,\"seed\":%u,\"winner\":%d,\"end\":\"%s\","
+                     "\"rounds\":%d,\"clock_tick\":%ld,\"falls\":%ld,\"turns\":%ld,\"wait_us\":%ld,\"run_us\":%ld,"
+                     "\"scores\":[", job->id, m->seed, m->final_winner, ends[m->end], m->round, m->clock_ticks,
+                     m->falls, job->turns, (job->started_ns - job->queued_ns) / 1000, (now - job->started_ns) / 1000);
+    for (int t = 0; t < m->config.num_teams && n < MAX_LINE - 16; t++)
+        n += snprintf(line + n, sizeof(line) - n, "%s%d", t ? "," : "", m->scores[t]);
+    n += snprintf(line + n, sizeof(line) - n, "]}\n");
+
+    connection_reply(job->conn, line, n, 1);
+    connection_release(job->conn);
+    match_free(m);
+    free(job);
+    atomic_fetch_add(&matches_done, 1);
+    atomic_fetch_sub(&matches_active, 1);
+}
+
+// Plays one turn of the match at the head of the queue at a time
+void* worker_main(void* arg) {
+    Job* job;
+    while ((job = dequeue()) != NULL) {
+        if (!job->turns++) job->started_ns = now_ns();
+        int result = MATCH_PLAYING, ticks = 0;
+        while (ticks < MATCH_QUANTUM && result != MATCH_GAME_OVER) {
+            result = match_tick(&job->match);
+            ticks++;
+        }
+        atomic_fetch_add(&ticks_played, ticks);
+
+        if (result == MATCH_GAME_OVER) finish(job);
+        else enqueue(job);
+    }
+    return NULL;
+}
+
+// ##################################
+// Requests
+// ##################################
+void reply_error(Connection* c, long id, const char* message) {
+    char line[MAX_LINE];
+    int n = snprintf(line, sizeof(line), "{\"event\":\"error\",\"id\":%ld,\"message\":\"%s\"}\n", id, message);
+    connection_reply(c, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1, 0);
+}
+
+void reply_stats(Connection* c) {
+    pthread_mutex_lock(&queue_lock);
+    int waiting = queue_length;
+    pthread_mutex_unlock(&queue_lock);
+
+    double uptime = (now_ns() - start_ns) / 1e9;
+    long done = atomic_load(&matches_done);
+    char line[MAX_LINE];
+    int n = snprintf(line, sizeof(line), "{\"event\":\"stats\",\"workers\":%d,\"kernel\":\"%s\",\"uptime_s\":%.3f,"
+                     "\"matches\":%ld,\"matches_per_s\":%.1f,\"active\":%ld,\"queued\":%d,\"refused\":%ld,"
+                     "\"ticks\":%ld}\n", num_workers, tick_kernel_name(kernel_level), uptime, done, done / uptime,
+                     atomic_load(&matches_active), waiting, atomic_load(&matches_refused), atomic_load(&ticks_played));
+    connection_reply(c, line, n, 0);
+}
+
+// Queues a match for "match <config_file> [seed]"
+void request_match(Connection* c, char* args) {
+    long id = ++c->next_id;
+    char path[PATH_MAX], error[256];
+    unsigned int seed = 0;
+    int fields = sscanf(args, "%4095s %u", path, &seed);
+    if (fields < 1) {
+        reply_error(c, id, "Usage: match <config_file> [seed]");
+        return;
+    }
+    pthread_mutex_lock(&c->lock);
+    int jobs = c->jobs;
+    pthread_mutex_unlock(&c->lock);
+    if (jobs >= MAX_CONNECTION_JOBS) {
+        atomic_fetch_add(&matches_refused, 1);
+        reply_error(c, id, "Too many matches in play on this connection; wait for some results");
+        return;
+    }
+
+    // Clients tend to send the same config over and over; it is parsed again only when it changes
+    struct stat st;
+    if (stat(path, &st) < 0 || strcmp(path, c->config_path) != 0 ||
+        st.st_mtim.tv_sec != c->config_mtime.tv_sec || st.st_mtim.tv_nsec != c->config_mtime.tv_nsec) {
+        c->config_path[0] = '\0';
+        if (config_load(path, &c->config, error, sizeof(error)) < 0) {
+            reply_error(c, id, error);
+            return;
+        }
+        strcpy(c->config_path, path);
+        c->config_mtime = st.st_mtim;
+    }
+    const GameConfig cfg = c->config;
+    if (fields < 2) seed = cfg.seed;
+    if (seed == 0) seed = (unsigned int)(start_ns ^ (atomic_fetch_add(&seed_counter, 1) * 0x9e3779b9u));
+
+    Job* job = calloc(1, sizeof(Job));
+    if (!job || match_init(&job->match, &cfg, kernel_level) < 0 || match_start(&job->match, seed) < 0) {
+        if (job) match_free(&job->match);
+        free(job);
+        reply_error(c, id, "Out of memory");
+        return;
+    }
+    job->conn = c;
+    job->id = id;
+    job->queued_ns = now_ns();
+    pthread_mutex_lock(&c->lock);
+    c->jobs++;
+    pthread_mutex_unlock(&c->lock);
+    atomic_fetch_add(&c->refs, 1);
+    atomic_fetch_add(&matches_active, 1);
+    enqueue(job);
+}
+
+void handle_line(Connection* c, char* line) {
+    if (strncmp(line, "match", 5) == 0 && (line[5] == ' ' || line[5] == '\0')) request_match(c, line + 5);
+    else if (strcmp(line, "stats") == 0) reply_stats(c);
+    else if (*line) reply_error(c, ++c->next_id, "Unknown request (expected match or stats)");
+}
+
+// Reads what the client sent and runs every complete line; returns 0 at the end of its
+// input, -1 if it is gone
+int read_requests(Connection* c) {
+    ssize_t n = read(c->fd, c->buffer + c->length, sizeof(c->buffer) - 1 - c->length);
+    if (n < 0) return (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+    if (n == 0) return 0;
+    c->length += n;
+    c->buffer[c->length] = '\0';
+
+    char* start = c->buffer;
+    char* end;
+    while ((end = strchr(start, '\n')) != NULL) {
+        *end = '\0';
+        if (end > start && end[-1] == '\r') end[-1] = '\0';
+        handle_line(c, start);
+        start = end + 1;
+    }
+    c->length -= start - c->buffer;
+    memmove(c->buffer, start, c->length);
+    if (c->length == (int)sizeof(c->buffer) - 1) return -1;     // A line longer than any request
+    return 1;
+}
+
+// ##################################
+// Main function: accepts clients and reads their requests; workers do the rest
+// ##################################
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <socket> [workers]\n", argv[0]);
+        return 1;
+    }
+    const char* path = argv[1];
+    num_workers = (argc > 2) ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers <= 0) {
+        fprintf(stderr, "Error: workers must be positive\n");
+        return 1;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 64) < 0) {
+        perror("Failed to open server socket");
+        exit(EXIT_FAILURE);
+    }
+
+    // Only this thread takes the exit signals, so they interrupt its epoll_wait
+    struct sigaction sa = { .sa_handler = handle_termination };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigset_t exit_signals, previous;
+    sigemptyset(&exit_signals);
+    sigaddset(&exit_signals, SIGTERM);
+    sigaddset(&exit_signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &exit_signals, &previous);
+
+    kernel_level = tick_kernel_best();
+    start_ns = now_ns();
+    pthread_t* workers = malloc(num_workers * sizeof(pthread_t));
+    for (int k = 0; k < num_workers; k++) {
+        if (pthread_create(&workers[k], NULL, worker_main, NULL) != 0) {
+            perror("Failed to start worker");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    printf("Match server: %d workers (%s kernel) on %s\n", num_workers, tick_kernel_name(kernel_level), path);
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (!terminate) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        for (int k = 0; k < n; k++) {
+            Connection* c = events[k].data.ptr;
+            if (!c) {
+                int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+                if (fd < 0) continue;
+                c = calloc(1, sizeof(Connection));
+                c->fd = fd;
+                c->reading = 1;
+                c->events = EPOLLIN;
+                atomic_init(&c->refs, 1);
+                pthread_mutex_init(&c->lock, NULL);
+                struct epoll_event cev = { .events = EPOLLIN, .data.ptr = c };
+                epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &cev);
+                continue;
+            }
+
+            // A client that closed only its sending side still gets the results it asked for
+            uint32_t ready = events[k].events;
+            int gone = (ready & (EPOLLERR | EPOLLHUP)) != 0;
+            if (!gone && (ready & EPOLLOUT)) gone = connection_flush(c) < 0;
+            if (!gone && (ready & EPOLLIN)) {
+                int result = read_requests(c);
+                gone = result < 0;
+                if (result == 0) {
+                    pthread_mutex_lock(&c->lock);
+                    c->reading = 0;
+                    connection_watch(c);
+                    pthread_mutex_unlock(&c->lock);
+                }
+            }
+            connection_close(c, gone);
+        }
+    }
+
+    // Matches still queued are dropped; the ones being played finish their turn first
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    for (int k = 0; k < num_workers; k++) pthread_join(workers[k], NULL);
+    for (Job* job = queue_head; job; ) {
+        Job* next = job->next;
+        match_free(&job->match);
+        free(job);
+        job = next;
+    }
+    printf("Match server: %ld matches played in %.1f s\n", atomic_load(&matches_done), (now_ns() - start_ns) / 1e9);
+
+    close(epoll_fd);
+    close(listen_fd);
+    unlink(path);
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,307 @@
+#include "header.h"
+#include "metrics.h"
+#include <stdatomic.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Histogram buckets: powers of two from 1 us up to about 1 s, then +Inf
+#define HIST_BUCKETS 21
+
+typedef struct {
+    _Atomic long buckets[HIST_BUCKETS + 1];
+    _Atomic long count;
+    _Atomic long sum_ns;
+} Histogram;
+
+// Reply latency of one player slot, so a slow one stands out
+typedef struct {
+    _Atomic long count;
+    _Atomic long sum_ns;
+    _Atomic long max_ns;
+} SlotReplies;
+
+struct Metrics {
+    int num_players;
+    int num_teams;
+    const char* transport;
+    long started_ns;
+
+    _Atomic long ticks;
+    _Atomic long missed;
+    Histogram phases[METRIC_PHASES];
+    Histogram replies;
+    SlotReplies* slot_replies;
+    _Atomic long reply_waits;
+    _Atomic long late;
+    _Atomic long restarts;
+    _Atomic long positions_sent;
+    _Atomic long falls;
+    _Atomic long recoveries;
+    _Atomic long fallen;
+    _Atomic long round;
+    _Atomic long rounds_won;
+    _Atomic long rounds_tied;
+    _Atomic long* scores;
+    char* was_fallen;           // Referee side only
+
+    // Server side
+    int listen_fd;
+    pthread_t server;
+    char path[108];
+    long last_ticks, last_ns;   // For the tick rate between two scrapes
+};
+
+static const char* phase_names[METRIC_PHASES] = { "ranking", "exchange", "tick" };
+
+// Single writer: a plain load and store is enough, and cheaper than a locked add
+static inline void bump(_Atomic long* counter, long by) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + by,
+                          memory_order_relaxed);
+}
+
+static inline void set(_Atomic long* gauge, long value) {
+    atomic_store_explicit(gauge, value, memory_order_relaxed);
+}
+
+static inline long get(_Atomic long* value) {
+    return atomic_load_explicit(value, memory_order_relaxed);
+}
+
+static void observe(Histogram* h, long ns) {
+    long us = ns / 1000;
+    int bucket = us <= 1 ? 0 : 64 - __builtin_clzl(us - 1);
+    if (bucket > HIST_BUCKETS) bucket = HIST_BUCKETS;
+    bump(&h->buckets[bucket], 1);
+    bump(&h->count, 1);
+    bump(&h->sum_ns, ns);
+}
+
+long metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void metrics_tick(Metrics* m, long missed) {
+    if (!m) return;
+    bump(&m->ticks, 1);
+    if (missed) bump(&m->missed, missed);
+}
+
+void metrics_phase(Metrics* m, int phase, long ns) {
+    if (m) observe(&m->phases[phase], ns);
+}
+
+void metrics_reply(Metrics* m, int slot, long ns) {
+    if (!m) return;
+    observe(&m->replies, ns);
+    SlotReplies* r = &m->slot_replies[slot];
+    bump(&r->count, 1);
+    bump(&r->sum_ns, ns);
+    if (ns > get(&r->max_ns)) set(&r->max_ns, ns);
+}
+
+void metrics_reply_wait(Metrics* m) {
+    if (m) bump(&m->reply_waits, 1);
+}
+
+void metrics_late(Metrics* m, int count) {
+    if (m && count) bump(&m->late, count);
+}
+
+void metrics_restart(Metrics* m) {
+    if (m) bump(&m->restarts, 1);
+}
+
+void metrics_positions_sent(Metrics* m, int count) {
+    if (m && count) bump(&m->positions_sent, count);
+}
+
+void metrics_players(Metrics* m, const PlayerStore* store) {
+    if (!m) return;
+    long falls = 0, recoveries = 0, fallen = 0;
+    for (int i = 0; i < m->num_players; i++) {
+        char down = store->energy[i] == 0;
+        falls += down && !m->was_fallen[i];
+        recoveries += !down && m->was_fallen[i];
+        fallen += down;
+        m->was_fallen[i] = down;
+    }
+    if (falls) bump(&m->falls, falls);
+    if (recoveries) bump(&m->recoveries, recoveries);
+    set(&m->fallen, fallen);
+}
+
+void metrics_round(Metrics* m, int round, int winner, const int scores[]) {
+    if (!m) return;
+    set(&m->round, round);
+    bump(winner ? &m->rounds_won : &m->rounds_tied, 1);
+    for (int t = 0; t < m->num_teams; t++) set(&m->scores[t], scores[t]);
+}
+
+// ##################################
+// Prometheus text exposition of every metric
+// ##################################
+static void write_histogram(FILE* out, const char* name, const char* label, Histogram* h) {
+    long cumulative = 0;
+    const char* sep = label[0] ? "," : "";
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        cumulative += get(&h->buckets[b]);
+        fprintf(out, "%s_bucket{%s%sle=\"%g\"} %ld\n", name, label, sep, (1L << b) / 1e6, cumulative);
+    }
+    cumulative += get(&h->buckets[HIST_BUCKETS]);
+    fprintf(out, "%s_bucket{%s%sle=\"+Inf\"} %ld\n", name, label, sep, cumulative);
+    const char* lbrace = label[0] ? "{" : "", *rbrace = label[0] ? "}" : "";
+    fprintf(out, "%s_sum%s%s%s %.9f\n", name, lbrace, label, rbrace, get(&h->sum_ns) / 1e9);
+    fprintf(out, "%s_count%s%s%s %ld\n", name, lbrace, label, rbrace, get(&h->count));
+}
+
+void metrics_write(Metrics* m, FILE* out) {
+    long now = metrics_now_ns();
+    long ticks = get(&m->ticks);
+    double rate = now > m->last_ns ? (ticks - m->last_ticks) * 1e9 / (now - m->last_ns) : 0;
+    m->last_ticks = ticks;
+    m->last_ns = now;
+
+    fprintf(out, "# HELP rope_info Referee setup.\n# TYPE rope_info gauge\n");
+    fprintf(out, "rope_info{transport=\"%s\",players=\"%d\",teams=\"%d\"} 1\n", m->transport, m->num_players,
+            m->num_teams);
+    fprintf(out, "# HELP rope_uptime_seconds Time since the referee started.\n# TYPE rope_uptime_seconds gauge\n");
+    fprintf(out, "rope_uptime_seconds %.3f\n", (now - m->started_ns) / 1e9);
+    fprintf(out, "# HELP rope_ticks_total Ticks played.\n# TYPE rope_ticks_total counter\n");
+    fprintf(out, "rope_ticks_total %ld\n", ticks);
+    fprintf(out, "# HELP rope_ticks_per_second Tick rate since the previous scrape.\n# TYPE rope_ticks_per_second gauge\n");
+    fprintf(out, "rope_ticks_per_second %.3f\n", rate);
+    fprintf(out, "# HELP rope_ticks_missed_total Tick deadlines missed while the referee was busy.\n"
+                 "# TYPE rope_ticks_missed_total counter\n");
+    fprintf(out, "rope_ticks_missed_total %ld\n", get(&m->missed));
+
+    fprintf(out, "# HELP rope_phase_seconds Duration of each tick phase.\n# TYPE rope_phase_seconds histogram\n");
+    for (int p = 0; p < METRIC_PHASES; p++) {
+        char label[32];
+        sprintf(label, "phase=\"%s\"", phase_names[p]);
+        write_histogram(out, "rope_phase_seconds", label, &m->phases[p]);
+    }
+    fprintf(out, "# HELP rope_reply_seconds Time from a tick request to each player's reply.\n"
+                 "# TYPE rope_reply_seconds histogram\n");
+    write_histogram(out, "rope_reply_seconds", "", &m->replies);
+    fprintf(out, "# HELP rope_player_reply_seconds Time from a tick request to the reply, per player.\n"
+                 "# TYPE rope_player_reply_seconds summary\n");
+    for (int i = 0; i < m->num_players; i++) {
+        fprintf(out, "rope_player_reply_seconds_sum{player=\"%d\"} %.9f\n", i, get(&m->slot_replies[i].sum_ns) / 1e9);
+        fprintf(out, "rope_player_reply_seconds_count{player=\"%d\"} %ld\n", i, get(&m->slot_replies[i].count));
+    }
+    fprintf(out, "# HELP rope_player_reply_max_seconds Slowest reply of each player.\n"
+                 "# TYPE rope_player_reply_max_seconds gauge\n");
+    for (int i = 0; i < m->num_players; i++)
+        fprintf(out, "rope_player_reply_max_seconds{player=\"%d\"} %.9f\n", i, get(&m->slot_replies[i].max_ns) / 1e9);
+    fprintf(out, "# HELP rope_reply_waits_total Times the referee waited for more replies.\n"
+                 "# TYPE rope_reply_waits_total counter\n");
+    fprintf(out, "rope_reply_waits_total %ld\n", get(&m->reply_waits));
+    fprintf(out, "# HELP rope_replies_late_total Replies missing at a tick's reply deadline.\n"
+                 "# TYPE rope_replies_late_total counter\n");
+    fprintf(out, "rope_replies_late_total %ld\n", get(&m->late));
+    fprintf(out, "# HELP rope_players_restarted_total Lost player processes replaced during the match.\n"
+                 "# TYPE rope_players_restarted_total counter\n");
+    fprintf(out, "rope_players_restarted_total %ld\n", get(&m->restarts));
+    fprintf(out, "# HELP rope_positions_sent_total Position changes handed out to players.\n"
+                 "# TYPE rope_positions_sent_total counter\n");
+    fprintf(out, "rope_positions_sent_total %ld\n", get(&m->positions_sent));
+
+    fprintf(out, "# HELP rope_falls_total Players that fell.\n# TYPE rope_falls_total counter\n");
+    fprintf(out, "rope_falls_total %ld\n", get(&m->falls));
+    fprintf(out, "# HELP rope_recoveries_total Fallen players that got back up.\n# TYPE rope_recoveries_total counter\n");
+    fprintf(out, "rope_recoveries_total %ld\n", get(&m->recoveries));
+    fprintf(out, "# HELP rope_players_fallen Players currently fallen or recovering.\n# TYPE rope_players_fallen gauge\n");
+    fprintf(out, "rope_players_fallen %ld\n", get(&m->fallen));
+
+    fprintf(out, "# HELP rope_round Last round played.\n# TYPE rope_round gauge\n");
+    fprintf(out, "rope_round %ld\n", get(&m->round));
+    fprintf(out, "# HELP rope_rounds_total Rounds finished, by result.\n# TYPE rope_rounds_total counter\n");
+    fprintf(out, "rope_rounds_total{result=\"win\"} %ld\n", get(&m->rounds_won));
+    fprintf(out, "rope_rounds_total{result=\"tie\"} %ld\n", get(&m->rounds_tied));
+    fprintf(out, "# HELP rope_score Rounds won by each team.\n# TYPE rope_score gauge\n");
+    for (int t = 0; t < m->num_teams; t++)
+        fprintf(out, "rope_score{team=\"%d\"} %ld\n", t + 1, get(&m->scores[t]));
+}
+
+// ##################################
+// Server thread: one snapshot per connection. The request (if any) is read and ignored,
+// and the answer carries a minimal HTTP header so Prometheus and curl can scrape it.
+// ##################################
+static void* serve(void* arg) {
+    Metrics* m = arg;
+    while (1) {
+        int client = accept4(m->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;                  // Listening socket shut down
+        }
+
+        char request[1024];
+        struct pollfd pfd = { client, POLLIN, 0 };
+        if (poll(&pfd, 1, 100) > 0) recv(client, request, sizeof(request), MSG_DONTWAIT);
+
+        char* body = NULL;
+        size_t length = 0;
+        FILE* out = open_memstream(&body, &length);
+        metrics_write(m, out);
+        fclose(out);
+
+        char header[128];
+        int n = sprintf(header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                "Content-Length: %zu\r\n\r\n", length);
+        send(client, header, n, MSG_NOSIGNAL);
+        send(client, body, length, MSG_NOSIGNAL);
+        free(body);
+        close(client);
+    }
+    return NULL;
+}
+
+Metrics* metrics_create(const char* socket_path, int num_players, int num_teams, const char* transport) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    Metrics* m = calloc(1, sizeof(Metrics));
+    m->num_players = num_players;
+    m->num_teams = num_teams;
+    m->transport = transport;
+    m->scores = calloc(num_teams, sizeof(_Atomic long));
+    m->was_fallen = calloc(num_players, 1);
+    m->slot_replies = calloc(num_players, sizeof(SlotReplies));
+    m->started_ns = m->last_ns = metrics_now_ns();
+    strcpy(m->path, socket_path);
+
+    m->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(socket_path);
+    if (m->listen_fd < 0 || bind(m->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(m->listen_fd, 16) < 0 || pthread_create(&m->server, NULL, serve, m) != 0) {
+        int saved = errno;
+        if (m->listen_fd >= 0) close(m->listen_fd);
+        free(m->scores);
+        free(m->was_fallen);
+        free(m->slot_replies);
+        free(m);
+        errno = saved;
+        return NULL;
+    }
+    return m;
+}
+
+void metrics_destroy(Metrics* m) {
+    if (!m) return;
+    shutdown(m->listen_fd, SHUT_RDWR);  // Wakes the server out of accept
+    pthread_join(m->server, NULL);
+    close(m->listen_fd);
+    unlink(m->path);
+    free(m->scores);
+    free(m->was_fallen);
+    free(m->slot_replies);
+    free(m);
+}
@@ -0,0 +1,425 @@
+#include "header.h"
+#include "constants.h"
+#include "output_sink.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// The ring holds about this many bytes of records (at least MIN_SLOTS of them)
+#define RING_BYTES (8 << 20)
+#define MIN_SLOTS  16
+#define MAX_SLOTS  1024
+
+// Record types
+#define REC_START     1
+#define REC_TICK      2
+#define REC_ROUND     3
+#define REC_GAME_OVER 4
+#define REC_CLOSE     5     // Last record: the writer stops after it
+
+// Every slot: the record, then the players of tick and round records
+typedef struct {
+    int type;
+    long dropped;               // Tick records dropped just before this one
+    union {
+        struct { int round, tick; long clock_tick; } tick;
+        OutputRound round;
+        struct { int winner; long clock_tick; } over;
+    };
+} SinkRecord;
+
+struct OutputSink {
+    OutputFormat format;
+    FILE* out;
+    GameConfig config;
+    int num_players;
+    pthread_t writer;
+
+    // Ring of records: the referee advances head, the writer advances tail. Both are
+    // futex words, so either side can sleep until the other moves.
+    char* slots;
+    size_t slot_size;
+    uint32_t num_slots;
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    atomic_int writer_sleeping;
+    atomic_int referee_sleeping;
+    long dropped;               // Referee side: ticks dropped since the last record queued
+
+    // Writer side
+    char transport[16], bus_name[64], metrics_path[108], kernel[16];
+    unsigned int seed;
+    int has_metrics, has_kernel;
+    int* prev_energy;
+    int* totals;
+};
+
+static const char* format_names[] = { "human", "csv", "jsonl", "quiet" };
+
+int output_format_parse(const char* name) {
+    for (int f = 0; f < 4; f++) {
+        if (strcmp(name, format_names[f]) == 0) return f;
+    }
+    return -1;
+}
+
+static long futex(_Atomic uint32_t* word, int op, uint32_t value) {
+    return syscall(SYS_futex, (uint32_t*)word, op, value, NULL, NULL, 0);
+}
+
+static SinkRecord* slot_record(OutputSink* sink, uint32_t seq) {
+    return (SinkRecord*)(sink->slots + (size_t)(seq % sink->num_slots) * sink->slot_size);
+}
+
+static PlayerStats* record_players(SinkRecord* rec) {
+    return (PlayerStats*)(rec + 1);
+}
+
+// ##################################
+// Referee side. Returns the next free slot, or NULL when the ring is full and the record
+// may be dropped; otherwise waits for the writer to free a slot.
+// ##################################
+static SinkRecord* claim(OutputSink* sink, int may_drop) {
+    uint32_t head = atomic_load_explicit(&sink->head, memory_order_relaxed);
+    while (head - atomic_load_explicit(&sink->tail, memory_order_acquire) >= sink->num_slots) {
+        if (may_drop) {
+            sink->dropped++;
+            return NULL;
+        }
+        uint32_t tail = atomic_load(&sink->tail);
+        atomic_store(&sink->referee_sleeping, 1);
+        if (head - atomic_load(&sink->tail) >= sink->num_slots) futex(&sink->tail, FUTEX_WAIT_PRIVATE, tail);
+        atomic_store(&sink->referee_sleeping, 0);
+    }
+    SinkRecord* rec = slot_record(sink, head);
+    rec->dropped = sink->dropped;
+    sink->dropped = 0;
+    return rec;
+}
+
+// Hands the claimed slot to the writer, waking it only if it went to sleep
+static void publish(OutputSink* sink) {
+    atomic_store(&sink->head, atomic_load_explicit(&sink->head, memory_order_relaxed) + 1);
+    if (atomic_load(&sink->writer_sleeping)) futex(&sink->head, FUTEX_WAKE_PRIVATE, 1);
+}
+
+static void copy_players(OutputSink* sink, SinkRecord* rec, const PlayerStore* store) {
+    PlayerStats* players = record_players(rec);
+    for (int i = 0; i < sink->num_players; i++) {
+        players[i].player_id = i % sink->config.team_size;
+        players[i].position = store->position[i];
+        players[i].energy = store->energy[i];
+        players[i].effort = store->effort[i];
+    }
+}
+
+static void copy_string(char* to, size_t size, const char* from) {
+    snprintf(to, size, "%s", from ? from : "");
+}
+
+void output_start(OutputSink* sink, const OutputStart* start) {
+    // Only read by the writer after the record is published
+    sink->seed = start->seed;
+    copy_string(sink->transport, sizeof(sink->transport), start->transport);
+    copy_string(sink->bus_name, sizeof(sink->bus_name), start->bus_name);
+    copy_string(sink->metrics_path, sizeof(sink->metrics_path), start->metrics_path);
+    copy_string(sink->kernel, sizeof(sink->kernel), start->kernel);
+    sink->has_metrics = start->metrics_path != NULL;
+    sink->has_kernel = start->kernel != NULL;
+    if (sink->format == OUTPUT_QUIET) return;
+
+    SinkRecord* rec = claim(sink, 0);
+    rec->type = REC_START;
+    publish(sink);
+}
+
+void output_tick(OutputSink* sink, int round, int tick, long clock_tick, const PlayerStore* store) {
+    if (sink->format == OUTPUT_QUIET) return;
+    SinkRecord* rec = claim(sink, 1);
+    if (!rec) return;
+    rec->type = REC_TICK;
+    rec->tick.round = round;
+    rec->tick.tick = tick;
+    rec->tick.clock_tick = clock_tick;
+    copy_players(sink, rec, store);
+    publish(sink);
+}
+
+void output_round(OutputSink* sink, const OutputRound* result, const PlayerStore* store) {
+    if (sink->format == OUTPUT_QUIET) return;
+    SinkRecord* rec = claim(sink, 0);
+    rec->type = REC_ROUND;
+    rec->round = *result;
+    copy_players(sink, rec, store);
+    publish(sink);
+}
+
+void output_game_over(OutputSink* sink, int winner, long clock_tick) {
+    SinkRecord* rec = claim(sink, 0);
+    rec->type = REC_GAME_OVER;
+    rec->over.winner = winner;
+    rec->over.clock_tick = clock_tick;
+    publish(sink);
+}
+
+// Adds up each team's effort
+static void team_totals(OutputSink* sink, const PlayerStats* players) {
+    for (int t = 0; t < sink->config.num_teams; t++) {
+        sink->totals[t] = 0;
+        for (int k = 0; k < sink->config.team_size; k++)
+            sink->totals[t] += players[t * sink->config.team_size + k].effort;
+    }
+}
+
+// ##################################
+// Human format: the referee's classic terminal report, emoji and colors included
+// ##################################
+static void human_record(OutputSink* sink, SinkRecord* rec) {
+    FILE* out = sink->out;
+    int num_teams = sink->config.num_teams, team_size = sink->config.team_size;
+    PlayerStats* players = record_players(rec);
+
+    if (rec->dropped) fprintf(out, "(%ld ticks not shown, output fell behind)\n", rec->dropped);
+
+    switch (rec->type) {
+    case REC_START:
+        fprintf(out, "Seed: %u\nState bus: %s\n", sink->seed, sink->bus_name);
+        if (sink->has_metrics) fprintf(out, "Metrics: %s\n", sink->metrics_path);
+        if (sink->has_kernel) fprintf(out, "Batch kernel: %s\n", sink->kernel);
+        break;
+
+    case REC_TICK:
+        if (rec->tick.tick == 1) fprintf(out, "\n=== Round %d ===\n\n", rec->tick.round);
+        fprintf(out, "⏲️  Round %d - Tick %d\n", rec->tick.round, rec->tick.tick);
+        for (int t = 0; t < num_teams; t++) {
+            fprintf(out, "%sTeam %d:\nPlayer | Position | Energy\n", t ? "\n" : "", t + 1);
+            for (int k = 0; k < team_size; k++) {
+                PlayerStats* p = &players[t * team_size + k];
+                fprintf(out, "T%d-P%d   |    %d     |   %3d %s\n",
+                        t + 1, k, p->position, p->energy, p->energy == 0 ? "FALLEN" : "");
+            }
+        }
+        fprintf(out, "-----------------------------------------\n");
+        break;
+
+    case REC_ROUND: {
+        OutputRound* r = &rec->round;
+        if (r->end == ROUND_END_DURATION)
+            fprintf(out, "\n⏰ Game duration of %d seconds reached! Game ends now with a tie.\n",
+                    sink->config.game_duration);
+
+        fprintf(out, "\n=== Round %d Results ===\n", r->round);
+        for (int t = 0; t < num_teams; t++) {
+            fprintf(out, "%sTeam %d:\nPlayer | Position | Energy | Effort\n", t ? "\n" : "", t + 1);
+            for (int k = 0; k < team_size; k++) {
+                int i = t * team_size + k;
+                PlayerStats* p = &players[i];
+                char* change = " ";
+                if (p->energy < sink->prev_energy[i]) change = " 🔻";
+                else if (p->energy > sink->prev_energy[i]) change = " 🔺";
+
+                if (p->energy == 0)
+                    fprintf(out, "T%d-P%d   |    %d     |   %3d   |  %sFALLEN%s%s\n",
+                            t + 1, k, p->position, p->energy, RED, RESET, change);
+                else
+                    fprintf(out, "T%d-P%d   |    %d     |   %3d   |  %3d%s\n",
+                            t + 1, k, p->position, p->energy, p->effort, change);
+                sink->prev_energy[i] = p->energy;
+            }
+        }
+
+        team_totals(sink, players);
+        fprintf(out, "\n>> ");
+        for (int t = 0; t < num_teams; t++)
+            fprintf(out, "%sTeam %d Total: %d", t ? "\t| " : "", t + 1, sink->totals[t]);
+        fprintf(out, "\n");
+        fprintf(out, "Avg tick exchange (%s): %ld us\n", sink->transport, r->exchange_us);
+        fprintf(out, "Round length: %ld ms (%d ticks of %d ms, %ld missed)\n",
+                r->length_ms, r->ticks, sink->config.tick_ms, r->missed);
+        if (r->late || r->restarted)
+            fprintf(out, "Late replies: %ld, players restarted: %ld\n", r->late, r->restarted);
+
+        if (r->winner) fprintf(out, "\U0001F3C5 Round %d Winner: Team %d\n", r->round, r->winner);
+        else fprintf(out, "\U0001F91D Round %d is a tie or threshold not met!\n", r->round);
+
+        if (r->next == ROUND_NEXT_TWO_IN_ROW)
+            fprintf(out, "\n\U0001F389 Team %d won 2 rounds in a row! Game ends early.\n", r->winner);
+        else if (r->next == ROUND_NEXT_OUT_OF_TIME)
+            fprintf(out, "\n⏰ Game duration of %d seconds reached! Game ends now with a tie.\n",
+                    sink->config.game_duration);
+        else
+            fprintf(out, "\n⏳ Preparing for the next round...\n");
+        break;
+    }
+
+    case REC_GAME_OVER:
+        fprintf(out, "\n=== Game Over ===\n");
+        if (rec->over.winner) fprintf(out, "\U0001F3C6 Final Winner: Team %d!\n", rec->over.winner);
+        else fprintf(out, "\U0001F3C1 Final Result: It's a tie!\n");
+        break;
+    }
+}
+
+// ##################################
+// CSV format: one row per player for ticks and round results, one row for the game result
+// ##################################
+static void csv_record(OutputSink* sink, SinkRecord* rec) {
+    FILE* out = sink->out;
+    int team_size = sink->config.team_size;
+    PlayerStats* players = record_players(rec);
+
+    if (rec->dropped) fprintf(out, "# %ld tick records dropped\n", rec->dropped);
+
+    switch (rec->type) {
+    case REC_START:
+        fprintf(out, "# seed=%u transport=%s bus=%s\n", sink->seed, sink->transport, sink->bus_name);
+        fprintf(out, "event,round,tick,clock_tick,team,player,position,energy,effort,winner\n");
+        break;
+    case REC_TICK:
+        for (int i = 0; i < sink->num_players; i++)
+            fprintf(out, "tick,%d,%d,%ld,%d,%d,%d,%d,%d,\n", rec->tick.round, rec->tick.tick,
+                    rec->tick.clock_tick, i / team_size + 1, i % team_size, players[i].position,
+                    players[i].energy, players[i].effort);
+        break;
+    case REC_ROUND:
+        for (int i = 0; i < sink->num_players; i++)
+            fprintf(out, "round,%d,%d,%ld,%d,%d,%d,%d,%d,%d\n", rec->round.round, rec->round.ticks,
+                    rec->round.clock_tick, i / team_size + 1, i % team_size, players[i].position,
+                    players[i].energy, players[i].effort, rec->round.winner);
+        break;
+    case REC_GAME_OVER:
+        fprintf(out, "game_over,,,%ld,,,,,,%d\n", rec->over.clock_tick, rec->over.winner);
+        break;
+    }
+}
+
+// ##################################
+// JSON lines: one object per record, player fields as arrays in slot order
+// ##################################
+static void json_array(FILE* out, const char* name, const int* values, int count, size_t stride) {
+    fprintf(out, ",\"%s\":[", name);
+    for (int i = 0; i < count; i++)
+        fprintf(out, "%s%d", i ? "," : "", *(const int*)((const char*)values + i * stride));
+    fprintf(out, "]");
+}
+
+static void json_players(OutputSink* sink, PlayerStats* players) {
+    FILE* out = sink->out;
+    team_totals(sink, players);
+    json_array(out, "totals", sink->totals, sink->config.num_teams, sizeof(int));
+    json_array(out, "position", &players[0].position, sink->num_players, sizeof(PlayerStats));
+    json_array(out, "energy", &players[0].energy, sink->num_players, sizeof(PlayerStats));
+    json_array(out, "effort", &players[0].effort, sink->num_players, sizeof(PlayerStats));
+}
+
+static void jsonl_record(OutputSink* sink, SinkRecord* rec) {
+    static const char* ends[] = { "threshold", "duration" };
+    static const char* nexts[] = { "continue", "two_in_a_row", "out_of_time" };
+    FILE* out = sink->out;
+
+    switch (rec->type) {
+    case REC_START:
+        fprintf(out, "{\"event\":\"start\",\"seed\":%u,\"transport\":\"%s\",\"bus\":\"%s\",\"team_size\":%d,"
+                     "\"num_teams\":%d,\"tick_ms\":%d", sink->seed, sink->transport, sink->bus_name,
+                sink->config.team_size, sink->config.num_teams, sink->config.tick_ms);
+        if (sink->has_metrics) fprintf(out, ",\"metrics\":\"%s\"", sink->metrics_path);
+        if (sink->has_kernel) fprintf(out, ",\"kernel\":\"%s\"", sink->kernel);
+        break;
+    case REC_TICK:
+        fprintf(out, "{\"event\":\"tick\",\"round\":%d,\"tick\":%d,\"clock_tick\":%ld", rec->tick.round,
+                rec->tick.tick, rec->tick.clock_tick);
+        json_players(sink, record_players(rec));
+        break;
+    case REC_ROUND: {
+        OutputRound* r = &rec->round;
+        fprintf(out, "{\"event\":\"round\",\"round\":%d,\"ticks\":%d,\"clock_tick\":%ld,\"winner\":%d,"
+                     "\"end\":\"%s\",\"next\":\"%s\",\"exchange_us\":%ld,\"length_ms\":%ld,\"missed\":%ld,"
+                     "\"late\":%ld,\"restarted\":%ld",
+                r->round, r->ticks, r->clock_tick, r->winner, ends[r->end], nexts[r->next], r->exchange_us,
+                r->length_ms, r->missed, r->late, r->restarted);
+        json_players(sink, record_players(rec));
+        break;
+    }
+    case REC_GAME_OVER:
+        fprintf(out, "{\"event\":\"game_over\",\"clock_tick\":%ld,\"winner\":%d", rec->over.clock_tick,
+                rec->over.winner);
+        break;
+    }
+    if (rec->dropped) fprintf(out, ",\"dropped_ticks\":%ld", rec->dropped);
+    fprintf(out, "}\n");
+}
+
+// ##################################
+// Writer thread: formats records until the referee closes the sink. Output is flushed
+// whenever the ring runs empty, so a terminal still sees each tick as it happens.
+// ##################################
+static void* writer_main(void* arg) {
+    OutputSink* sink = arg;
+    uint32_t tail = 0;
+    while (1) {
+        uint32_t head = atomic_load(&sink->head);
+        if (head == tail) {
+            fflush(sink->out);
+            atomic_store(&sink->writer_sleeping, 1);
+            if (atomic_load(&sink->head) == tail) futex(&sink->head, FUTEX_WAIT_PRIVATE, tail);
+            atomic_store(&sink->writer_sleeping, 0);
+            continue;
+        }
+
+        for (; tail != head; tail++) {
+            SinkRecord* rec = slot_record(sink, tail);
+            if (rec->type == REC_CLOSE) {
+                fflush(sink->out);
+                return NULL;
+            }
+            switch (sink->format) {
+                case OUTPUT_HUMAN: case OUTPUT_QUIET: human_record(sink, rec); break;
+                case OUTPUT_CSV: csv_record(sink, rec); break;
+                case OUTPUT_JSONL: jsonl_record(sink, rec); break;
+            }
+            atomic_store(&sink->tail, tail + 1);
+            if (atomic_load(&sink->referee_sleeping)) futex(&sink->tail, FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+}
+
+OutputSink* output_sink_create(OutputFormat format, FILE* out, const GameConfig* cfg, int num_players) {
+    OutputSink* sink = calloc(1, sizeof(OutputSink));
+    if (!sink) return NULL;
+    sink->format = format;
+    sink->out = out;
+    sink->config = *cfg;
+    sink->num_players = num_players;
+
+    sink->slot_size = (sizeof(SinkRecord) + num_players * sizeof(PlayerStats) + 63) / 64 * 64;
+    size_t slots = RING_BYTES / sink->slot_size;
+    sink->num_slots = slots < MIN_SLOTS ? MIN_SLOTS : slots > MAX_SLOTS ? MAX_SLOTS : slots;
+    sink->slots = malloc(sink->num_slots * sink->slot_size);
+    sink->prev_energy = calloc(num_players, sizeof(int));
+    sink->totals = calloc(cfg->num_teams, sizeof(int));
+    int err = (!sink->slots || !sink->prev_energy || !sink->totals) ? ENOMEM :
+              pthread_create(&sink->writer, NULL, writer_main, sink);
+    if (err) {
+        free(sink->slots);
+        free(sink->prev_energy);
+        free(sink->totals);
+        free(sink);
+        errno = err;
+        return NULL;
+    }
+    return sink;
+}
+
+void output_sink_close(OutputSink* sink) {
+    if (!sink) return;
+    SinkRecord* rec = claim(sink, 0);
+    rec->type = REC_CLOSE;
+    publish(sink);
+    pthread_join(sink->writer, NULL);
+
+    free(sink->slots);
+    free(sink->prev_energy);
+    free(sink->totals);
+    free(sink);
+}
@@ -1,186 +1,470 @@
 #include "header.h"
 #include "structs.h"
+#include "rules.h"
+#include "player_store.h"
+#include "protocol.h"
+#include "config.h"
+#include "player_pool.h"
+#include "transport.h"
+#include "trace.h"
+#include "realtime.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
 
 // ##################################
 // Stores player status and config values used during the game
 // ##################################
-Player player;
-int min_energy, max_energy;
-int min_decrease, max_decrease;
-int min_recovery, max_recovery;
-int win_threshold;
+GameConfig config;
+const SharedConfig* shared_config;  // The referee's copy, updated between ticks (NULL over sockets)
+uint32_t config_seen = 0;
+int player_id;
+int my_slot;
+int read_fd = -1, write_fd = -1;
 volatile sig_atomic_t terminate = 0;
 
+// This player's state: entry `me` of the shared store with shm, or a store of its own with pipes
+PlayerStore state;
+int me = 0;
+
+// Shared tick segment (NULL when using pipes)
+SharedTick* tick = NULL;
+size_t tick_size = 0;
+int referee_fd = -1;            // pidfd of the referee, watched while waiting for a tick
+uint32_t* replies;              // Last tick each player answered, in the segment
+int64_t* reply_times;           // When each player answered, for the referee's latency metrics
+
+// Zygote pool (see player_pool.h): one entry per forked player, with the pool's end of
+// its socket pair. Referees connect on listen_fd; their connections are in clients.
+typedef struct {
+    pid_t pid;
+    int fd;
+    int idle;
+} PoolWorker;
+
+PoolWorker* workers = NULL;
+int num_workers = 0, pool_size = POOL_DEFAULT_SIZE;
+int* clients = NULL;
+int num_clients = 0;
+int listen_fd = -1, pool_epoll = -1;
+
+// Players joining over a socket retry a refused connection this often before giving up
+#define CONNECT_TRIES 100
+#define CONNECT_RETRY_MS 100
+
+// Handles exit signals to shut down cleanly
+void handle_termination(int signum) {
+    terminate = 1;
+}
+
 // ##################################
-// Loads energy, decrease, and recovery settings from config
+// Tells the referee this player is ready; with shm, after checking both speak the same protocol
 // ##################################
-void read_config(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        perror("Failed to open config file");
+void send_hello(int slot) {
+    if (tick) {
+        if (tick->version != PROTOCOL_VERSION) {
+            fprintf(stderr, "Error: Referee speaks protocol version %d, player %d\n", tick->version, PROTOCOL_VERSION);
+            exit(EXIT_FAILURE);
+        }
+        sem_post(&tick->replies);
+        return;
+    }
+    Message msg;
+    msg.hello.slot = slot;
+    msg.hello.player_id = player_id;
+    if (protocol_send(write_fd, &msg, MSG_HELLO) < 0) {
+        perror("Failed to send hello");
         exit(EXIT_FAILURE);
     }
+}
 
-    char line[100];
+// ##################################
+// Blocks until the referee starts the next tick and returns its number (0 to stop).
+// Over the pipe the request carries this player's position; with shm it is already in the store.
+// ##################################
+uint32_t next_tick(uint32_t last) {
+    while (!terminate) {
+        if (tick) {
+            uint32_t t = protocol_shm_wait(tick, last, referee_fd);
+            if (t == PROTOCOL_TICK_STOP) return 0;
+            if (t) return t;
+            continue;
+        }
 
-    // Read energy range
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d %d", &min_energy, &max_energy) != 2) {
-        fprintf(stderr, "Error: Invalid energy range in config\n"); exit(EXIT_FAILURE);
+        Message msg;
+        int n = protocol_receive(read_fd, &msg, MSG_TICK);
+        if (n == 0) return 0;           // Referee closed the pipe
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to read tick");
+            return 0;
+        }
+        state.position[me] = msg.tick.position;
+        uint32_t t = msg.tick.tick;
+
+        // New settings (over sockets) and a state to take over come right behind the request
+        int follows = msg.tick.follows;
+        if (follows & FOLLOWS_CONFIG) {
+            if (protocol_receive(read_fd, &msg, MSG_CONFIG) <= 0) {
+                perror("Failed to read config");
+                return 0;
+            }
+            config = msg.config.config;
+        }
+        if (follows & FOLLOWS_STATE) {
+            if (protocol_receive(read_fd, &msg, MSG_STATE) <= 0) {
+                perror("Failed to read state");
+                return 0;
+            }
+            state.energy[me] = msg.state.energy;
+            state.active[me] = msg.state.active;
+            state.recovery[me] = msg.state.recovery;
+            state.ticks[me] = msg.state.ticks;
+        }
+        return t;
     }
+    return 0;
+}
+
+// ##################################
+// Plays one tick: energy update, then effort at the position handed out, then the reply
+// ##################################
+void play_tick(uint32_t t) {
+    trace(TRACE_PLAY, TRACE_BEGIN, t, 0);
+    trace(TRACE_REQUEST, TRACE_FLOW_STEP, t, trace_request_id(t, my_slot));
+    if (shared_config) config_refresh(shared_config, &config, &config_seen);
+    player_round(&state, me, &config);
+    player_effort(&state, me);
 
-    // Read decrease range
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d %d", &min_decrease, &max_decrease) != 2) {
-        fprintf(stderr, "Error: Invalid decrease range in config\n"); exit(EXIT_FAILURE);
+    if (tick) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        reply_times[me] = now.tv_sec * 1000000000LL + now.tv_nsec;
+        __atomic_store_n(&replies[me], t, __ATOMIC_RELEASE);
+        sem_post(&tick->replies);
+        trace(TRACE_REPLY_SENT, TRACE_INSTANT, t, 0);
+        trace(TRACE_PLAY, TRACE_END, t, 0);
+        return;
+    }
+    Message msg;
+    msg.reply.tick = t;
+    msg.reply.energy = state.energy[me];
+    msg.reply.effort = state.effort[me];
+    msg.reply.active = state.active[me];
+    msg.reply.recovery = state.recovery[me];
+    msg.reply.ticks = state.ticks[me];
+    if (protocol_send(write_fd, &msg, MSG_REPLY) < 0) {
+        perror("Failed to send reply");
+        terminate = 1;
     }
+    trace(TRACE_REPLY_SENT, TRACE_INSTANT, t, 0);
+    trace(TRACE_PLAY, TRACE_END, t, 0);
+}
 
-    // Read recovery range
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d %d", &min_recovery, &max_recovery) != 2) {
-        fprintf(stderr, "Error: Invalid recovery range in config\n"); exit(EXIT_FAILURE);
+// ##################################
+// Plays one match on the referee's descriptors (shm_fd, or read and write ends of pipes or
+// one socket) and releases them afterwards, leaving the process ready for another match.
+// Without a config_fd the settings must already be in config.
+// ##################################
+void play_match(int slot, int position, int config_fd, int rfd, int wfd, int shm_fd) {
+    player_id = position;
+    my_slot = slot;
+    char name[32];
+    sprintf(name, "player %d", slot);
+    if (trace_start(name) < 0) perror("Failed to start tracing");
+    if (getenv(REALTIME_ENV) && realtime_lock_memory() < 0) perror("Failed to lock memory");
+    read_fd = rfd;
+    write_fd = wfd;
+
+    // The referee hands over its parsed config (seed included) instead of the file
+    if (config_fd >= 0) {
+        shared_config = config_attach(config_fd);
+        if (!shared_config) {
+            perror("Failed to map shared config");
+            exit(EXIT_FAILURE);
+        }
+        config_seen = 0;
+        config_refresh(shared_config, &config, &config_seen);
     }
 
-    // Read win threshold
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d", &win_threshold) != 1) {
-        fprintf(stderr, "Error: Invalid win threshold in config\n"); exit(EXIT_FAILURE);
+    // Map the referee's shared tick segment when running over shm
+    me = 0;
+    if (shm_fd >= 0) {
+        struct stat st;
+        fstat(shm_fd, &st);
+        tick_size = st.st_size;
+        tick = mmap(NULL, tick_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        if (tick == MAP_FAILED) {
+            perror("Failed to map shared tick segment");
+            exit(EXIT_FAILURE);
+        }
+        close(shm_fd);
+        shared_tick_attach(tick, &state);
+        replies = shared_tick_replies(tick);
+        reply_times = shared_tick_reply_times(tick);
+        referee_fd = protocol_shm_referee(tick);
+        me = slot;
+    } else if (player_store_init(&state, 1) < 0) {
+        perror("Failed to allocate player state");
+        exit(EXIT_FAILURE);
     }
 
-    // Skip game duration and rounds to win
-    fgets(line, sizeof(line), file);
-    fgets(line, sizeof(line), file);
+    // Initialize player; with shm, a match already under way (resumed, or this player
+    // replaces a lost one) has its state in the store, and it joins at the next tick
+    uint32_t t = tick ? __atomic_load_n(&tick->tick, __ATOMIC_ACQUIRE) : 0;
+    if (t == 0) init_player(&state, me, &config, player_id, slot, config.seed);
 
-    fclose(file);
-}
+    // Tell the referee this player is ready for the first tick
+    send_hello(slot);
 
-// Generates a random number between min and max
-int rand_range(int min, int max) {
-    return min + rand() % (max - min + 1);
-}
+    while ((t = next_tick(t)) != 0) play_tick(t);
 
-// Handles exit signals to shut down cleanly
-void handle_termination(int signum) {
-    terminate = 1;
+    if (tick) {
+        munmap(tick, tick_size);
+        if (referee_fd >= 0) close(referee_fd);
+        referee_fd = -1;
+    } else {
+        player_store_free(&state);
+        close(read_fd);
+        if (write_fd != read_fd) close(write_fd);
+    }
+    tick = NULL;
+    if (shared_config) munmap((void*)shared_config, sizeof(SharedConfig));
+    shared_config = NULL;
 }
 
 // ##################################
-// On SIGUSR1: reduce energy by random amount from config
+// A pool player: plays every match it is assigned, reporting back after each one,
+// until the pool closes its end
 // ##################################
-void handle_round(int signum) {
-    static int recovery_seconds = 0;
-    static int recovery_time_needed = 0;
+void pool_worker(int control) {
+    PoolAssignment a;
+    int fds[POOL_MAX_FDS], n;
+    while (!terminate && pool_receive(control, &a, sizeof(a), fds, &n) == 1) {
+        if (a.shm) play_match(a.slot, a.player_id, fds[0], -1, -1, fds[1]);
+        else play_match(a.slot, a.player_id, fds[0], fds[1], fds[2], -1);
 
-    if (!player.active) {
-        if (recovery_time_needed == 0) {
-            recovery_time_needed = rand_range(min_recovery, max_recovery);
-           // printf("Player %d needs %d seconds to recover.\n",
-               //    player.player_id, recovery_time_needed);
-        }
+        PoolLease done = { a.slot, (int32_t)getpid(), 0 };
+        if (terminate || pool_send(control, &done, sizeof(done), NULL, 0) < 0) break;
+    }
+    _exit(EXIT_SUCCESS);
+}
 
-        recovery_seconds++;
-       // printf("Player %d recovery progress: %d/%d\n",
-              // player.player_id, recovery_seconds, recovery_time_needed);
+// Forks one more idle player; returns it, or NULL on error
+PoolWorker* pool_spawn() {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) < 0) return NULL;
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(pair[0]);
+        close(pair[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        // Nothing of the pool's own stays open in the player
+        close(pair[0]);
+        close(listen_fd);
+        close(pool_epoll);
+        for (int k = 0; k < num_workers; k++) close(workers[k].fd);
+        for (int k = 0; k < num_clients; k++) close(clients[k]);
+        pool_worker(pair[1]);
+    }
+    close(pair[1]);
 
-        if (recovery_seconds >= recovery_time_needed) {
-            int recover = rand_range(min_energy, max_energy);
-            player.energy += recover;
-            player.active = 1;
-           // printf(" Player %d recovered after %d seconds! Energy: %d\n",
-                  // player.player_id, recovery_seconds, player.energy);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = pair[0] };
+    epoll_ctl(pool_epoll, EPOLL_CTL_ADD, pair[0], &ev);
+    workers = realloc(workers, (num_workers + 1) * sizeof(PoolWorker));
+    workers[num_workers] = (PoolWorker){ pid, pair[0], 1 };
+    return &workers[num_workers++];
+}
 
-            recovery_seconds = 0;
-            recovery_time_needed = 0;
-        }
-    } else {
-        int dec = rand_range(min_decrease, max_decrease);
-
-        if (player.energy - dec > 0) {
-            player.energy -= dec;
-            //printf("Player %d lost %d energy. Remaining: %d\n",
-                   //player.player_id, dec, player.energy);
-        } else {
-//            printf("Player %d skipped decrease to avoid falling (Energy: %d, Tried to lose: %d)\n",
-//                   player.player_id, player.energy, dec);
+// Drops a player from the pool; closing its end makes an idle one exit
+void pool_retire(PoolWorker* w) {
+    close(w->fd);
+    *w = workers[--num_workers];
+}
+
+// First idle player, forking one if all are busy
+PoolWorker* pool_idle() {
+    for (int k = 0; k < num_workers; k++) {
+        if (workers[k].idle) return &workers[k];
+    }
+    return pool_spawn();
+}
+
+// ##################################
+// Passes one assignment from a referee on to an idle player and answers with its pid
+// ##################################
+void pool_assign(int client) {
+    PoolAssignment a;
+    int fds[POOL_MAX_FDS], n = 0;
+    int got = pool_receive(client, &a, sizeof(a), fds, &n);
+    if (got <= 0) {
+        // The referee is done with the pool (or spoke nonsense): drop the connection
+        epoll_ctl(pool_epoll, EPOLL_CTL_DEL, client, NULL);
+        close(client);
+        for (int k = 0; k < num_clients; k++) {
+            if (clients[k] == client) clients[k] = clients[--num_clients];
         }
+        return;
+    }
 
-        int fall_chance = rand_range(1, 100);
-        if (fall_chance <= 5) {
-            player.energy = 0;
-            player.active = 0;
-            recovery_seconds = 0;
-            recovery_time_needed = 0;
-//            printf("Player %d fell randomly! (Chance roll: %d%%)\n",
-//                   player.player_id, fall_chance);
+    PoolLease lease = { a.slot, -1, EINVAL };
+    if (n == (a.shm ? 2 : 3)) {
+        PoolWorker* w;
+        while ((w = pool_idle()) != NULL) {
+            if (pool_send(w->fd, &a, sizeof(a), fds, n) == 0) {
+                w->idle = 0;
+                lease.pid = w->pid;
+                lease.error = 0;
+                break;
+            }
+            pool_retire(w);             // It died while idle
         }
+        if (!w) lease.error = errno;
     }
+    for (int k = 0; k < n; k++) close(fds[k]);
+    pool_send(client, &lease, sizeof(lease), NULL, 0);
+}
 
-    PlayerStats energy_update;
-    energy_update.player_id = player.player_id;
-    energy_update.energy = player.energy;
-    write(player.write_fd, &energy_update, sizeof(PlayerStats));
+// A player finished its match, or died: back to idle, retired if the pool has enough
+void pool_done(PoolWorker* w) {
+    PoolLease done;
+    int fds[POOL_MAX_FDS], n;
+    if (pool_receive(w->fd, &done, sizeof(done), fds, &n) != 1) {
+        pool_retire(w);
+        return;
+    }
+    w->idle = 1;
+    if (num_workers > pool_size) pool_retire(w);
 }
 
 // ##################################
-// On SIGUSR2: calculate and send effort
+// Runs the pool until SIGTERM or SIGINT
 // ##################################
-void send_effort(int signum) {
+void run_pool(const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long\n");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(addr.sun_path, path);
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        perror("Failed to open pool socket");
+        exit(EXIT_FAILURE);
+    }
+
+    pool_epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = listen_fd };
+    epoll_ctl(pool_epoll, EPOLL_CTL_ADD, listen_fd, &ev);
+    for (int k = 0; k < pool_size; k++) {
+        if (!pool_spawn()) {
+            perror("Failed to fork pool player");
+            exit(EXIT_FAILURE);
+        }
+    }
+    printf("Player pool: %d players waiting on %s\n", pool_size, path);
+    fflush(stdout);
 
-    if (player.read_fd < 0 || player.write_fd < 0) return;
+    struct epoll_event events[64];
+    while (!terminate) {
+        int n = epoll_wait(pool_epoll, events, 64, -1);
+        for (int k = 0; k < n; k++) {
+            int fd = events[k].data.fd;
+            if (fd == listen_fd) {
+                int client = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+                if (client < 0) continue;
+                struct epoll_event cev = { .events = EPOLLIN, .data.fd = client };
+                epoll_ctl(pool_epoll, EPOLL_CTL_ADD, client, &cev);
+                clients = realloc(clients, (num_clients + 1) * sizeof(int));
+                clients[num_clients++] = client;
+                continue;
+            }
+            PoolWorker* w = NULL;
+            for (int j = 0; j < num_workers && !w; j++) {
+                if (workers[j].fd == fd) w = &workers[j];
+            }
+            if (w) pool_done(w);
+            else pool_assign(fd);
+        }
+        while (waitpid(-1, NULL, WNOHANG) > 0);
+    }
 
-    int position_factor;
-    read(player.read_fd, &position_factor, sizeof(int));
-    player.position = position_factor;
+    // Idle players exit as their end closes; busy ones finish their match first
+    for (int k = 0; k < num_workers; k++) close(workers[k].fd);
+    for (int k = 0; k < num_clients; k++) close(clients[k]);
+    close(listen_fd);
+    close(pool_epoll);
+    unlink(path);
+    while (wait(NULL) > 0);
+}
 
-    PlayerStats stats;
-    stats.player_id = player.player_id;
-    stats.position = position_factor;
-    stats.energy = player.energy;
-    stats.effort = (player.active) ? player.energy * position_factor : 0;
+// ##################################
+// Joins a referee over a socket, whether it launched this player or not, and plays its
+// match. The referee may still be starting, so refused connections are retried a while.
+// ##################################
+void play_remote(const char* family, const char* text) {
+    TransportAddress address;
+    if (transport_parse(family, text, &address) < 0) {
+        fprintf(stderr, "Error: Bad %s address '%s'\n", family, text);
+        exit(EXIT_FAILURE);
+    }
+    int fd = -1;
+    for (int tries = 0; fd < 0 && !terminate; tries++) {
+        fd = transport_connect(&address);
+        if (fd >= 0 || tries == CONNECT_TRIES || (errno != ECONNREFUSED && errno != ENOENT)) break;
+        usleep(CONNECT_RETRY_MS * 1000);
+    }
+    if (fd < 0) {
+        perror("Failed to connect to referee");
+        exit(EXIT_FAILURE);
+    }
 
-    write(player.write_fd, &stats, sizeof(PlayerStats));
+    Message msg;
+    if (protocol_receive(fd, &msg, MSG_WELCOME) <= 0) {
+        perror("Failed to join the match");
+        exit(EXIT_FAILURE);
+    }
+    config = msg.welcome.config;
+    play_match(msg.welcome.slot, msg.welcome.player_id, -1, fd, fd, -1);
 }
 
 // ##################################
 // Main function
 // ##################################
 int main(int argc, char* argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <position> <read_fd> <write_fd> <config_file>\n", argv[0]);
+    int pool = argc >= 3 && argc <= 4 && strcmp(argv[1], "pool") == 0;
+    int remote = argc == 3 && (strcmp(argv[1], "unix") == 0 || strcmp(argv[1], "tcp") == 0);
+    if (!pool && !remote && argc != 6 && argc != 7) {
+        fprintf(stderr, "Usage: %s <position> <read_fd> <write_fd> <config_fd> <slot> [<shm_fd>]\n"
+                        "       %s pool <socket> [size]\n"
+                        "       %s unix <path> | tcp <host>:<port>\n", argv[0], argv[0], argv[0]);
         exit(EXIT_FAILURE);
     }
 
-    // Initialize player
-    player.player_id = atoi(argv[1]);
-    player.read_fd = atoi(argv[2]);
-    player.write_fd = atoi(argv[3]);
-    player.active = 1;
-    player.recovering = 0;
-
-    srand(time(NULL) ^ (getpid() << 16));
-    read_config(argv[4]);
-
-    // Assign sorted random energy based on ID
-    int energies[4];
-    for (int i = 0; i < 4; i++) energies[i] = rand_range(min_energy, max_energy);
-    for (int i = 0; i < 3; i++) {
-        for (int j = i + 1; j < 4; j++) {
-            if (energies[i] > energies[j]) {
-                int temp = energies[i];
-                energies[i] = energies[j];
-                energies[j] = temp;
-            }
+    // Exit signals interrupt the blocking wait for a tick instead of restarting it
+    struct sigaction sa = { .sa_handler = handle_termination };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    if (pool) {
+        if (argc == 4) pool_size = atoi(argv[3]);
+        if (pool_size <= 0) {
+            fprintf(stderr, "Error: Pool size must be positive\n");
+            exit(EXIT_FAILURE);
         }
+        run_pool(argv[2]);
+        return EXIT_SUCCESS;
     }
-    player.energy = energies[player.player_id];
-
-    // Handle signals
-    sigset(SIGUSR1, handle_round);
-    sigset(SIGUSR2, send_effort);
-    sigset(SIGTERM, handle_termination);
-    sigset(SIGINT, handle_termination);
-
-    while (!terminate) {
-        pause();
+    if (remote) {
+        play_remote(argv[1], argv[2]);
+        return EXIT_SUCCESS;
     }
 
-    close(player.read_fd);
-    close(player.write_fd);
+    play_match(atoi(argv[5]), atoi(argv[1]), atoi(argv[4]), atoi(argv[2]), atoi(argv[3]),
+               argc == 7 ? atoi(argv[6]) : -1);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,74 @@
+#include "header.h"
+#include "player_pool.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+
+int pool_connect(const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+int pool_send(int fd, const void* msg, size_t size, const int fds[], int num_fds) {
+    union {
+        char buffer[CMSG_SPACE(POOL_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { (void*)msg, size };
+    struct msghdr header = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    if (num_fds > 0) {
+        header.msg_control = control.buffer;
+        header.msg_controllen = CMSG_SPACE(num_fds * sizeof(int));
+        struct cmsghdr* c = CMSG_FIRSTHDR(&header);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+        memcpy(CMSG_DATA(c), fds, num_fds * sizeof(int));
+    }
+
+    ssize_t n;
+    while ((n = sendmsg(fd, &header, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+    return n == (ssize_t)size ? 0 : -1;
+}
+
+int pool_receive(int fd, void* msg, size_t size, int fds[], int* num_fds) {
+    union {
+        char buffer[CMSG_SPACE(POOL_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { msg, size };
+    struct msghdr header = { .msg_iov = &iov, .msg_iovlen = 1,
+                             .msg_control = control.buffer, .msg_controllen = sizeof(control.buffer) };
+
+    ssize_t n = recvmsg(fd, &header, MSG_CMSG_CLOEXEC);
+    if (n <= 0) return (int)n;
+
+    *num_fds = 0;
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(&header); c; c = CMSG_NXTHDR(&header, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+        int count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(fds + *num_fds, CMSG_DATA(c), count * sizeof(int));
+        *num_fds += count;
+    }
+    if (n != (ssize_t)size || (header.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+        for (int k = 0; k < *num_fds; k++) close(fds[k]);
+        *num_fds = 0;
+        errno = EPROTO;
+        return -1;
+    }
+    return 1;
+}
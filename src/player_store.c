@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "player_store.h"
+
+// Size of one array rounded up to a whole number of cache lines
+static size_t array_size(int num_players, size_t element) {
+    size_t bytes = (size_t)num_players * element;
+    return (bytes + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+}
+
+size_t player_store_size(int num_players) {
+    return 5 * array_size(num_players, sizeof(int)) + 2 * array_size(num_players, sizeof(unsigned int));
+}
+
+// ##################################
+// Points each array at its slice of the block
+// ##################################
+void player_store_attach(PlayerStore* store, void* memory, int num_players) {
+    char* p = memory;
+    size_t ints = array_size(num_players, sizeof(int));
+    size_t uints = array_size(num_players, sizeof(unsigned int));
+
+    store->num_players = num_players;
+    store->energy = (int*)p;     p += ints;
+    store->effort = (int*)p;     p += ints;
+    store->position = (int*)p;   p += ints;
+    store->active = (int*)p;     p += ints;
+    store->recovery = (int*)p;   p += ints;
+    store->key = (unsigned int*)p;   p += uints;
+    store->ticks = (unsigned int*)p;
+}
+
+int player_store_init(PlayerStore* store, int num_players) {
+    size_t bytes = player_store_size(num_players);
+    void* memory = aligned_alloc(STORE_ALIGN, bytes);
+    if (!memory) return -1;
+    memset(memory, 0, bytes);
+    player_store_attach(store, memory, num_players);
+    return 0;
+}
+
+void player_store_free(PlayerStore* store) {
+    free(store->energy);
+    store->energy = NULL;
+}
+
+void player_store_copy(PlayerStore* to, const PlayerStore* from) {
+    size_t ints = from->num_players * sizeof(int);
+    memcpy(to->energy, from->energy, ints);
+    memcpy(to->effort, from->effort, ints);
+    memcpy(to->position, from->position, ints);
+    memcpy(to->active, from->active, ints);
+    memcpy(to->recovery, from->recovery, ints);
+    memcpy(to->key, from->key, from->num_players * sizeof(unsigned int));
+    memcpy(to->ticks, from->ticks, from->num_players * sizeof(unsigned int));
+}
+
+// Header size rounded up so the store arrays stay cache-line aligned
+static size_t shared_tick_header() {
+    return (sizeof(SharedTick) + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+}
+
+size_t shared_tick_size(int num_players) {
+    return shared_tick_header() + player_store_size(num_players) + array_size(num_players, sizeof(uint32_t)) +
+           array_size(num_players, sizeof(int64_t));
+}
+
+void shared_tick_attach(SharedTick* tick, PlayerStore* store) {
+    player_store_attach(store, (char*)tick + shared_tick_header(), tick->num_players);
+}
+
+uint32_t* shared_tick_replies(SharedTick* tick) {
+    return (uint32_t*)((char*)tick + shared_tick_header() + player_store_size(tick->num_players));
+}
+
+int64_t* shared_tick_reply_times(SharedTick* tick) {
+    return (int64_t*)((char*)shared_tick_replies(tick) + array_size(tick->num_players, sizeof(uint32_t)));
+}
@@ -0,0 +1,134 @@
+#include "header.h"
+#include "protocol.h"
+#include <arpa/inet.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/syscall.h>
+
+static size_t payload_size(int type) {
+    switch (type) {
+        case MSG_HELLO:   return sizeof(HelloMessage);
+        case MSG_TICK:    return sizeof(TickMessage);
+        case MSG_REPLY:   return sizeof(ReplyMessage);
+        case MSG_CONFIG:  return sizeof(ConfigMessage);
+        case MSG_WELCOME: return sizeof(WelcomeMessage);
+        case MSG_STATE:   return sizeof(StateMessage);
+    }
+    return 0;
+}
+
+// Every payload is made of 32-bit words; converts them in place between host and network order
+static void swap_payload(void* payload, size_t size) {
+    uint32_t* words = payload;
+    for (size_t k = 0; k < size / sizeof(uint32_t); k++) words[k] = htonl(words[k]);
+}
+
+void protocol_queue(FrameBatch* batch, const Message* msg, int type) {
+    size_t length = payload_size(type);
+    FrameHeader* h = (FrameHeader*)(batch->data + batch->length);
+    h->magic = htonl(PROTOCOL_MAGIC);
+    h->version = htons(PROTOCOL_VERSION);
+    h->type = htons(type);
+    h->length = htonl(length);
+    memcpy(h + 1, &msg->hello, length);
+    swap_payload(h + 1, length);
+    batch->length += sizeof(FrameHeader) + length;
+}
+
+int protocol_flush(int fd, FrameBatch* batch) {
+    size_t size = batch->length;
+    batch->length = 0;
+    ssize_t n;
+    while ((n = write(fd, batch->data, size)) < 0 && errno == EINTR);
+    if (n == (ssize_t)size) return 0;
+    if (n >= 0) errno = EIO;
+    return -1;
+}
+
+int protocol_send(int fd, Message* msg, int type) {
+    FrameBatch batch = { 0 };
+    protocol_queue(&batch, msg, type);
+    return protocol_flush(fd, &batch);
+}
+
+// Reads into msg until size bytes of it are there, starting at *got; as protocol_receive,
+// except that a non-blocking descriptor fails with EAGAIN and *got tells how far it came
+static int read_frame(int fd, Message* msg, size_t size, size_t* got) {
+    while (*got < size) {
+        ssize_t n = read(fd, (char*)msg + *got, size - *got);
+        if (n == 0) {
+            if (*got == 0) return 0;
+            errno = EPROTO;             // Cut off mid-frame
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR && *got > 0) continue;
+            return -1;
+        }
+        *got += n;
+    }
+    return 1;
+}
+
+// Checks the header of a frame read whole and converts it to host order
+static int decode_frame(Message* msg, int type) {
+    FrameHeader* h = &msg->header;
+    h->magic = ntohl(h->magic);
+    h->version = ntohs(h->version);
+    h->type = ntohs(h->type);
+    h->length = ntohl(h->length);
+    if (h->magic != PROTOCOL_MAGIC || h->version != PROTOCOL_VERSION || h->type != type ||
+        h->length != payload_size(type)) {
+        errno = EPROTO;
+        return -1;
+    }
+    swap_payload(&msg->hello, h->length);
+    return 1;
+}
+
+int protocol_receive(int fd, Message* msg, int type) {
+    size_t got = 0;
+    int result = read_frame(fd, msg, sizeof(FrameHeader) + payload_size(type), &got);
+    return result > 0 ? decode_frame(msg, type) : result;
+}
+
+int protocol_receive_part(int fd, FrameReader* reader, int type) {
+    int result = read_frame(fd, &reader->msg, sizeof(FrameHeader) + payload_size(type), &reader->got);
+    if (result <= 0) return result;
+    reader->got = 0;
+    return decode_frame(&reader->msg, type);
+}
+
+static long futex(uint32_t* word, int op, uint32_t value, const struct timespec* timeout) {
+    return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+void protocol_shm_start(SharedTick* tick, uint32_t t) {
+    __atomic_store_n(&tick->tick, t, __ATOMIC_RELEASE);
+    futex(&tick->tick, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+int protocol_shm_referee(const SharedTick* tick) {
+    if (tick->referee <= 0) return -1;
+    return syscall(SYS_pidfd_open, tick->referee, 0);
+}
+
+// A pidfd turns readable when its process exits; without one, the pid is asked directly
+static int referee_gone(const SharedTick* tick, int referee) {
+    if (referee >= 0) {
+        struct pollfd p = { .fd = referee, .events = POLLIN };
+        return poll(&p, 1, 0) > 0;
+    }
+    return tick->referee > 0 && kill(tick->referee, 0) < 0 && errno == ESRCH;
+}
+
+uint32_t protocol_shm_wait(SharedTick* tick, uint32_t last, int referee) {
+    const struct timespec check = { 0, PROTOCOL_SHM_CHECK_MS * 1000000L };
+    while (1) {
+        uint32_t t = __atomic_load_n(&tick->tick, __ATOMIC_ACQUIRE);
+        if (t != last) return t;
+        if (futex(&tick->tick, FUTEX_WAIT, last, &check) == 0) continue;
+        if (errno == EINTR) return 0;
+        if (errno == ETIMEDOUT && referee_gone(tick, referee)) return PROTOCOL_TICK_STOP;
+    }
+}
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "rank_index.h"
+
+#define NONE -1
+
+// Orders players by energy, then by player number
+static int less(RankIndex* x, int a, int b) {
+    return x->energy[a] < x->energy[b] || (x->energy[a] == x->energy[b] && a < b);
+}
+
+static int count_of(RankIndex* x, int t) {
+    return t == NONE ? 0 : x->count[t];
+}
+
+static void refresh(RankIndex* x, int t) {
+    x->count[t] = 1 + count_of(x, x->left[t]) + count_of(x, x->right[t]);
+}
+
+// Splits tree t into the players ranked before k and the rest
+static void split(RankIndex* x, int t, int k, int* l, int* r) {
+    if (t == NONE) {
+        *l = *r = NONE;
+    } else if (less(x, t, k)) {
+        split(x, x->right[t], k, &x->right[t], r);
+        *l = t;
+        refresh(x, t);
+    } else {
+        split(x, x->left[t], k, l, &x->left[t]);
+        *r = t;
+        refresh(x, t);
+    }
+}
+
+// Joins two trees where every player in l ranks before every player in r
+static int merge(RankIndex* x, int l, int r) {
+    if (l == NONE) return r;
+    if (r == NONE) return l;
+    if (x->priority[l] > x->priority[r]) {
+        x->right[l] = merge(x, x->right[l], r);
+        refresh(x, l);
+        return l;
+    }
+    x->left[r] = merge(x, l, x->left[r]);
+    refresh(x, r);
+    return r;
+}
+
+static void insert(RankIndex* x, int k) {
+    int l, r;
+    x->left[k] = x->right[k] = NONE;
+    x->count[k] = 1;
+    split(x, x->root, k, &l, &r);
+    x->root = merge(x, merge(x, l, k), r);
+}
+
+// Removes player k from tree t and returns the new root of t
+static int erase(RankIndex* x, int t, int k) {
+    if (t == k) return merge(x, x->left[t], x->right[t]);
+    if (less(x, k, t)) x->left[t] = erase(x, x->left[t], k);
+    else x->right[t] = erase(x, x->right[t], k);
+    refresh(x, t);
+    return t;
+}
+
+// Position of player k: 1 + the number of players ranked before it
+static int rank_of(RankIndex* x, int k) {
+    int rank = 1, t = x->root;
+    while (t != NONE) {
+        if (t == k) return rank + count_of(x, x->left[t]);
+        if (less(x, k, t)) t = x->left[t];
+        else {
+            rank += count_of(x, x->left[t]) + 1;
+            t = x->right[t];
+        }
+    }
+    return rank;
+}
+
+static unsigned int next_priority(RankIndex* x) {
+    x->rng ^= x->rng << 13;
+    x->rng ^= x->rng >> 17;
+    x->rng ^= x->rng << 5;
+    return x->rng;
+}
+
+// Writes player p's position if it moved, and lists it as changed (changed NULL: always writes)
+static void place(int p, int rank, int positions[], int changed[], int* num_changed, char flagged[]) {
+    if (!changed) {
+        positions[p] = rank;
+        return;
+    }
+    if (positions[p] == rank) return;
+    positions[p] = rank;
+    if (!flagged[p]) {
+        flagged[p] = 1;
+        changed[(*num_changed)++] = p;
+    }
+}
+
+static int compare_keys(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+// ##################################
+// Sorts the team by (energy, player) into order[], taking each player's energy as it
+// stands. Energies span a small range next to the team on every rules workload, so they
+// are counted, in O(n + range), stable by player number; a wider range goes to qsort.
+// ##################################
+static void sort_team(RankIndex* x, int base, const int energies[]) {
+    int lo = INT_MAX, hi = INT_MIN;
+    for (int k = 0; k < x->size; k++) {
+        int e = x->energy[k] = energies[base + k];
+        if (e < lo) lo = e;
+        if (e > hi) hi = e;
+    }
+
+    long range = (long)hi - lo + 1;
+    if (range <= 2L * x->size + 256 && range > x->counts_size) {
+        int* counts = realloc(x->counts, range * sizeof(int));
+        if (counts) {
+            x->counts = counts;
+            x->counts_size = range;
+        }
+    }
+    if (range <= x->counts_size) {
+        memset(x->counts, 0, range * sizeof(int));
+        for (int k = 0; k < x->size; k++) x->counts[x->energy[k] - lo]++;
+        for (long e = 0, start = 0; e < range; e++) {
+            int n = x->counts[e];
+            x->counts[e] = start;
+            start += n;
+        }
+        for (int k = 0; k < x->size; k++) x->order[x->counts[x->energy[k] - lo]++] = k;
+        return;
+    }
+
+    for (int k = 0; k < x->size; k++) {
+        // Flipping the sign bit makes the signed energy sort as unsigned
+        x->keys[k] = (unsigned long long)((unsigned int)x->energy[k] ^ 0x80000000u) << 32 | (unsigned int)k;
+    }
+    qsort(x->keys, x->size, sizeof(*x->keys), compare_keys);
+    for (int k = 0; k < x->size; k++) x->order[k] = (int)(x->keys[k] & 0xffffffffu);
+}
+
+// ##################################
+// Rebuilds the treap from order[] with a stack in O(n): each player becomes the right
+// child of the last one still on the stack with a higher priority, and takes the ones it
+// pops as its left subtree. A node's subtree is complete once it is popped. The stack
+// never outgrows the part of order[] already read, so it is kept there.
+// ##################################
+static void build_treap(RankIndex* x) {
+    int* stack = x->order;
+    int top = 0;
+    for (int rank = 1; rank <= x->size; rank++) {
+        int k = x->order[rank - 1];
+        int last = NONE;
+        while (top && x->priority[stack[top - 1]] < x->priority[k]) {
+            last = stack[--top];
+            refresh(x, last);
+        }
+        x->left[k] = last;
+        x->right[k] = NONE;
+        if (top) x->right[stack[top - 1]] = k;
+        stack[top++] = k;
+    }
+    while (top > 1) refresh(x, stack[--top]);
+    if (top) refresh(x, stack[0]);
+    x->root = top ? stack[0] : NONE;
+    x->stale = 0;
+}
+
+// Ranks the whole team with one sort and places every player; the treap waits until a
+// sparse tick needs it
+static void rerank(RankIndex* x, int base, const int energies[], int positions[],
+                   int changed[], int* num_changed, char flagged[]) {
+    sort_team(x, base, energies);
+    for (int rank = 1; rank <= x->size; rank++)
+        place(base + x->order[rank - 1], rank, positions, changed, num_changed, flagged);
+    x->stale = 1;
+}
+
+// Places the players ranked lo .. hi in subtree t, whose first player has rank offset + 1
+static void place_span(RankIndex* x, int t, int offset, int lo, int hi, int base, int positions[],
+                       int changed[], int* num_changed, char flagged[]) {
+    while (t != NONE) {
+        int rank = offset + count_of(x, x->left[t]) + 1;
+        if (lo < rank) place_span(x, x->left[t], offset, lo, hi, base, positions, changed, num_changed, flagged);
+        if (rank > hi) return;
+        if (rank >= lo) place(base + t, rank, positions, changed, num_changed, flagged);
+        offset = rank;
+        t = x->right[t];
+    }
+}
+
+int rank_index_init(RankIndex* index, int size, int base, const int energies[], int positions[]) {
+    index->size = size;
+    index->root = NONE;
+    index->rng = 2463534242u;
+    index->left = malloc(size * sizeof(int));
+    index->right = malloc(size * sizeof(int));
+    index->count = malloc(size * sizeof(int));
+    index->priority = malloc(size * sizeof(unsigned int));
+    index->energy = malloc(size * sizeof(int));
+    index->moved = malloc(size * sizeof(int));
+    index->keys = malloc(size * sizeof(unsigned long long));
+    index->order = malloc(size * sizeof(int));
+    index->counts = NULL;
+    index->counts_size = 0;
+    if (!index->left || !index->right || !index->count || !index->priority || !index->energy ||
+        !index->moved || !index->keys || !index->order)
+        return -1;
+
+    for (int k = 0; k < size; k++) index->priority[k] = next_priority(index);
+    rerank(index, base, energies, positions, NULL, NULL, NULL);
+    return 0;
+}
+
+void rank_index_free(RankIndex* index) {
+    free(index->left);
+    free(index->right);
+    free(index->count);
+    free(index->priority);
+    free(index->energy);
+    free(index->moved);
+    free(index->keys);
+    free(index->order);
+    free(index->counts);
+}
+
+// ##################################
+// Re-ranks the players whose energy changed. Few of them are moved one by one, and the
+// rank span each one crossed is noted: a player's position can only have moved if its
+// new rank lies in one of those spans, so the merged spans are all that is walked
+// afterwards. Many of them are ranked with one sort instead, as the sort is cheaper.
+// ##################################
+void rank_index_update(RankIndex* index, int base, const int energies[], int positions[],
+                       int changed[], int* num_changed, char flagged[]) {
+    int num_moved = 0;
+    for (int k = 0; k < index->size; k++) {
+        if (index->energy[k] != energies[base + k]) index->moved[num_moved++] = k;
+    }
+    if (num_moved == 0) return;
+    if (num_moved > RANK_SPARSE_MAX) {
+        rerank(index, base, energies, positions, changed, num_changed, flagged);
+        return;
+    }
+    if (index->stale) build_treap(index);
+
+    int num_spans = 0;
+    for (int m = 0; m < num_moved; m++) {
+        int k = index->moved[m];
+        int old_rank = rank_of(index, k);
+        index->root = erase(index, index->root, k);
+        index->energy[k] = energies[base + k];
+        insert(index, k);
+        int new_rank = rank_of(index, k);
+        if (old_rank == new_rank) continue;
+        unsigned long long lo = old_rank < new_rank ? old_rank : new_rank;
+        unsigned long long hi = old_rank < new_rank ? new_rank : old_rank;
+        index->keys[num_spans++] = lo << 32 | hi;
+    }
+    if (num_spans == 0) return;
+
+    qsort(index->keys, num_spans, sizeof(*index->keys), compare_keys);
+    int lo = index->keys[0] >> 32, hi = index->keys[0] & 0xffffffffu;
+    for (int s = 1; s <= num_spans; s++) {
+        int next_lo = s < num_spans ? (int)(index->keys[s] >> 32) : index->size + 2;
+        int next_hi = s < num_spans ? (int)(index->keys[s] & 0xffffffffu) : 0;
+        if (next_lo <= hi + 1) {
+            if (next_hi > hi) hi = next_hi;
+            continue;
+        }
+        place_span(index, index->root, 0, lo, hi, base, positions, changed, num_changed, flagged);
+        lo = next_lo;
+        hi = next_hi;
+    }
+}
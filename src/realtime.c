@@ -0,0 +1,198 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <malloc.h>
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "realtime.h"
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+#define DEADLINE_RESET_ON_FORK 0x01
+
+// sched_setattr(2) has no glibc wrapper everywhere, so the attributes are our own
+typedef struct {
+    uint32_t size;
+    uint32_t policy;
+    uint64_t flags;
+    int32_t nice;
+    uint32_t priority;
+    uint64_t runtime;
+    uint64_t deadline;
+    uint64_t period;
+} DeadlineAttr;
+
+// Appends the CPUs of one item of a list, like "3" or "5-7"; returns -1 if malformed
+static int parse_cpus(const char* item, RealtimeConfig* rt) {
+    char* end;
+    long lo = strtol(item, &end, 10), hi = lo;
+    if (end == item || lo < 0) return -1;
+    if (*end == '-') {
+        item = end + 1;
+        hi = strtol(item, &end, 10);
+        if (end == item || hi < lo) return -1;
+    }
+    if (*end) return -1;
+    for (long cpu = lo; cpu <= hi; cpu++) {
+        if (cpu >= CPU_SETSIZE || cpu >= sysconf(_SC_NPROCESSORS_CONF) || rt->num_cpus == REALTIME_MAX_CPUS)
+            return -1;
+        rt->cpus[rt->num_cpus++] = cpu;
+    }
+    return 0;
+}
+
+int realtime_parse(const char* spec, RealtimeConfig* rt, char* error, size_t size) {
+    memset(rt, 0, sizeof(*rt));
+    rt->policy = REALTIME_FIFO;
+    rt->priority = 50;
+    rt->budget_us = 1000;
+    rt->lock_memory = 1;
+
+    char* items = strdup(spec);
+    char* save = NULL;
+    int result = 0;
+    for (char* item = strtok_r(items, ",", &save); item && result == 0; item = strtok_r(NULL, ",", &save)) {
+        char* value = strchr(item, '=');
+        if (value) *value++ = '\0';
+        if (value && strcmp(item, "cpus") == 0) {
+            // The CPU list has commas of its own: it runs on over the items that are numbers
+            result = parse_cpus(value, rt);
+            while (result == 0 && save && *save >= '0' && *save <= '9')
+                result = parse_cpus(strtok_r(NULL, ",", &save), rt);
+            if (result < 0 || !rt->num_cpus) {
+                snprintf(error, size, "Bad CPU list '%s'", value);
+                result = -1;
+            }
+        } else if (value && strcmp(item, "priority") == 0) {
+            rt->priority = atoi(value);
+            if (rt->priority < 2 || rt->priority > 99) {
+                snprintf(error, size, "priority must be 2-99");
+                result = -1;
+            }
+        } else if (value && strcmp(item, "budget") == 0) {
+            rt->budget_us = atol(value);
+            if (rt->budget_us <= 0) {
+                snprintf(error, size, "budget must be positive");
+                result = -1;
+            }
+        } else if (!value && strcmp(item, "packed") == 0) rt->packed = 1;
+        else if (!value && strcmp(item, "spread") == 0) rt->packed = 0;
+        else if (!value && strcmp(item, "fifo") == 0) rt->policy = REALTIME_FIFO;
+        else if (!value && strcmp(item, "deadline") == 0) rt->policy = REALTIME_DEADLINE;
+        else if (!value && strcmp(item, "other") == 0) rt->policy = REALTIME_OTHER;
+        else if (!value && strcmp(item, "nolock") == 0) rt->lock_memory = 0;
+        else {
+            snprintf(error, size, "Unknown real-time setting '%s' (expected cpus=<list>, packed, spread, fifo, "
+                                  "deadline, other, priority=<n>, budget=<us> or nolock)", item);
+            result = -1;
+        }
+    }
+    free(items);
+
+    // The kernel only admits deadline tasks that may run on every CPU of their root domain
+    if (result == 0 && rt->policy == REALTIME_DEADLINE && rt->num_cpus) {
+        snprintf(error, size, "deadline does not go with cpus= (deadline tasks can not be pinned)");
+        result = -1;
+    }
+    return result;
+}
+
+// Pins pid (0: the calling thread) to cpu, if any, and sets its policy
+static int place(const RealtimeConfig* rt, pid_t pid, int cpu, int priority, long period_ns) {
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(pid, sizeof(set), &set) < 0) return -1;
+    }
+    if (rt->policy == REALTIME_FIFO) {
+        struct sched_param param = { .sched_priority = priority };
+        return sched_setscheduler(pid, SCHED_FIFO | SCHED_RESET_ON_FORK, &param);
+    }
+    if (rt->policy == REALTIME_DEADLINE) {
+        DeadlineAttr attr = { .size = sizeof(attr), .policy = SCHED_DEADLINE, .flags = DEADLINE_RESET_ON_FORK };
+        attr.runtime = rt->budget_us * 1000;
+        attr.deadline = attr.period = period_ns;
+        return syscall(SYS_sched_setattr, pid, &attr, 0);
+    }
+    return 0;
+}
+
+int realtime_place_referee(const RealtimeConfig* rt, long period_ns) {
+    return place(rt, 0, rt->num_cpus ? rt->cpus[0] : -1, rt->priority, period_ns);
+}
+
+int realtime_place_player(const RealtimeConfig* rt, pid_t pid, int slot, int num_players, long period_ns) {
+    int cpu = -1;
+    if (rt->num_cpus) {
+        const int* cpus = rt->num_cpus > 1 ? rt->cpus + 1 : rt->cpus;
+        int n = rt->num_cpus > 1 ? rt->num_cpus - 1 : 1;
+        cpu = rt->packed ? cpus[(long)slot * n / num_players] : cpus[slot % n];
+    }
+    return place(rt, pid, cpu, rt->priority - 1, period_ns);
+}
+
+// Touches a stretch of stack, so the pages are there (and locked) before the first tick
+static __attribute__((noinline)) void prefault_stack(void) {
+    volatile char stack[REALTIME_STACK_PREFAULT];
+    for (size_t k = 0; k < sizeof(stack); k += 4096) stack[k] = 0;
+}
+
+int realtime_lock_memory(void) {
+    // Freed memory stays with the process, and big blocks come from the (locked) heap
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) return -1;
+    prefault_stack();
+    return 0;
+}
+
+// ##################################
+// Tick jitter
+// ##################################
+void tick_jitter_add(TickJitter* j, long now, long deadline) {
+    if (j->last_start) {
+        long period = now - j->last_start;
+        if (!j->periods || period < j->min_period) j->min_period = period;
+        if (period > j->max_period) j->max_period = period;
+        j->periods++;
+        j->sum += period;
+        j->sum_squares += (double)period * period;
+    }
+    j->last_start = now;
+
+    long latency = now > deadline ? now - deadline : 0;
+    long bucket = latency / 1000;
+    j->latency_us[bucket < JITTER_LATENCY_BUCKETS ? bucket : JITTER_LATENCY_BUCKETS - 1]++;
+    if (latency > j->max_latency) j->max_latency = latency;
+    j->wakeups++;
+}
+
+// Wake-up latency below which the given fraction of the ticks fall, in us
+static long latency_percentile(const TickJitter* j, double fraction) {
+    long target = (long)(fraction * j->wakeups), seen = 0;
+    for (int k = 0; k < JITTER_LATENCY_BUCKETS; k++) {
+        seen += j->latency_us[k];
+        if (seen > target) return k;
+    }
+    return JITTER_LATENCY_BUCKETS - 1;
+}
+
+void tick_jitter_print(const TickJitter* j, FILE* out) {
+    if (!j->periods) return;
+    double mean = j->sum / j->periods;
+    double variance = j->sum_squares / j->periods - mean * mean;
+    fprintf(out, "Tick jitter: %ld periods, mean %.3f ms, stddev %.1f us, min %.3f ms, max %.3f ms; "
+                 "wake-up latency p50 %ld us, p99 %ld us, max %.1f us\n",
+            j->periods, mean / 1e6, sqrt(variance > 0 ? variance : 0) / 1e3, j->min_period / 1e6,
+            j->max_period / 1e6, latency_percentile(j, 0.50), latency_percentile(j, 0.99), j->max_latency / 1e3);
+}
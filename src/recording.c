@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "recording.h"
+
+static size_t frame_size(int num_players) {
+    return sizeof(RecordFrame) + num_players * sizeof(PlayerStats);
+}
+
+int recording_create(Recording* rec, const char* path, const GameConfig* cfg, int num_players) {
+    memset(rec, 0, sizeof(*rec));
+    // Close on exec so the player processes do not inherit it
+    rec->file = fopen(path, "wbe");
+    if (!rec->file) return -1;
+
+    memcpy(rec->header.magic, RECORDING_MAGIC, sizeof(rec->header.magic));
+    rec->header.version = RECORDING_VERSION;
+    rec->header.num_players = num_players;
+    rec->header.config = *cfg;
+    rec->frame_size = frame_size(num_players);
+    rec->stats = malloc(num_players * sizeof(PlayerStats));
+    rec->rounds = malloc(cfg->rounds_to_win * sizeof(RoundEntry));
+    if (!rec->stats || !rec->rounds ||
+        fwrite(&rec->header, sizeof(RecordingHeader), 1, rec->file) != 1) {
+        fclose(rec->file);
+        return -1;
+    }
+    // Nothing buffered may be left for forked children to flush a second time
+    fflush(rec->file);
+    return 0;
+}
+
+void recording_frame(Recording* rec, int round, int tick, long clock_tick, const PlayerStore* store) {
+    RecordFrame frame = { round, tick, clock_tick };
+    int team_size = rec->header.config.team_size;
+    for (int i = 0; i < rec->header.num_players; i++) {
+        rec->stats[i].player_id = i % team_size;
+        rec->stats[i].position = store->position[i];
+        rec->stats[i].energy = store->energy[i];
+        rec->stats[i].effort = store->effort[i];
+    }
+    fwrite(&frame, sizeof(frame), 1, rec->file);
+    fwrite(rec->stats, sizeof(PlayerStats), rec->header.num_players, rec->file);
+    rec->header.num_frames++;
+}
+
+void recording_round(Recording* rec, int winner) {
+    RoundEntry* entry = &rec->rounds[rec->header.num_rounds++];
+    entry->first_frame = rec->round_start;
+    entry->num_frames = rec->header.num_frames - rec->round_start;
+    entry->winner = winner;
+    entry->reserved = 0;
+    rec->round_start = rec->header.num_frames;
+}
+
+// ##################################
+// The index goes after the last frame; the header is rewritten last, so a
+// recording cut short keeps index_offset == 0 and is still readable
+// ##################################
+void recording_close(Recording* rec, int final_winner) {
+    rec->header.index_offset = sizeof(RecordingHeader) + (long)rec->header.num_frames * rec->frame_size;
+    rec->header.final_winner = final_winner;
+    fwrite(rec->rounds, sizeof(RoundEntry), rec->header.num_rounds, rec->file);
+    fseek(rec->file, 0, SEEK_SET);
+    fwrite(&rec->header, sizeof(RecordingHeader), 1, rec->file);
+    fclose(rec->file);
+    free(rec->stats);
+    free(rec->rounds);
+}
+
+int replay_open(Replay* rep, const char* path) {
+    memset(rep, 0, sizeof(*rep));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(RecordingHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    rep->header = data;
+    rep->length = st.st_size;
+    if (memcmp(rep->header->magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 ||
+        rep->header->version != RECORDING_VERSION || rep->header->num_players <= 0) {
+        munmap(data, st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    rep->frame_size = frame_size(rep->header->num_players);
+    rep->frames = (const char*)data + sizeof(RecordingHeader);
+    // Trust the index only if it sits right after the frames and fits in the file;
+    // otherwise replay whatever whole frames are there
+    long index_offset = sizeof(RecordingHeader) + (long)rep->header->num_frames * rep->frame_size;
+    if (rep->header->index_offset > 0 && rep->header->index_offset == index_offset &&
+        index_offset + rep->header->num_rounds * (long)sizeof(RoundEntry) <= st.st_size) {
+        rep->num_frames = rep->header->num_frames;
+        rep->num_rounds = rep->header->num_rounds;
+        rep->rounds = (const RoundEntry*)((const char*)data + index_offset);
+    } else {
+        rep->num_frames = (st.st_size - sizeof(RecordingHeader)) / rep->frame_size;
+    }
+    return 0;
+}
+
+void replay_close(Replay* rep) {
+    munmap((void*)rep->header, rep->length);
+}
+
+const RecordFrame* replay_frame(const Replay* rep, int k) {
+    return (const RecordFrame*)(rep->frames + (size_t)k * rep->frame_size);
+}
+
+const PlayerStats* replay_players(const RecordFrame* frame) {
+    return (const PlayerStats*)(frame + 1);
+}
+
+const RoundEntry* replay_round(const Replay* rep, int r) {
+    return &rep->rounds[r - 1];
+}
@@ -1,330 +1,1363 @@
 #include "header.h"
 #include "constants.h"
 #include "structs.h"
+#include "player_store.h"
+#include "coro_runtime.h"
+#include "rank_index.h"
+#include "rules.h"
+#include "tick_kernel.h"
+#include "recording.h"
+#include "state_bus.h"
+#include "metrics.h"
+#include "protocol.h"
+#include "output_sink.h"
+#include "config.h"
+#include "player_pool.h"
+#include "transport.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include "realtime.h"
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+#include <poll.h>
 
-// Global configuration and players array
+// Global configuration and players array. Player processes read the configuration from
+// shared_config, which reload_config() updates when the file changes.
 GameConfig config;
-pid_t players[NUM_PLAYERS];
+const char* config_path;
+SharedConfig* shared_config = NULL;
+int config_fd = -1;
+ConfigWatch config_watch = { .fd = -1 };
+int num_players;
+pid_t* players;
+
+// State of every player as the referee sees it. With shm it lives in the shared segment
+// and with coro in the runtime; over a stream the replies are copied into local_store,
+// and with batch the referee updates local_store itself.
+PlayerStore* store;
+PlayerStore local_store;
+
+// Positions are kept up to date incrementally, one rank index per team. Players whose
+// position moved since the last tick request are listed in changed[] (and flagged).
+RankIndex* ranks;
+int* changed;
+int num_changed = 0;
+char* flagged;
+int* sent_position;         // Last position handed out to each player
+
+// Tick transport: a stream per player (anonymous pipes, or Unix or TCP socket connections,
+// see transport.h), one shared-memory segment, or no player processes at all with the
+// in-process coroutine runtime or the batch kernel
+typedef enum { TRANSPORT_PIPE, TRANSPORT_SHM, TRANSPORT_CORO, TRANSPORT_BATCH, TRANSPORT_UNIX, TRANSPORT_TCP } Transport;
+const char* transport_names[] = { "pipe", "shm", "coro", "batch", "unix", "tcp" };
+Transport transport = TRANSPORT_PIPE;
+int (*read_pipes)[2], (*write_pipes)[2];
+int* request_fds;           // Per player over a stream: where its tick requests go
+int* reply_fds;             // and where its replies come from (the same socket, or two pipes), non-blocking
+FrameReader* readers;       // Per player over a stream: the reply frame read so far
+TransportAddress address;   // Where socket players connect
+char player_target[300];    // The address as given to socket players forked here
+int listen_fd = -1;         // Stays open for the match, so lost socket players can be replaced
+int remote_players = 0;     // Socket players are started elsewhere rather than forked here
+uint32_t config_generation = 1;     // Reloads so far
+uint32_t* config_sent;      // Per socket player: the generation it was last sent in-band
+char* received;             // Per player: answered the current tick in time
+SharedTick* tick = NULL;
+PlayerStore shared_store;
+size_t tick_size = 0;
+int tick_fd = -1;
+CoroRuntime* runtime = NULL;
+const long* coro_reply_times = NULL;     // When each coroutine player finished its tick, with metrics on
+KernelLevel kernel_level = KERNEL_SCALAR;
+uint32_t ticks_played = 0;  // Tick requests sent so far, echoed back in every reply
+
+// Optional zygote pool the player processes are taken from instead of fork+exec (see player_pool.h)
+const char* pool_path = NULL;
+int pool_fd = -1;
+
+// Reply deadlines and supervision of the player processes. Replies to a tick are taken
+// until its deadline; a player that has not answered by then is scored by the late policy
+// (its last reply stands, or it pulls nothing as if fallen) and gets no new request until
+// its overdue reply is in. A player process that exits (pidfd) or drops its link is replaced.
+typedef enum { LATE_LAST, LATE_FALLEN } LatePolicy;
+const char* late_policy_names[] = { "last", "fallen" };
+LatePolicy late_policy = LATE_LAST;
+#define DEFAULT_DEADLINE_MS 1000    // On the virtual clock; on the real one, the tick period
+#define MAX_RESTARTS 5              // Per player process, after which its slot stays empty
+long deadline_ms = 0;
+
+// A slot is played by a player that has said hello, waits for one that is starting or
+// joining, or is empty after its player was lost
+typedef enum { SLOT_PLAYING, SLOT_JOINING, SLOT_VACANT } SlotState;
+char* slot_state;
+uint32_t* owed;             // Over a stream: the tick a player still owes a reply to, or 0
+int pending_replies = 0;    // Players owing a reply to the current tick
+uint32_t* shm_replies;      // With shm: the last tick each player answered
+int64_t* shm_reply_times;   // With shm: when each player answered it
+int* pid_fds;               // Per player process: pidfd watching for its exit, or -1
+int* restarts;              // Per player process: replacements so far
+char* restore_state;        // Over a stream: the player takes over its slot's state with its next request
+long late_replies = 0, restarted = 0;
+
+// Event loop: a periodic absolute timerfd for the ticks, the player reply streams, the
+// listening socket and the pidfds of the player processes
+#define TIMER_EVENT 0xffffffffu
+#define LISTEN_EVENT 0xfffffffeu
+#define EXIT_EVENT 0x80000000u      // Or'ed with the index of the process in players[]
+#define MAX_EVENTS 64
+int epoll_fd = -1;
+int timer_fd = -1;
+uint64_t pending_ticks = 0;
+long overruns = 0;
+
+// Game clock in ticks. In virtual mode it only advances when all players have answered,
+// so a match runs as fast as the processes can exchange messages.
+int virtual_clock = 0;
+long clock_ticks = 0;
+
+// Optional checkpoint of the match after every tick, and a match resumed from one (see checkpoint.h)
+const char* checkpoint_path = NULL;
+int resume = 0;
+Checkpoint checkpoint;
+
+// Optional trace of every process of the match, merged into one Chrome trace at the end (see trace.h)
+const char* trace_path = NULL;
+char trace_dir[PATH_MAX];
+
+// Optional real-time mode: CPU pinning, real-time policy and locked memory (see realtime.h)
+const char* realtime_spec = NULL;
+RealtimeConfig realtime;
+
+// Tick periods and wake-up latencies on the real clock, measured against the timer's deadlines
+TickJitter jitter;
+long first_deadline_ns = 0;
+long deadlines_passed = 0;
+
+// Optional binary recording of every tick (see recording.h)
+const char* record_path = NULL;
+Recording recording;
+
+// Every tick is published here for the visualizer and any other reader (see state_bus.h)
+StateBus bus;
+
+// Optional live metrics served on a Unix socket (see metrics.h); NULL when off
+const char* metrics_path = NULL;
+Metrics* metrics = NULL;
+long tick_sent_ns = 0;          // When the current tick requests went out: reply latencies and deadline
+
+// All match output goes through a sink that formats it on its own thread (see output_sink.h)
+OutputFormat output_format = OUTPUT_HUMAN;
+OutputSink* sink = NULL;
 
 // ##################################
 // Loads game configuration values from a file provided by the user
 // ##################################
 void read_config(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        perror("Failed to open config file");
+    char error[256];
+    if (config_load(filename, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
         exit(EXIT_FAILURE);
     }
+}
 
-    char line[100];
+// ##################################
+// Takes in an edited config file at a tick boundary: the ranges and threshold change for
+// the rest of the match, and player processes see them with their next tick request.
+// A file that does not parse is ignored and the match goes on with what it has.
+// ##################################
+void reload_config() {
+    GameConfig fresh;
+    char error[256];
+    if (config_load(config_path, &fresh, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Config: keeping the current settings, %s\n", error);
+        return;
+    }
+    if (config_apply_live(&config, &fresh))
+        fprintf(stderr, "Config: duration, rounds, tick period, seed and teams only change on restart\n");
+
+    if (shared_config) config_publish(shared_config, &config);
+    if (runtime) coro_runtime_configure(runtime, &config);
+    config_generation++;
+    fprintf(stderr, "Config: reloaded at tick %u (energy %d-%d, decrease %d-%d, recovery %d-%d, threshold %d)\n",
+            ticks_played, config.energy_min, config.energy_max, config.decrease_min, config.decrease_max,
+            config.recovery_min, config.recovery_max, config.win_threshold);
+}
+
+// Pipes and sockets carry the same frames and are driven the same way
+int stream_transport() {
+    return transport == TRANSPORT_PIPE || transport == TRANSPORT_UNIX || transport == TRANSPORT_TCP;
+}
+
+// ##################################
+// Builds the rank index of every team from the starting energies; every player
+// is listed as changed so the first tick hands out all positions
+// ##################################
+void setup_ranking() {
+    ranks = calloc(config.num_teams, sizeof(RankIndex));
+    changed = malloc(num_players * sizeof(int));
+    flagged = calloc(num_players, 1);
+    sent_position = calloc(num_players, sizeof(int));
+    for (int t = 0; t < config.num_teams; t++) {
+        if (rank_index_init(&ranks[t], config.team_size, t * config.team_size,
+                            store->energy, store->position) < 0) {
+            perror("Failed to build rank index");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < num_players; i++) {
+        changed[i] = i;
+        flagged[i] = 1;
+    }
+    num_changed = num_players;
+}
+
+// Gives player positions based on their current energy levels (see rank_index.h)
+void update_positions() {
+    for (int t = 0; t < config.num_teams; t++)
+        rank_index_update(&ranks[t], t * config.team_size, store->energy, store->position, changed,
+                          &num_changed, flagged);
+}
 
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d %d", &config.energy_min, &config.energy_max) != 2) {
-        fprintf(stderr, "Error: Invalid energy range in config\n"); 
+// Adds up each team's effort
+void team_totals(int totals[]) {
+    for (int t = 0; t < config.num_teams; t++) {
+        totals[t] = 0;
+        for (int k = 0; k < config.team_size; k++)
+            totals[t] += store->effort[t * config.team_size + k];
+    }
+}
+
+// ##################################
+// Creates the shared tick segment; the fd is inherited by the players across exec
+// ##################################
+void setup_shared_tick() {
+    tick_size = shared_tick_size(num_players);
+    tick_fd = memfd_create("rope_tick", 0);
+    if (tick_fd < 0 || ftruncate(tick_fd, tick_size) < 0) {
+        perror("Failed to create shared tick segment");
         exit(EXIT_FAILURE);
     }
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d %d", &config.decrease_min, &config.decrease_max) != 2) {
-        fprintf(stderr, "Error: Invalid decrease range in config\n"); 
+    tick = mmap(NULL, tick_size, PROT_READ | PROT_WRITE, MAP_SHARED, tick_fd, 0);
+    if (tick == MAP_FAILED) {
+        perror("Failed to map shared tick segment");
         exit(EXIT_FAILURE);
     }
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d %d", &config.recovery_min, &config.recovery_max) != 2) {
-        fprintf(stderr, "Error: Invalid recovery range in config\n"); 
+    memset(tick, 0, tick_size);
+    tick->num_players = num_players;
+    tick->version = PROTOCOL_VERSION;
+    tick->referee = getpid();
+    tick->tick = ticks_played;      // Nonzero when resuming: the players go on from the store
+    sem_init(&tick->replies, 1, 0);
+    shared_tick_attach(tick, &shared_store);
+    shm_replies = shared_tick_replies(tick);
+    shm_reply_times = shared_tick_reply_times(tick);
+    store = &shared_store;
+}
+
+// ##################################
+// Starting state of every player in local_store: the referee plays the rows itself with
+// batch, and over a stream they mirror the players until their replies come in
+// ##################################
+void init_players() {
+    if (player_store_init(&local_store, num_players) < 0) {
+        perror("Failed to allocate players");
         exit(EXIT_FAILURE);
     }
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d", &config.win_threshold) != 1) {
-        fprintf(stderr, "Error: Invalid win threshold in config\n"); 
+    store = &local_store;
+    for (int i = 0; i < num_players; i++)
+        init_player(store, i, &config, i % config.team_size, i, config.seed);
+}
+
+// ##################################
+// A resumed match puts every player back where the checkpoint left it, before any
+// player process starts: shm players find their state in the store, players over a
+// stream get it with their first tick request
+// ##################################
+void restore_players() {
+    if (!resume) return;
+    checkpoint_restore(&checkpoint, NULL, NULL, store);
+    if (stream_transport()) memset(restore_state, 1, num_players);
+}
+
+// Returns the current monotonic time in milliseconds
+long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+// New pipes for slot i, close-on-exec so no other player process inherits them
+void open_pipes(int i) {
+    if (pipe2(read_pipes[i], O_CLOEXEC) < 0 || pipe2(write_pipes[i], O_CLOEXEC) < 0) {
+        perror("Failed to create pipes");
         exit(EXIT_FAILURE);
     }
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d", &config.game_duration) != 1) {
-        fprintf(stderr, "Error: Invalid game duration in config\n"); 
+    request_fds[i] = write_pipes[i][1];
+    reply_fds[i] = read_pipes[i][0];
+    fcntl(reply_fds[i], F_SETFL, O_NONBLOCK);
+    readers[i].got = 0;
+}
+
+// Closes the player's ends of slot i's pipes once its process has them
+void close_child_pipes(int i) {
+    close(read_pipes[i][1]);
+    close(write_pipes[i][0]);
+}
+
+// ##################################
+// Forks and execs a player: for slot i over its pipes or the shm segment, or over a
+// socket, where it gets whichever slot is free when it connects. Returns the pid.
+// The player is sent SIGTERM if the referee dies, even before it got to exec.
+// ##################################
+pid_t fork_player(int i) {
+    pid_t referee = getpid();
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != referee) _exit(1);
+    signal(SIGPIPE, SIG_DFL);
+    if (transport == TRANSPORT_UNIX || transport == TRANSPORT_TCP) {
+        execl("./player", "player", transport_names[transport], player_target, NULL);
+    } else {
+        char pos[16], rfd[16], wfd[16], sfd[16], cfd[16], slot[16];
+        sprintf(pos, "%d", i % config.team_size);
+        sprintf(slot, "%d", i);
+        sprintf(cfd, "%d", config_fd);
+        if (transport == TRANSPORT_SHM) {
+            sprintf(sfd, "%d", tick_fd);
+            execl("./player", "player", pos, "-1", "-1", cfd, slot, sfd, NULL);
+        } else {
+            // Its own ends of its own pipes are the only ones the player keeps across exec
+            fcntl(write_pipes[i][0], F_SETFD, 0);
+            fcntl(read_pipes[i][1], F_SETFD, 0);
+            sprintf(rfd, "%d", write_pipes[i][0]);
+            sprintf(wfd, "%d", read_pipes[i][1]);
+            execl("./player", "player", pos, rfd, wfd, cfd, slot, NULL);
+        }
+    }
+    perror("execl failed");
+    _exit(1);
+}
+
+// In real-time mode, pins player process k to its CPU and gives it its policy
+void place_player(int k) {
+    if (!realtime_spec || players[k] <= 0) return;
+    if (realtime_place_player(&realtime, players[k], k, num_players, config.tick_ms * 1000000L) < 0) {
+        perror("Failed to set real-time scheduling for player");
         exit(EXIT_FAILURE);
     }
-    if (!fgets(line, sizeof(line), file) || sscanf(line, "%d", &config.rounds_to_win) != 1) {
-        fprintf(stderr, "Error: Invalid rounds to win in config\n"); 
+}
+
+// Sends slot i with its descriptors to the player pool
+void assign_slot(int i) {
+    PoolAssignment a = { i, i % config.team_size, transport == TRANSPORT_SHM };
+    int fds[POOL_MAX_FDS] = { config_fd, tick_fd };
+    if (!a.shm) {
+        fds[1] = write_pipes[i][0];
+        fds[2] = read_pipes[i][1];
+    }
+    if (pool_send(pool_fd, &a, sizeof(a), fds, a.shm ? 2 : 3) < 0) {
+        perror("Failed to assign player");
         exit(EXIT_FAILURE);
     }
+}
 
-    fclose(file);
+// Reads the pool's answer to one assignment and records the leased player
+void take_lease() {
+    PoolLease lease;
+    int fds[POOL_MAX_FDS], n;
+    int got = pool_receive(pool_fd, &lease, sizeof(lease), fds, &n);
+    if (got <= 0 || lease.pid < 0 || lease.slot < 0 || lease.slot >= num_players) {
+        if (got == 0) errno = EPIPE;
+        else if (got > 0) errno = lease.pid < 0 ? lease.error : EPROTO;
+        perror("Player pool refused a slot");
+        exit(EXIT_FAILURE);
+    }
+    players[lease.slot] = lease.pid;
 }
 
 // ##################################
-// Gives player positions based on their current energy levels
+// Takes the player processes from a zygote pool: every slot is sent with its descriptors
+// at once, then the pool's answers are read, so the whole match costs one round trip
 // ##################################
-void assign_positions(int energies[], int positions[]) {
-    int order[TEAM_SIZE] = {0, 1, 2, 3};
-    for (int i = 0; i < TEAM_SIZE-1; i++) {
-        for (int j = i+1; j < TEAM_SIZE; j++) {
-            if (energies[order[i]] > energies[order[j]]) {
-                int tmp = order[i];
-                order[i] = order[j];
-                order[j] = tmp;
-            }
-        }
+void lease_players() {
+    pool_fd = pool_connect(pool_path);
+    if (pool_fd < 0) {
+        perror("Failed to connect to player pool");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < num_players; i++) assign_slot(i);
+    for (int i = 0; i < num_players; i++) take_lease();
+}
+
+// Gives the socket connection fd slot i, with the slot, position and settings in its welcome
+int welcome_player(int i, int fd) {
+    Message msg;
+    msg.welcome.slot = i;
+    msg.welcome.player_id = i % config.team_size;
+    msg.welcome.config = config;
+    if (protocol_send(fd, &msg, MSG_WELCOME) < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    readers[i].got = 0;
+    request_fds[i] = reply_fds[i] = fd;
+    config_sent[i] = config_generation;
+    slot_state[i] = SLOT_JOINING;
+    return 0;
+}
+
+// ##################################
+// Watches player process k for its exit. A pidfd works for the pool's players as well as
+// our own children; without one (before Linux 5.3) a lost player still shows up as late.
+// ##################################
+void watch_process(int k) {
+    pid_fds[k] = syscall(SYS_pidfd_open, players[k], 0);
+    if (pid_fds[k] < 0) return;
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.u32 = EXIT_EVENT | k;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pid_fds[k], &ev);
+}
+
+// Makes sure player process k is gone, and reaps it unless the pool owns it
+void end_process(int k) {
+    if (players[k] <= 0) return;
+    if (pid_fds[k] >= 0) {
+        syscall(SYS_pidfd_send_signal, pid_fds[k], SIGKILL, NULL, 0);
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, pid_fds[k], NULL);
+        close(pid_fds[k]);
+        pid_fds[k] = -1;
+    } else if (!pool_path) {
+        kill(players[k], SIGKILL);
     }
-    for (int i = 0; i < TEAM_SIZE; i++) {
-        positions[order[i]] = i + 1;
+    if (!pool_path) waitpid(players[k], NULL, 0);
+    players[k] = 0;
+}
+
+// ##################################
+// Frees slot i after its player was lost: its stream is closed and nothing more is
+// expected from it until a new player takes the slot
+// ##################################
+void vacate_slot(int i) {
+    if (slot_state[i] == SLOT_VACANT) return;
+    if (stream_transport()) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, reply_fds[i], NULL);
+        close(reply_fds[i]);
+        if (request_fds[i] != reply_fds[i]) close(request_fds[i]);
+        request_fds[i] = reply_fds[i] = -1;
+        if (owed[i] && owed[i] == ticks_played) pending_replies--;
+        owed[i] = 0;
     }
+    slot_state[i] = SLOT_VACANT;
+    fprintf(stderr, "Player %d: lost at tick %u\n", i, ticks_played);
 }
 
 // ##################################
-// Controls the entire game flow: signals players, reads data, and decides winners
+// Replaces lost player process k: a new one for slot k over pipes or shm (forked or
+// leased), or one more socket player, which takes the first free slot when it connects.
+// After MAX_RESTARTS the slot stays empty for the rest of the match.
 // ##################################
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <config_file>\n", argv[0]);
+void restart_player(int k) {
+    if (restarts[k] == MAX_RESTARTS) {
+        fprintf(stderr, "Player %d: restarted %d times already, leaving it out\n", k, MAX_RESTARTS);
+        return;
+    }
+    restarts[k]++;
+
+    if (transport == TRANSPORT_PIPE) open_pipes(k);
+    if (pool_path) {
+        assign_slot(k);
+        take_lease();
+    } else if ((players[k] = fork_player(k)) < 0) {
+        perror("Failed to restart player");
+        exit(EXIT_FAILURE);
+    }
+    place_player(k);
+    if (transport == TRANSPORT_PIPE) {
+        close_child_pipes(k);
+        struct epoll_event ev = { .events = EPOLLIN };
+        ev.data.u32 = k;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, reply_fds[k], &ev);
+        slot_state[k] = SLOT_JOINING;
+        restore_state[k] = 1;           // It goes on from the last state its slot replied
+    } else if (transport == TRANSPORT_SHM) {
+        slot_state[k] = SLOT_PLAYING;   // It answers the next tick it sees, from the store
+    }
+    watch_process(k);
+    restarted++;
+    metrics_restart(metrics);
+    fprintf(stderr, "Player %d: restarted at tick %u\n", k, ticks_played);
+}
+
+// Slot i's stream broke off: a pipe player is replaced at once, a socket player's slot
+// waits for the next connection
+void player_lost(int i) {
+    vacate_slot(i);
+    if (transport == TRANSPORT_PIPE) {
+        end_process(i);
+        restart_player(i);
+    }
+}
+
+// ##################################
+// Player process k exited: with pipes and shm its slot is freed, and the process is
+// replaced. Returns 0 for an event left over from a process already replaced.
+// ##################################
+int process_exited(int k) {
+    struct pollfd p = { .fd = pid_fds[k], .events = POLLIN };
+    if (pid_fds[k] < 0 || poll(&p, 1, 0) <= 0) return 0;
+    end_process(k);
+    if (transport == TRANSPORT_PIPE || transport == TRANSPORT_SHM) vacate_slot(k);
+    restart_player(k);
+    return 1;
+}
+
+// A socket player connected during the match: it takes the first free slot, if any, and
+// goes on from the last state that slot replied
+void accept_player() {
+    int fd = transport_accept(listen_fd);
+    if (fd < 0) return;
+    int i = 0;
+    while (i < num_players && slot_state[i] != SLOT_VACANT) i++;
+    if (i == num_players || welcome_player(i, fd) < 0) {
+        close(fd);
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.u32 = i;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    restore_state[i] = 1;
+    fprintf(stderr, "Player %d: joined at tick %u\n", i, ticks_played);
+}
+
+// ##################################
+// Reads what player i sent: its hello while it is starting, else its reply to the tick it
+// owes. Returns 1 for a reply to tick t in time, -1 if the player was lost, else 0.
+// A late reply (t is 0 between ticks) still becomes the player's last known state.
+// Part of a frame is kept for the next read; until the rest is in, the player has not
+// replied, and at the deadline it is late like any other.
+// ##################################
+int read_reply(int i, uint32_t t) {
+    if (slot_state[i] == SLOT_VACANT) return 0;
+    int joining = slot_state[i] == SLOT_JOINING;
+    int got = protocol_receive_part(reply_fds[i], &readers[i], joining ? MSG_HELLO : MSG_REPLY);
+    if (got < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+    const Message msg = readers[i].msg;
+    if (got > 0 && joining && msg.hello.slot == i) {
+        slot_state[i] = SLOT_PLAYING;
+        return 0;
+    }
+    if (got > 0 && !joining && owed[i] && msg.reply.tick == owed[i]) {
+        trace(TRACE_REQUEST, TRACE_FLOW_END, msg.reply.tick, trace_request_id(msg.reply.tick, i));
+        store->energy[i] = msg.reply.energy;
+        store->effort[i] = msg.reply.effort;
+        store->active[i] = msg.reply.active;
+        store->recovery[i] = msg.reply.recovery;
+        store->ticks[i] = msg.reply.ticks;
+        owed[i] = 0;
+        if (msg.reply.tick != t) return 0;
+        received[i] = 1;
+        pending_replies--;
+        if (metrics) metrics_reply(metrics, i, metrics_now_ns() - tick_sent_ns);
         return 1;
     }
 
-    read_config(argv[1]);
+    if (got == 0) errno = EPIPE;
+    else if (got > 0) errno = EPROTO;
+    fprintf(stderr, "Player %d: ", i);
+    perror(joining ? "Bad hello" : "Bad tick reply");
+    player_lost(i);
+    return -1;
+}
 
-    pid_t visual_pid = fork();
-    if (visual_pid == 0) {
-        execl("./visual", "visual", NULL);
-        perror("Failed to launch visual");
-        exit(1);
-    } else {
-        sleep(1);
+// Reads the timer's expiration count so the level-triggered event stops firing
+void drain_timer() {
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+        pending_ticks += expirations;
+}
+
+// ##################################
+// Handles one event of the loop while tick t is being collected (0 between ticks).
+// Returns -1 when players were lost or joined, as the rest of the batch may be stale.
+// ##################################
+int handle_event(uint32_t id, uint32_t t) {
+    if (id == TIMER_EVENT) {
+        drain_timer();
+        return 0;
+    }
+    if (id == LISTEN_EVENT) {
+        accept_player();
+        return -1;
     }
+    if (id & EXIT_EVENT) return process_exited(id & ~EXIT_EVENT) ? -1 : 0;
+    return read_reply(id, t);
+}
+
+// Handles the player events already waiting, without blocking
+void poll_players() {
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 0);
+    for (int k = 0; k < n && handle_event(events[k].data.u32, 0) >= 0; k++);
+}
 
-    int read_pipes[NUM_PLAYERS][2], write_pipes[NUM_PLAYERS][2];
-    for (int i = 0; i < NUM_PLAYERS; i++) {
-        pipe(read_pipes[i]);
-        pipe(write_pipes[i]);
+// ##################################
+// Creates the epoll set over the tick timer, the player reply streams, the listening
+// socket and the player processes
+// ##################################
+void setup_event_loop() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (epoll_fd < 0 || timer_fd < 0) {
+        perror("Failed to create event loop");
+        exit(EXIT_FAILURE);
     }
 
-    for (int i = 0; i < NUM_PLAYERS; i++) {
-        players[i] = fork();
-        if (players[i] == 0) {
-            for (int j = 0; j < NUM_PLAYERS; j++) {
-                if (j != i) {
-                    close(read_pipes[j][0]); 
-                    close(read_pipes[j][1]);
-                    close(write_pipes[j][0]); 
-                    close(write_pipes[j][1]);
-                }
-            }
-            char pos[10], rfd[10], wfd[10];
-            sprintf(pos, "%d", i % TEAM_SIZE);
-            sprintf(rfd, "%d", write_pipes[i][0]);
-            sprintf(wfd, "%d", read_pipes[i][1]);
-            execl("./player", "player", pos, rfd, wfd, argv[1], NULL);
-            perror("execl failed");
-            exit(1);
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.u32 = TIMER_EVENT;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+    if (stream_transport()) {
+        for (int i = 0; i < num_players; i++) {
+            if (slot_state[i] == SLOT_VACANT) continue;
+            ev.data.u32 = i;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, reply_fds[i], &ev);
         }
     }
-
-    for (int i = 0; i < NUM_PLAYERS; i++) {
-        close(read_pipes[i][1]);
-        close(write_pipes[i][0]);
+    if (listen_fd >= 0) {
+        ev.data.u32 = LISTEN_EVENT;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
     }
+    if (players) {
+        for (int k = 0; k < num_players; k++) {
+            if (players[k] > 0) watch_process(k);
+        }
+    }
+}
 
-    sleep(1);
-    int score1 = 0, score2 = 0;
-    int last_winner = 0;
-    int consecutive_wins = 0;
-    int prev_energy_t1[TEAM_SIZE] = {0}, prev_energy_t2[TEAM_SIZE] = {0};
-    time_t start_time = time(NULL);
+// ##################################
+// Arms the tick timer with absolute, drift-free deadlines (not used on the virtual clock)
+// ##################################
+void start_ticks() {
+    if (virtual_clock) return;
 
-    for (int i = 0; i < NUM_PLAYERS; i++) {
-        char pipe_name[50];
-        sprintf(pipe_name, "/tmp/player_pipe_%d", i);
-        mkfifo(pipe_name, 0666);
+    struct timespec first;
+    clock_gettime(CLOCK_MONOTONIC, &first);
+    long ns = first.tv_nsec + config.tick_ms * 1000000L;
+    first.tv_sec += ns / 1000000000L;
+    first.tv_nsec = ns % 1000000000L;
+
+    struct itimerspec spec;
+    spec.it_value = first;
+    spec.it_interval.tv_sec = config.tick_ms / 1000;
+    spec.it_interval.tv_nsec = (config.tick_ms % 1000) * 1000000L;
+    first_deadline_ns = first.tv_sec * 1000000000L + first.tv_nsec;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+// ##################################
+// Blocks until the next tick deadline; deadlines missed while busy are skipped and counted.
+// Late replies, lost players and connections that come in meanwhile are handled too.
+// On the virtual clock the next tick starts right away.
+// ##################################
+void wait_for_tick() {
+    if (virtual_clock) {
+        clock_ticks++;
+        metrics_tick(metrics, 0);
+        return;
     }
 
-    for (int round = 1; round <= config.rounds_to_win; round++) {
-        printf("\n=== Round %d ===\n\n", round);
-        sleep(1);
+    struct epoll_event events[MAX_EVENTS];
+    while (pending_ticks == 0) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        for (int k = 0; k < n && handle_event(events[k].data.u32, 0) >= 0; k++);
+    }
+    deadlines_passed += pending_ticks;
+    tick_jitter_add(&jitter, metrics_now_ns(), first_deadline_ns + (deadlines_passed - 1) * config.tick_ms * 1000000L);
+    clock_ticks += pending_ticks;
+    overruns += pending_ticks - 1;
+    metrics_tick(metrics, pending_ticks - 1);
+    pending_ticks = 0;
+}
 
-        PlayerStats t1_stats[TEAM_SIZE], t2_stats[TEAM_SIZE];
-        int team1_energies[TEAM_SIZE], team2_energies[TEAM_SIZE];
-        int team1_pos[TEAM_SIZE], team2_pos[TEAM_SIZE];
-        int total1 = 0, total2 = 0;
-        int second = 1;
+// Number of players that have not said hello yet
+int players_joining() {
+    int joining = 0;
+    for (int i = 0; i < num_players; i++) joining += slot_state[i] == SLOT_JOINING;
+    return joining;
+}
 
-        time_t round_start = time(NULL);
-        while (1) {
-            int real_seconds = (int)(time(NULL) - round_start);
-            printf("⏲️  Round %d - Second %d\n", round, second++);
+// With shm: marks the players that answered tick t and returns how many did; each reply
+// is timed by the clock reading its player left next to it
+int shm_answered(uint32_t t) {
+    int answered = 0;
+    for (int i = 0; i < num_players; i++) {
+        char got = __atomic_load_n(&shm_replies[i], __ATOMIC_ACQUIRE) == t;
+        if (got && !received[i]) metrics_reply(metrics, i, shm_reply_times[i] - tick_sent_ns);
+        received[i] = got;
+        answered += got;
+    }
+    return answered;
+}
 
-            for (int i = 0; i < NUM_PLAYERS; i++) kill(players[i], SIGUSR1);
-            sleep(1);
+// ##################################
+// Scores the players that missed the deadline: with the "last" policy their last reply
+// stands, with "fallen" they pull nothing this tick, and neither does an empty slot or
+// a player still starting
+// ##################################
+void score_late() {
+    int late = 0;
+    for (int i = 0; i < num_players; i++) {
+        if (received[i]) continue;
+        late++;
+        if (late_policy == LATE_FALLEN || slot_state[i] != SLOT_PLAYING) store->effort[i] = 0;
+    }
+    late_replies += late;
+    metrics_late(metrics, late);
+    if (late) trace(TRACE_LATE, TRACE_INSTANT, late, 0);
+}
 
-            for (int i = 0; i < TEAM_SIZE; i++) {
-                read(read_pipes[i][0], &t1_stats[i], sizeof(PlayerStats));
-                team1_energies[i] = t1_stats[i].energy;
+// ##################################
+// Waits until every player has replied to tick t or the tick's reply deadline passed, or
+// (with no deadline) until every player has said hello when t is 0. With shm and coro the
+// players update the store in place; over a stream each reply is copied into it.
+// ##################################
+void collect_replies(uint32_t t) {
+    if (transport == TRANSPORT_BATCH) return;
+    Metrics* m = t ? metrics : NULL;        // The hello replies are not timed
+    if (transport == TRANSPORT_CORO) {
+        coro_runtime_wait(runtime);
+        if (m) {
+            for (int i = 0; i < num_players; i++) metrics_reply(m, i, coro_reply_times[i] - tick_sent_ns);
+        }
+        return;
+    }
+    long deadline = tick_sent_ns + deadline_ms * 1000000L;
+    memset(received, 0, num_players);
 
-                read(read_pipes[i + TEAM_SIZE][0], &t2_stats[i], sizeof(PlayerStats));
-                team2_energies[i] = t2_stats[i].energy;
+    if (transport == TRANSPORT_SHM) {
+        if (!t) {
+            for (int i = 0; i < num_players; i++) {
+                while (sem_wait(&tick->replies) == -1 && errno == EINTR);
             }
+            return;
+        }
 
-            assign_positions(team1_energies, team1_pos);
-            assign_positions(team2_energies, team2_pos);
-
-            printf("Team 1:\nPlayer | Position | Energy\n");
-            for (int i = 0; i < TEAM_SIZE; i++) {
-                char* status = (team1_energies[i] == 0) ? "FALLEN" : "";
-                printf("T1-P%d   |    %d     |   %3d %s\n",
-                       t1_stats[i].player_id, team1_pos[i], team1_energies[i], status);
+        // Every post counts, but some are late ones for an earlier tick (or a restarted
+        // player's hello), so the replies array has the last word once enough came in
+        struct timespec until = { deadline / 1000000000L, deadline % 1000000000L };
+        int waiting = 0, answered = 0, posts = 0;
+        for (int i = 0; i < num_players; i++) waiting += slot_state[i] == SLOT_PLAYING;
+        while (answered < waiting) {
+            if (sem_trywait(&tick->replies) < 0) {
+                metrics_reply_wait(m);
+                if (sem_clockwait(&tick->replies, CLOCK_MONOTONIC, &until) < 0) {
+                    if (errno != ETIMEDOUT) continue;
+                    answered = shm_answered(t);
+                    break;
+                }
             }
+            if (answered + ++posts < waiting) continue;
+            answered = shm_answered(t);
+            posts = 0;
+        }
 
-            printf("\nTeam 2:\nPlayer | Position | Energy\n");
-            for (int i = 0; i < TEAM_SIZE; i++) {
-                char* status = (team2_energies[i] == 0) ? "FALLEN" : "";
-                printf("T2-P%d   |    %d     |   %3d %s\n",
-                       t2_stats[i].player_id, team2_pos[i], team2_energies[i], status);
+        // A player that died shows up here, as one that missed the deadline
+        if (trace_buffer) {
+            for (int i = 0; i < num_players; i++) {
+                if (received[i]) trace(TRACE_REQUEST, TRACE_FLOW_END, t, trace_request_id(t, i));
             }
+            trace(TRACE_REPLIES, TRACE_INSTANT, t, 0);
+        }
+        if (answered < num_players) score_late();
+        if (answered < waiting) poll_players();
+        return;
+    }
 
-            printf("-----------------------------------------\n");
+    // Take the replies in whatever order they arrive, until the last one or the deadline
+    struct epoll_event events[MAX_EVENTS];
+    while (t ? pending_replies > 0 : players_joining() > 0) {
+        int timeout = -1;
+        if (t) {
+            long left = deadline - metrics_now_ns();
+            if (left <= 0) break;
+            timeout = (left + 999999) / 1000000;
+        }
+        metrics_reply_wait(m);
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+        for (int k = 0; k < n && handle_event(events[k].data.u32, t) >= 0; k++);
+    }
+    if (t) {
+        trace(TRACE_REPLIES, TRACE_INSTANT, t, 0);
+        score_late();
+    }
+}
 
-            for (int i = 0; i < TEAM_SIZE; i++) {
-                write(write_pipes[i][1], &team1_pos[i], sizeof(int));
-                write(write_pipes[i + TEAM_SIZE][1], &team2_pos[i], sizeof(int));
+// ##################################
+// Marks the re-ranked positions as handed out. The tick request carries them: over pipes
+// every request has the player's position, with shm and coro it is in place in the store.
+// ##################################
+void send_positions() {
+    int sent = 0;
+    for (int c = 0; c < num_changed; c++) {
+        int i = changed[c];
+        flagged[i] = 0;
+        if (store->position[i] != sent_position[i]) {
+            sent_position[i] = store->position[i];
+            sent++;
+        }
+    }
+    num_changed = 0;
+    metrics_positions_sent(metrics, sent);
+}
+
+// ##################################
+// Ends the match for the players: pooled ones go back to the pool when their channel
+// closes (pipes) or the stop tick comes (shm), and so do players that joined over a
+// socket on their own; processes of our own get SIGTERM
+// ##################################
+void stop_players() {
+    if (pool_path || remote_players) {
+        if (transport == TRANSPORT_SHM) protocol_shm_start(tick, PROTOCOL_TICK_STOP);
+        else {
+            for (int i = 0; i < num_players; i++) {
+                if (request_fds[i] >= 0) close(request_fds[i]);
             }
+        }
+        if (pool_path) close(pool_fd);
+        return;
+    }
+    for (int k = 0; k < num_players; k++) {
+        if (players[k] <= 0) continue;
+        kill(players[k], SIGTERM);
+        waitpid(players[k], NULL, 0);
+    }
+}
 
-            for (int i = 0; i < NUM_PLAYERS; i++) kill(players[i], SIGUSR2);
-            //sleep(1);
+// ##################################
+// Socket players: listens on the address, forks one player per slot that connects to it
+// (unless they are started elsewhere), and welcomes the connections in the order they
+// come. The socket stays open so players can take the slots of lost ones.
+// ##################################
+void connect_players() {
+    listen_fd = transport_listen(&address);
+    if (listen_fd < 0) {
+        perror("Failed to listen for players");
+        exit(EXIT_FAILURE);
+    }
+    init_players();
+    restore_players();
 
-            total1 = 0; total2 = 0;
-            for (int i = 0; i < TEAM_SIZE; i++) {
-                read(read_pipes[i][0], &t1_stats[i], sizeof(PlayerStats));
-                read(read_pipes[i + TEAM_SIZE][0], &t2_stats[i], sizeof(PlayerStats));
-                total1 += t1_stats[i].effort;
-                total2 += t2_stats[i].effort;
-            }
+    char where[300];
+    transport_format(&address, where, sizeof(where));
+    if (remote_players) {
+        fprintf(stderr, "Waiting for %d players on %s\n", num_players, where);
+    } else {
+        // Players forked here reach a wildcard listener over loopback
+        if (address.family == TRANSPORT_FAMILY_UNIX) strcpy(player_target, address.path);
+        else if (!address.host[0] || strcmp(address.host, "*") == 0) sprintf(player_target, "127.0.0.1:%s", address.port);
+        else strcpy(player_target, strchr(where, ' ') + 1);
+        for (int k = 0; k < num_players; k++) {
+            players[k] = fork_player(k);
+            place_player(k);
+        }
+    }
 
-            time_t current_time = time(NULL);
-            int elapsed = (int)(current_time - start_time);
-            if (elapsed >= config.game_duration) {
-                printf("\n⏰ Game duration of %d seconds reached! Game ends now with a tie.\n",
-                       config.game_duration);
-                score1 = score2;
-                break;
+    for (int i = 0; i < num_players; i++) {
+        int fd = transport_accept(listen_fd);
+        if (fd < 0 || welcome_player(i, fd) < 0) {
+            perror("Failed to welcome player");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// ##################################
+// Starts the players: one process each talking over pipes or shm, coroutines in this process,
+// or plain rows of a store that the batch kernel updates
+// ##################################
+void launch_players() {
+    if (transport == TRANSPORT_BATCH) {
+        kernel_level = tick_kernel_best();
+        init_players();
+        restore_players();
+        return;
+    }
+    if (transport == TRANSPORT_CORO) {
+        runtime = coro_runtime_create(&config, num_players, 0);
+        store = coro_runtime_store(runtime);
+        if (metrics) coro_reply_times = coro_runtime_time_replies(runtime);
+        restore_players();
+        return;
+    }
+
+    players = calloc(num_players, sizeof(pid_t));
+    request_fds = calloc(num_players, sizeof(int));
+    reply_fds = calloc(num_players, sizeof(int));
+    readers = calloc(num_players, sizeof(FrameReader));
+    config_sent = calloc(num_players, sizeof(uint32_t));
+    owed = calloc(num_players, sizeof(uint32_t));
+    received = calloc(num_players, 1);
+    restarts = calloc(num_players, sizeof(int));
+    restore_state = calloc(num_players, 1);
+    pid_fds = malloc(num_players * sizeof(int));
+    for (int k = 0; k < num_players; k++) pid_fds[k] = -1;
+
+    // Pipe players say hello once started, shm players post it, socket slots wait for a connection
+    slot_state = malloc(num_players);
+    memset(slot_state, transport == TRANSPORT_PIPE ? SLOT_JOINING : transport == TRANSPORT_SHM ? SLOT_PLAYING
+                                                                                                : SLOT_VACANT,
+           num_players);
+    if (transport == TRANSPORT_UNIX || transport == TRANSPORT_TCP) {
+        connect_players();
+        return;
+    }
+
+    shared_config = config_share(&config, &config_fd);
+    if (!shared_config) {
+        perror("Failed to share config");
+        exit(EXIT_FAILURE);
+    }
+    if (transport == TRANSPORT_SHM) {
+        setup_shared_tick();
+    } else {
+        read_pipes = calloc(num_players, sizeof(*read_pipes));
+        write_pipes = calloc(num_players, sizeof(*write_pipes));
+        init_players();
+        for (int i = 0; i < num_players; i++) open_pipes(i);
+    }
+    restore_players();
+
+    if (pool_path) lease_players();
+    else {
+        for (int i = 0; i < num_players; i++) players[i] = fork_player(i);
+    }
+    for (int i = 0; i < num_players; i++) place_player(i);
+
+    if (transport == TRANSPORT_PIPE) {
+        for (int i = 0; i < num_players; i++) close_child_pipes(i);
+    }
+}
+
+// ##################################
+// Real-time mode for the referee thread itself: its memory is locked and prefaulted, then
+// it moves to its CPU and policy, just before the first tick. Its helper threads (output,
+// metrics, coroutine workers) stay under the default scheduler.
+// ##################################
+void setup_realtime() {
+    if (realtime.lock_memory && realtime_lock_memory() < 0) {
+        perror("Failed to lock memory");
+        exit(EXIT_FAILURE);
+    }
+    if (realtime_place_referee(&realtime, config.tick_ms * 1000000L) < 0) {
+        perror("Failed to set real-time scheduling");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// ##################################
+// Sends every player the request for tick t: energy update, then effort at its position
+// ##################################
+void start_tick(uint32_t t) {
+    tick_sent_ns = metrics_now_ns();        // Also starts the reply deadline
+    if (transport == TRANSPORT_BATCH) {
+        tick_kernel_round(store, 0, num_players, &config, kernel_level);
+        tick_kernel_effort(store, 0, num_players);
+        return;
+    }
+    if (transport == TRANSPORT_CORO) {
+        coro_runtime_signal(runtime, PHASE_TICK);
+        return;
+    }
+    if (transport == TRANSPORT_SHM) {
+        protocol_shm_start(tick, t);
+        if (trace_buffer) {
+            for (int i = 0; i < num_players; i++) {
+                if (slot_state[i] == SLOT_PLAYING) trace(TRACE_REQUEST, TRACE_FLOW_START, t, trace_request_id(t, i));
             }
+        }
+        return;
+    }
 
-            if (total1 >= config.win_threshold || total2 >= config.win_threshold) {
-                break;
+    // Only players that answered their last request get this one. Over sockets a reload
+    // goes out in-band, right behind the request it applies to, and so does the state a
+    // player takes over.
+    Message msg, update, state;
+    msg.tick.tick = t;
+    update.config.config = config;
+    FrameBatch batch;
+    batch.length = 0;
+    pending_replies = 0;
+    for (int i = 0; i < num_players; i++) {
+        if (slot_state[i] != SLOT_PLAYING || owed[i]) continue;
+        int follows = 0;
+        if (transport != TRANSPORT_PIPE && config_sent[i] != config_generation) follows |= FOLLOWS_CONFIG;
+        if (restore_state[i]) follows |= FOLLOWS_STATE;
+        msg.tick.position = store->position[i];
+        msg.tick.follows = follows;
+        protocol_queue(&batch, &msg, MSG_TICK);
+        if (follows & FOLLOWS_CONFIG) protocol_queue(&batch, &update, MSG_CONFIG);
+        if (follows & FOLLOWS_STATE) {
+            state.state.energy = store->energy[i];
+            state.state.active = store->active[i];
+            state.state.recovery = store->recovery[i];
+            state.state.ticks = store->ticks[i];
+            protocol_queue(&batch, &state, MSG_STATE);
+        }
+        if (protocol_flush(request_fds[i], &batch) < 0) {
+            fprintf(stderr, "Player %d: ", i);
+            perror("Failed to send tick");
+            player_lost(i);
+            continue;
+        }
+        trace(TRACE_REQUEST, TRACE_FLOW_START, t, trace_request_id(t, i));
+        config_sent[i] = config_generation;
+        restore_state[i] = 0;
+        owed[i] = t;
+        pending_replies++;
+    }
+}
+
+// ##################################
+// Saves the match as it stands at a tick boundary; a checkpoint that cannot be synced
+// is reported and the match goes on
+// ##################################
+void save_checkpoint(int round, int round_ticks, int finished, const int* scores, int last_winner, int consecutive_wins) {
+    if (!checkpoint_path) return;
+    CheckpointProgress progress = { config, round, round_ticks, last_winner, consecutive_wins, finished,
+                                    ticks_played, clock_ticks };
+    if (checkpoint_save(&checkpoint, &progress, scores, store) < 0) perror("Failed to sync checkpoint");
+}
+
+// Returns the time between two points in microseconds
+long elapsed_us(struct timespec* from, struct timespec* to) {
+    return (to->tv_sec - from->tv_sec) * 1000000L + (to->tv_nsec - from->tv_nsec) / 1000;
+}
+
+// ##################################
+// Controls the entire game flow: requests ticks, reads replies, and decides winners
+// ##################################
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <config_file> [pipe|shm|coro|batch|unix <path>|tcp <host>:<port> [remote]] [virtual] "
+                        "[record <file>] [metrics <socket>] [output human|csv|jsonl|quiet] [pool <socket>] "
+                        "[deadline <ms>] [late last|fallen] [checkpoint <file> [resume]] [trace <file>] [realtime <spec>]\n", argv[0]);
+        return 1;
+    }
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "shm") == 0) transport = TRANSPORT_SHM;
+        else if ((strcmp(argv[i], "unix") == 0 || strcmp(argv[i], "tcp") == 0) && i + 1 < argc) {
+            if (transport_parse(argv[i], argv[i + 1], &address) < 0) {
+                fprintf(stderr, "Error: Bad %s address '%s'\n", argv[i], argv[i + 1]);
+                return 1;
             }
+            transport = address.family == TRANSPORT_FAMILY_UNIX ? TRANSPORT_UNIX : TRANSPORT_TCP;
+            i++;
+        }
+        else if (strcmp(argv[i], "remote") == 0) remote_players = 1;
+        else if (strcmp(argv[i], "pipe") == 0) transport = TRANSPORT_PIPE;
+        else if (strcmp(argv[i], "coro") == 0) transport = TRANSPORT_CORO;
+        else if (strcmp(argv[i], "batch") == 0) transport = TRANSPORT_BATCH;
+        else if (strcmp(argv[i], "virtual") == 0) virtual_clock = 1;
+        else if (strcmp(argv[i], "record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if (strcmp(argv[i], "metrics") == 0 && i + 1 < argc) metrics_path = argv[++i];
+        else if (strcmp(argv[i], "pool") == 0 && i + 1 < argc) pool_path = argv[++i];
+        else if (strcmp(argv[i], "deadline") == 0 && i + 1 < argc && atol(argv[i + 1]) > 0)
+            deadline_ms = atol(argv[++i]);
+        else if (strcmp(argv[i], "late") == 0 && i + 1 < argc && strcmp(argv[i + 1], "last") == 0) {
+            late_policy = LATE_LAST;
+            i++;
         }
+        else if (strcmp(argv[i], "late") == 0 && i + 1 < argc && strcmp(argv[i + 1], "fallen") == 0) {
+            late_policy = LATE_FALLEN;
+            i++;
+        }
+        else if (strcmp(argv[i], "checkpoint") == 0 && i + 1 < argc) checkpoint_path = argv[++i];
+        else if (strcmp(argv[i], "resume") == 0) resume = 1;
+        else if (strcmp(argv[i], "trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if (strcmp(argv[i], "realtime") == 0 && i + 1 < argc) realtime_spec = argv[++i];
+        else if (strcmp(argv[i], "output") == 0 && i + 1 < argc && output_format_parse(argv[i + 1]) >= 0)
+            output_format = output_format_parse(argv[++i]);
+        else {
+            fprintf(stderr, "Error: Unknown option '%s' (expected pipe, shm, coro, batch, unix <path>, tcp <host>:<port>, "
+                            "remote, virtual, record <file>, metrics <socket>, output human|csv|jsonl|quiet, "
+                            "pool <socket>, deadline <ms>, late last|fallen, checkpoint <file>, resume, trace <file> or realtime <spec>)\n", argv[i]);
+            return 1;
+        }
+    }
+    if (pool_path && transport != TRANSPORT_PIPE && transport != TRANSPORT_SHM) {
+        fprintf(stderr, "Error: A player pool only serves the pipe and shm transports\n");
+        return 1;
+    }
+    if (remote_players && transport != TRANSPORT_UNIX && transport != TRANSPORT_TCP) {
+        fprintf(stderr, "Error: Remote players join over unix or tcp\n");
+        return 1;
+    }
+    if (resume && !checkpoint_path) {
+        fprintf(stderr, "Error: resume goes with checkpoint <file>\n");
+        return 1;
+    }
+    if (realtime_spec) {
+        char error[256];
+        if (realtime_parse(realtime_spec, &realtime, error, sizeof(error)) < 0) {
+            fprintf(stderr, "Error: %s\n", error);
+            return 1;
+        }
+        if (realtime.policy == REALTIME_DEADLINE && virtual_clock) {
+            fprintf(stderr, "Error: realtime deadline needs the real clock, for its period\n");
+            return 1;
+        }
+    }
 
-        int team1_pos2[TEAM_SIZE], team2_pos2[TEAM_SIZE];
-        assign_positions(team1_energies, team1_pos2);
-        assign_positions(team2_energies, team2_pos2);
+    // A resumed match plays on with the settings it was saved with, reloads and seed included
+    config_path = argv[1];
+    read_config(config_path);
+    CheckpointProgress saved = { .round = 1 };
+    if (resume) {
+        if (checkpoint_open(&checkpoint, checkpoint_path) < 0) {
+            perror("Failed to open checkpoint");
+            exit(EXIT_FAILURE);
+        }
+        checkpoint_restore(&checkpoint, &saved, NULL, NULL);
+        if (saved.finished) {
+            fprintf(stderr, "Error: The match in %s is over\n", checkpoint_path);
+            return 1;
+        }
+        config = saved.config;
+        ticks_played = saved.ticks_played;
+        clock_ticks = saved.clock_tick;
+    }
+    num_players = config.team_size * config.num_teams;
+    if (config.seed == 0) config.seed = (unsigned int)(time(NULL) ^ getpid());
+    if (checkpoint_path && !resume && checkpoint_create(&checkpoint, checkpoint_path, num_players, config.num_teams) < 0) {
+        perror("Failed to create checkpoint");
+        exit(EXIT_FAILURE);
+    }
+    if (deadline_ms == 0) deadline_ms = virtual_clock ? DEFAULT_DEADLINE_MS : config.tick_ms;
+    sink = output_sink_create(output_format, stdout, &config, num_players);
+    if (!sink) {
+        perror("Failed to start output");
+        exit(EXIT_FAILURE);
+    }
 
-        for (int i = 0; i < TEAM_SIZE; i++) {
-            write(write_pipes[i][1], &team1_pos2[i], sizeof(int));
-            write(write_pipes[i + TEAM_SIZE][1], &team2_pos2[i], sizeof(int));
+    // The players and the visualizer find the trace directory in their environment
+    if (trace_path) {
+        snprintf(trace_dir, sizeof(trace_dir), "%s.%d.d", trace_path, (int)getpid());
+        if (mkdir(trace_dir, 0755) < 0 || setenv(TRACE_ENV, trace_dir, 1) < 0 || trace_start("referee") < 0) {
+            perror("Failed to start tracing");
+            exit(EXIT_FAILURE);
         }
+    }
+    // Player processes lock their own memory; pool players go by the pool's environment
+    if (realtime_spec && realtime.lock_memory) setenv(REALTIME_ENV, "lock", 1);
 
-        for (int i = 0; i < NUM_PLAYERS; i++) kill(players[i], SIGUSR2);
-        sleep(1);
+    if (record_path && recording_create(&recording, record_path, &config, num_players) < 0) {
+        perror("Failed to create recording");
+        exit(EXIT_FAILURE);
+    }
 
-        int total1_end = 0, total2_end = 0;
-        PlayerStats t1_stats_end[TEAM_SIZE], t2_stats_end[TEAM_SIZE];
-        for (int i = 0; i < TEAM_SIZE; i++) {
-            read(read_pipes[i][0], &t1_stats_end[i], sizeof(PlayerStats));
-            read(read_pipes[i + TEAM_SIZE][0], &t2_stats_end[i], sizeof(PlayerStats));
-            total1_end += t1_stats_end[i].effort;
-            total2_end += t2_stats_end[i].effort;
+    char bus_name[32];
+    sprintf(bus_name, "/rope_bus_%d", (int)getpid());
+    if (state_bus_create(&bus, bus_name, &config, num_players) < 0) {
+        perror("Failed to create state bus");
+        exit(EXIT_FAILURE);
+    }
+
+    if (metrics_path) {
+        metrics = metrics_create(metrics_path, num_players, config.num_teams, transport_names[transport]);
+        if (!metrics) {
+            perror("Failed to serve metrics");
+            exit(EXIT_FAILURE);
         }
+    }
 
-        for (int i = 0; i < TEAM_SIZE; i++) {
-            char pipe_name[50];
-            sprintf(pipe_name, "/tmp/player_pipe_%d", i);
-            int fd = open(pipe_name, O_WRONLY | O_NONBLOCK);
-            if (fd >= 0) {
-                write(fd, &t1_stats_end[i], sizeof(PlayerStats));
-                close(fd);
-            }
+    // The visualizer is skipped on the virtual clock, which runs headless. It reads the
+    // bus from the oldest snapshot still there, so it does not need to be up before the first tick.
+    if (!virtual_clock) {
+        pid_t visual_pid = fork();
+        if (visual_pid == 0) {
+            execl("./visual", "visual", bus_name, NULL);
+            perror("Failed to launch visual");
+            _exit(1);
+        }
+    }
+
+    // A player that went away must not take the referee with it
+    signal(SIGPIPE, SIG_IGN);
+    launch_players();
+    if (config_watch_start(&config_watch, config_path) < 0)
+        perror("Config changes will not be picked up (inotify)");
+    OutputStart start = { config.seed, transport_names[transport], bus_name, metrics_path,
+                          transport == TRANSPORT_BATCH ? tick_kernel_name(kernel_level) : NULL };
+    output_start(sink, &start);
+
+    // Every player sends one reply once its handlers are installed
+    setup_event_loop();
+    collect_replies(0);
+    setup_ranking();
+
+    int num_teams = config.num_teams;
+    int* scores = calloc(num_teams, sizeof(int));
+    int* totals = calloc(num_teams, sizeof(int));
+    int last_winner = saved.last_winner;
+    int consecutive_wins = saved.consecutive_wins;
+    long game_ticks = (config.game_duration * 1000L + config.tick_ms - 1) / config.tick_ms;
+    if (resume) {
+        checkpoint_restore(&checkpoint, NULL, scores, NULL);
+        fprintf(stderr, "Resumed at round %d tick %d\n", saved.round, saved.round_ticks);
+    } else {
+        save_checkpoint(saved.round, 0, 0, scores, last_winner, consecutive_wins);
+    }
+    if (realtime_spec) setup_realtime();
+    start_ticks();
+
+    for (int round = saved.round; round <= config.rounds_to_win; round++) {
+        int reached = 0, out_of_time = 0;
+        int second = 1 + (round == saved.round ? saved.round_ticks : 0);
+        long exchange_us = 0;
+        struct timespec phase_start, phase_end;
+
+        long round_start = now_ms();
+        long round_overruns = overruns;
+        long round_late = late_replies, round_restarted = restarted;
+        while (1) {
+            uint32_t t = ticks_played + 1;
+            trace(TRACE_WAIT, TRACE_BEGIN, t, 0);
+            wait_for_tick();
+            trace(TRACE_WAIT, TRACE_END, t, 0);
+            trace(TRACE_TICK, TRACE_BEGIN, t, 0);
+            second++;
+            if (config_watch.fd >= 0 && config_watch_changed(&config_watch)) reload_config();
+
+            // Rank the players by the energies of the last tick; the request hands the positions out
+            long tick_ns = metrics_now_ns();
+            trace(TRACE_RANKING, TRACE_BEGIN, t, 0);
+            update_positions();
+            send_positions();
+            trace(TRACE_RANKING, TRACE_END, t, 0);
+            metrics_phase(metrics, METRIC_PHASE_RANKING, metrics_now_ns() - tick_ns);
+
+            clock_gettime(CLOCK_MONOTONIC, &phase_start);
+            trace(TRACE_EXCHANGE, TRACE_BEGIN, t, 0);
+            start_tick(++ticks_played);
+            collect_replies(ticks_played);
+            team_totals(totals);
+            trace(TRACE_EXCHANGE, TRACE_END, t, 0);
+            clock_gettime(CLOCK_MONOTONIC, &phase_end);
+            exchange_us += elapsed_us(&phase_start, &phase_end);
+            metrics_phase(metrics, METRIC_PHASE_EXCHANGE, elapsed_us(&phase_start, &phase_end) * 1000);
+            metrics_players(metrics, store);
 
-            sprintf(pipe_name, "/tmp/player_pipe_%d", i + TEAM_SIZE);
-            fd = open(pipe_name, O_WRONLY | O_NONBLOCK);
-            if (fd >= 0) {
-                write(fd, &t2_stats_end[i], sizeof(PlayerStats));
-                close(fd);
+            trace(TRACE_PUBLISH, TRACE_BEGIN, t, 0);
+            output_tick(sink, round, second - 1, clock_ticks, store);
+            metrics_phase(metrics, METRIC_PHASE_TICK, metrics_now_ns() - tick_ns);
+            state_bus_publish(&bus, BUS_TICK, round, second - 1, 0, clock_ticks, store);
+            if (trace_buffer) trace(TRACE_SNAPSHOT, TRACE_FLOW_START, clock_ticks, atomic_load(&bus.header->head) - 1);
+            if (record_path) recording_frame(&recording, round, second - 1, clock_ticks, store);
+            trace(TRACE_PUBLISH, TRACE_END, t, 0);
+            trace(TRACE_TICK, TRACE_END, t, 0);
+
+            if (clock_ticks >= game_ticks) {
+                for (int t = 0; t < num_teams; t++) scores[t] = 0;
+                out_of_time = 1;
+                break;
             }
-        }
 
-        printf("\n=== Round %d Results ===\n", round);
-        printf("Team 1:\nPlayer | Position | Energy | Effort\n");
-        for (int i = 0; i < TEAM_SIZE; i++) {
-            char* change = " ";
-            if (t1_stats_end[i].energy < prev_energy_t1[i]) change = " 🔻";
-            else if (t1_stats_end[i].energy > prev_energy_t1[i]) change = " 🔺";
-
-            if (t1_stats_end[i].energy == 0)
-                printf("T1-P%d   |    %d     |   %3d   |  %sFALLEN%s%s\n",
-                       t1_stats_end[i].player_id, t1_stats_end[i].position,
-                       t1_stats_end[i].energy, RED, RESET, change);
-            else
-                printf("T1-P%d   |    %d     |   %3d   |  %3d%s\n",
-                       t1_stats_end[i].player_id, t1_stats_end[i].position,
-                       t1_stats_end[i].energy, t1_stats_end[i].effort, change);
-            prev_energy_t1[i] = t1_stats_end[i].energy;
+            for (int t = 0; t < num_teams; t++) {
+                if (totals[t] >= config.win_threshold) reached = 1;
+            }
+            if (reached) break;
+            save_checkpoint(round, second - 1, 0, scores, last_winner, consecutive_wins);
         }
 
-        printf("\nTeam 2:\nPlayer | Position | Energy | Effort\n");
-        for (int i = 0; i < TEAM_SIZE; i++) {
-            char* change = " ";
-            if (t2_stats_end[i].energy < prev_energy_t2[i]) change = " 🔻";
-            else if (t2_stats_end[i].energy > prev_energy_t2[i]) change = " 🔺";
-
-            if (t2_stats_end[i].energy == 0)
-                printf("T2-P%d   |    %d     |   %3d   |  %sFALLEN%s%s\n",
-                       t2_stats_end[i].player_id, t2_stats_end[i].position,
-                       t2_stats_end[i].energy, RED, RESET, change);
-            else
-                printf("T2-P%d   |    %d     |   %3d   |  %3d%s\n",
-                       t2_stats_end[i].player_id, t2_stats_end[i].position,
-                       t2_stats_end[i].energy, t2_stats_end[i].effort, change);
-            prev_energy_t2[i] = t2_stats_end[i].energy;
+        // A team wins the round with the highest total if nobody ties it and it meets the threshold
+        int winner = 0, best = -1, tied = 0;
+        for (int t = 0; t < num_teams; t++) {
+            if (totals[t] > best) { best = totals[t]; winner = t + 1; tied = 0; }
+            else if (totals[t] == best) tied = 1;
         }
+        if (tied || best < config.win_threshold) winner = 0;
 
-        printf("\n>> Team 1 Total: %d\t| Team 2 Total: %d\n", total1_end, total2_end);
-        if (total1_end >= config.win_threshold && total1_end > total2_end) {
-            printf("\U0001F3C5 Round %d Winner: Team 1\n", round);
-            score1++;
-            if (last_winner == 1) consecutive_wins++;
-            else { last_winner = 1; consecutive_wins = 1; }
-        } else if (total2_end >= config.win_threshold && total2_end > total1_end) {
-            printf("\U0001F3C5 Round %d Winner: Team 2\n", round);
-            score2++;
-            if (last_winner == 2) consecutive_wins++;
-            else { last_winner = 2; consecutive_wins = 1; }
+        if (winner) {
+            scores[winner - 1]++;
+            if (last_winner == winner) consecutive_wins++;
+            else { last_winner = winner; consecutive_wins = 1; }
         } else {
-            printf("\U0001F91D Round %d is a tie or threshold not met!\n", round);
             last_winner = 0;
             consecutive_wins = 0;
         }
+        state_bus_publish(&bus, BUS_ROUND_END, round, second - 1, winner, clock_ticks, store);
+        if (record_path) recording_round(&recording, winner);
+        metrics_round(metrics, round, winner, scores);
 
-        if (consecutive_wins >= 2) {
-            printf("\n\U0001F389 Team %d won 2 rounds in a row! Game ends early.\n", last_winner);
-            break;
-        }
+        OutputRound result = { round, second - 1, winner, out_of_time ? ROUND_END_DURATION : ROUND_END_THRESHOLD,
+                               ROUND_NEXT_CONTINUE, clock_ticks, exchange_us / (second - 1),
+                               now_ms() - round_start, overruns - round_overruns, late_replies - round_late,
+                               restarted - round_restarted };
+        if (consecutive_wins >= 2) result.next = ROUND_NEXT_TWO_IN_ROW;
+        else if (clock_ticks >= game_ticks) result.next = ROUND_NEXT_OUT_OF_TIME;
+        output_round(sink, &result, store);
+        trace(TRACE_ROUND_END, TRACE_INSTANT, round, 0);
 
-        int final_elapsed = (int)(time(NULL) - start_time);
-        if (final_elapsed >= config.game_duration) {
-            printf("\n⏰ Game duration of %d seconds reached! Game ends now with a tie.\n",
-                   config.game_duration);
-            score1 = score2;
+        if (consecutive_wins >= 2) break;
+
+        if (clock_ticks >= game_ticks) {
+            for (int t = 0; t < num_teams; t++) scores[t] = 0;
             break;
         }
 
-        printf("\n⏳ Preparing for the next round...\n");
-        sleep(3);
+        for (int t = 0; t < (ROUND_PAUSE_MS + config.tick_ms - 1) / config.tick_ms; t++)
+            wait_for_tick();
+        save_checkpoint(round + 1, 0, 0, scores, last_winner, consecutive_wins);
+    }
+
+    int final_winner = 0, best_score = -1;
+    for (int t = 0; t < num_teams; t++) {
+        if (scores[t] > best_score) { best_score = scores[t]; final_winner = t + 1; }
+        else if (scores[t] == best_score) final_winner = 0;
+    }
+    save_checkpoint(0, 0, 1, scores, last_winner, consecutive_wins);
+    output_game_over(sink, final_winner, clock_ticks);
+    state_bus_publish(&bus, BUS_GAME_OVER, 0, 0, final_winner, clock_ticks, store);
+    if (record_path) recording_close(&recording, final_winner);
+    if (checkpoint_path) checkpoint_close(&checkpoint);
+
+    if (transport == TRANSPORT_CORO) {
+        coro_runtime_destroy(runtime);
+    } else if (transport != TRANSPORT_BATCH) {
+        stop_players();
+    }
+
+    close(timer_fd);
+    close(epoll_fd);
+    if (listen_fd >= 0) transport_unlisten(listen_fd, &address);
+
+    if (transport == TRANSPORT_SHM) {
+        sem_destroy(&tick->replies);
+        munmap(tick, tick_size);
+        close(tick_fd);
+    } else if (stream_transport() || transport == TRANSPORT_BATCH) {
+        player_store_free(&local_store);
+    }
+    for (int t = 0; t < num_teams; t++) rank_index_free(&ranks[t]);
+    state_bus_close(&bus);
+    metrics_destroy(metrics);
+    output_sink_close(sink);
+    config_watch_stop(&config_watch);
+    if (shared_config) {
+        munmap(shared_config, sizeof(SharedConfig));
+        close(config_fd);
     }
 
-    printf("\n=== Game Over ===\n");
-    if (score1 > score2)
-        printf("\U0001F3C6 Final Winner: Team 1!\n");
-    else if (score2 > score1)
-        printf("\U0001F3C6 Final Winner: Team 2!\n");
-    else
-        printf("\U0001F3C1 Final Result: It's a tie!\n");
+    if (!virtual_clock) tick_jitter_print(&jitter, stderr);
 
-    for (int i = 0; i < NUM_PLAYERS; i++) {
-        kill(players[i], SIGTERM);
-        wait(NULL);
+    // The players are gone by now; whatever the visualizer records later is left out
+    if (trace_path) {
+        trace_stop();
+        if (trace_merge(trace_dir, trace_path) < 0) perror("Failed to write trace");
     }
 
     return 0;
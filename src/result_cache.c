@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "result_cache.h"
+
+uint64_t result_cache_hash(const void* key, size_t key_size) {
+    const unsigned char* bytes = key;
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t k = 0; k < key_size; k++) h = (h ^ bytes[k]) * 0x100000001b3ull;
+    return h;
+}
+
+// Path of the entry for key, and of its shard directory
+static void entry_path(const char* dir, const void* key, size_t key_size, char* path, char* shard) {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long)result_cache_hash(key, key_size));
+    snprintf(shard, PATH_MAX, "%s/%.2s", dir, name);
+    snprintf(path, PATH_MAX, "%s/%s", shard, name + 2);
+}
+
+int result_cache_open(const char* dir) {
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+    return 0;
+}
+
+// Reads exactly size bytes; 0 on success
+static int read_all(int fd, void* data, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, (char*)data + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        got += n;
+    }
+    return 0;
+}
+
+int result_cache_get(const char* dir, const void* key, size_t key_size, void* value, size_t value_size) {
+    char path[PATH_MAX], shard[PATH_MAX];
+    entry_path(dir, key, key_size, path, shard);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    // Anything but this exact key with a value of this size is a miss
+    ResultCacheHeader header;
+    char* stored = malloc(key_size);
+    int found = stored && read_all(fd, &header, sizeof(header)) == 0 && header.magic == RESULT_CACHE_MAGIC &&
+                header.version == RESULT_CACHE_VERSION && header.key_size == key_size &&
+                header.value_size == value_size && read_all(fd, stored, key_size) == 0 &&
+                memcmp(stored, key, key_size) == 0 && read_all(fd, value, value_size) == 0;
+    free(stored);
+    close(fd);
+    return found;
+}
+
+int result_cache_put(const char* dir, const void* key, size_t key_size, const void* value, size_t value_size) {
+    char path[PATH_MAX], shard[PATH_MAX], temp[PATH_MAX + 8];
+    entry_path(dir, key, key_size, path, shard);
+    if (mkdir(shard, 0755) < 0 && errno != EEXIST) return -1;
+    snprintf(temp, sizeof(temp), "%s.XXXXXX", path);
+    int fd = mkstemp(temp);
+    if (fd < 0) return -1;
+
+    ResultCacheHeader header = { RESULT_CACHE_MAGIC, RESULT_CACHE_VERSION, key_size, value_size };
+    size_t size = sizeof(header) + key_size + value_size;
+    char* data = malloc(size);
+    int result = -1;
+    if (data) {
+        memcpy(data, &header, sizeof(header));
+        memcpy(data + sizeof(header), key, key_size);
+        memcpy(data + sizeof(header) + key_size, value, value_size);
+        if (write(fd, data, size) == (ssize_t)size && rename(temp, path) == 0) result = 0;
+    } else {
+        errno = ENOMEM;
+    }
+    int saved = errno;
+    free(data);
+    close(fd);
+    if (result < 0) unlink(temp);
+    errno = saved;
+    return result;
+}
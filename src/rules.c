@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include "constants.h"
+#include "rules.h"
+
+// Widest energy range counted with a histogram; wider ranges are sorted instead
+#define MAX_COUNTED_RANGE 1024
+
+// Integer hash with full avalanche; a bijection on 32 bits
+static unsigned int rules_hash(unsigned int x) {
+    x ^= x >> 16;
+    x *= RULES_HASH_MUL1;
+    x ^= x >> 15;
+    x *= RULES_HASH_MUL2;
+    x ^= x >> 16;
+    return x;
+}
+
+// Distinct slots always get distinct keys for the same seed
+unsigned int player_key(unsigned int seed, int slot) {
+    return rules_hash(seed ^ rules_hash((unsigned int)slot + RULES_TICK_MUL));
+}
+
+// ##################################
+// Counter-based draw: no state is carried from one draw to the next. Two hash rounds,
+// the first over key and tick, the second adding the draw number. The batch kernel
+// computes the same function lane by lane.
+// ##################################
+unsigned int player_draw(unsigned int key, unsigned int tick, unsigned int draw) {
+    unsigned int x = rules_hash(key ^ (tick * RULES_TICK_MUL));
+    return rules_hash(x + draw * RULES_DRAW_MUL);
+}
+
+int draw_range(unsigned int value, int min, int max) {
+    return min + (int)(((unsigned long long)value * (unsigned int)(max - min + 1)) >> 32);
+}
+
+static int compare_ints(const void* a, const void* b) {
+    return (*(const int*)a > *(const int*)b) - (*(const int*)a < *(const int*)b);
+}
+
+// ##################################
+// Assigns sorted random energy based on ID: the weakest player pulls from position 0.
+// Counting the draws keeps this linear in the team size.
+// ##################################
+void init_player(PlayerStore* s, int i, const GameConfig* cfg, int player_id, int slot, unsigned int seed) {
+    s->effort[i] = 0;
+    s->position[i] = 0;
+    s->active[i] = 1;
+    s->recovery[i] = 0;
+
+    // Same seed and slot give the same game, whatever the clock
+    s->key[i] = player_key(seed, slot);
+    s->ticks[i] = 0;
+
+    int range = cfg->energy_max - cfg->energy_min + 1;
+    if (range <= MAX_COUNTED_RANGE) {
+        int counts[MAX_COUNTED_RANGE] = {0};
+        for (int k = 0; k < cfg->team_size; k++)
+            counts[draw_range(player_draw(s->key[i], 0, k), cfg->energy_min, cfg->energy_max) - cfg->energy_min]++;
+        int value = 0, seen = counts[0];
+        while (seen <= player_id) seen += counts[++value];
+        s->energy[i] = cfg->energy_min + value;
+    } else {
+        int* energies = malloc(cfg->team_size * sizeof(int));
+        for (int k = 0; k < cfg->team_size; k++)
+            energies[k] = draw_range(player_draw(s->key[i], 0, k), cfg->energy_min, cfg->energy_max);
+        qsort(energies, cfg->team_size, sizeof(int), compare_ints);
+        s->energy[i] = energies[player_id];
+        free(energies);
+    }
+}
+
+// ##################################
+// Reduces energy by a random amount from config, with a 5% chance to fall.
+// A fallen player recovers after a random number of ticks.
+// ##################################
+void player_round(PlayerStore* s, int i, const GameConfig* cfg) {
+    unsigned int tick = ++s->ticks[i];
+
+    if (!s->active[i]) {
+        if (s->recovery[i] == 0) {
+            s->recovery[i] = draw_range(player_draw(s->key[i], tick, 0), cfg->recovery_min, cfg->recovery_max);
+        }
+
+        if (--s->recovery[i] <= 0) {
+            int recover = draw_range(player_draw(s->key[i], tick, 1), cfg->energy_min, cfg->energy_max);
+            s->energy[i] += recover;
+            s->active[i] = 1;
+            s->recovery[i] = 0;
+        }
+    } else {
+        int dec = draw_range(player_draw(s->key[i], tick, 0), cfg->decrease_min, cfg->decrease_max);
+
+        // Skip the decrease rather than let it knock the player down
+        if (s->energy[i] - dec > 0) {
+            s->energy[i] -= dec;
+        }
+
+        int fall_chance = draw_range(player_draw(s->key[i], tick, 1), 1, 100);
+        if (fall_chance <= FALL_CHANCE) {
+            s->energy[i] = 0;
+            s->active[i] = 0;
+            s->recovery[i] = 0;
+        }
+    }
+}
+
+// Calculates effort from energy and position
+int player_effort(PlayerStore* s, int i) {
+    s->effort[i] = (s->active[i]) ? s->energy[i] * s->position[i] : 0;
+    return s->effort[i];
+}
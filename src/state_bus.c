@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "state_bus.h"
+
+// Slots and the header each start on their own cache line
+#define BUS_ALIGN 64
+
+// Every slot: its sequence word, the snapshot header, then the players
+typedef struct {
+    _Atomic uint64_t seq;       // 2s + 1 while snapshot s is written, 2s + 2 once complete
+    BusSnapshot snapshot;
+} BusSlot;
+
+static size_t round_up(size_t bytes) {
+    return (bytes + BUS_ALIGN - 1) / BUS_ALIGN * BUS_ALIGN;
+}
+
+static BusSlot* bus_slot(const StateBus* bus, uint64_t seq) {
+    char* slots = (char*)bus->header + round_up(sizeof(StateBusHeader));
+    return (BusSlot*)(slots + (seq % bus->header->slots) * bus->header->slot_size);
+}
+
+static PlayerStats* slot_players(BusSlot* slot) {
+    return (PlayerStats*)(slot + 1);
+}
+
+int state_bus_create(StateBus* bus, const char* name, const GameConfig* cfg, int num_players) {
+    memset(bus, 0, sizeof(*bus));
+    size_t slot_size = round_up(sizeof(BusSlot) + num_players * sizeof(PlayerStats));
+    bus->length = round_up(sizeof(StateBusHeader)) + STATE_BUS_SLOTS * slot_size;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, bus->length) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    bus->header = mmap(NULL, bus->length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bus->header == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+
+    bus->header->num_players = num_players;
+    bus->header->team_size = cfg->team_size;
+    bus->header->num_teams = cfg->num_teams;
+    bus->header->slots = STATE_BUS_SLOTS;
+    bus->header->slot_size = slot_size;
+    atomic_init(&bus->header->head, 0);
+    memcpy(bus->header->magic, STATE_BUS_MAGIC, sizeof(bus->header->magic));
+    bus->owner = 1;
+    snprintf(bus->name, sizeof(bus->name), "%s", name);
+    return 0;
+}
+
+int state_bus_open(StateBus* bus, const char* name) {
+    memset(bus, 0, sizeof(*bus));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(StateBusHeader)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    bus->length = st.st_size;
+    bus->header = mmap(NULL, bus->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bus->header == MAP_FAILED) return -1;
+
+    if (memcmp(bus->header->magic, STATE_BUS_MAGIC, sizeof(STATE_BUS_MAGIC)) != 0) {
+        munmap(bus->header, bus->length);
+        errno = EINVAL;
+        return -1;
+    }
+    snprintf(bus->name, sizeof(bus->name), "%s", name);
+    return 0;
+}
+
+void state_bus_close(StateBus* bus) {
+    munmap(bus->header, bus->length);
+    if (bus->owner) shm_unlink(bus->name);
+}
+
+// ##################################
+// Single publisher: mark the slot odd, fill it, mark it complete, then advance head.
+// Readers that see an odd or changed sequence word retry or skip that slot.
+// ##################################
+void state_bus_publish(StateBus* bus, int event, int round, int tick, int winner, long clock_tick,
+                       const PlayerStore* store) {
+    uint64_t seq = atomic_load_explicit(&bus->header->head, memory_order_relaxed);
+    BusSlot* slot = bus_slot(bus, seq);
+    PlayerStats* stats = slot_players(slot);
+
+    atomic_store_explicit(&slot->seq, 2 * seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->snapshot.event = event;
+    slot->snapshot.round = round;
+    slot->snapshot.tick = tick;
+    slot->snapshot.winner = winner;
+    slot->snapshot.clock_tick = clock_tick;
+    for (int i = 0; i < bus->header->num_players; i++) {
+        stats[i].player_id = i % bus->header->team_size;
+        stats[i].position = store->position[i];
+        stats[i].energy = store->energy[i];
+        stats[i].effort = store->effort[i];
+    }
+
+    atomic_store_explicit(&slot->seq, 2 * seq + 2, memory_order_release);
+    atomic_store_explicit(&bus->header->head, seq + 1, memory_order_release);
+}
+
+void bus_reader_init(BusReader* reader, StateBus* bus) {
+    uint64_t head = atomic_load_explicit(&bus->header->head, memory_order_acquire);
+    reader->bus = bus;
+    reader->next = head > (uint64_t)bus->header->slots ? head - bus->header->slots : 0;
+    reader->skipped = 0;
+}
+
+int bus_reader_next(BusReader* reader, BusSnapshot* snapshot, PlayerStats stats[]) {
+    StateBus* bus = reader->bus;
+    size_t bytes = bus->header->num_players * sizeof(PlayerStats);
+
+    while (1) {
+        uint64_t head = atomic_load_explicit(&bus->header->head, memory_order_acquire);
+        if (reader->next >= head) return 0;
+
+        // Too far behind: everything older than one ring has been overwritten
+        if (head - reader->next > (uint64_t)bus->header->slots) {
+            reader->skipped += head - bus->header->slots - reader->next;
+            reader->next = head - bus->header->slots;
+        }
+
+        BusSlot* slot = bus_slot(bus, reader->next);
+        uint64_t expected = 2 * reader->next + 2;
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) == expected) {
+            *snapshot = slot->snapshot;
+            memcpy(stats, slot_players(slot), bytes);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == expected) {
+                reader->next++;
+                return 1;
+            }
+        }
+
+        // Overwritten while we looked at it; move on to the next one
+        reader->next++;
+        reader->skipped++;
+    }
+}
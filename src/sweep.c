@@ -0,0 +1,393 @@
+#include "header.h"
+#include "constants.h"
+#include "structs.h"
+#include "config.h"
+#include "match.h"
+#include "rules.h"
+#include "result_cache.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// ##################################
+// Parameter sweep: plays many seeded matches with the referee's rules (see match.h) at
+// every point of a grid of settings, spread over all cores, and reports which points give
+// the teams even chances. Every point plays the same series of match seeds, so points are
+// compared on the same draws. Matches go in blocks, the unit of work and of caching: each
+// block's result is stored in a content-addressed cache (see result_cache.h) under its
+// settings, seeds and rules version, so sweeps that repeat or overlap earlier ones only
+// play the blocks that are new.
+// ##################################
+
+#define SWEEP_BLOCK 256             // Matches per block
+#define MAX_VALUES 4096             // Per swept setting
+#define MAX_POINTS 1000000
+#define DEFAULT_CACHE_DIR ".sweep_cache"
+
+// z for 95% confidence intervals
+#define Z95 1.959964
+
+// A swept setting: its config key (see config_set) and the values it takes
+typedef struct {
+    const char* key;
+    int* values;
+    int count;
+} Param;
+
+// Counts kept for a block of matches, then the matches won by each team; the cached value
+enum { R_MATCHES, R_TIES, R_TWO_IN_ROW, R_OUT_OF_TIME, R_ROUNDS, R_TIED_ROUNDS, R_ROUND_TICKS, R_FALLS, R_WINS };
+
+// Everything that decides a block's result
+typedef struct {
+    uint32_t rules_version;
+    uint32_t block_size;
+    int64_t block;              // Block number within the point's series of matches
+    GameConfig config;          // The point, with the seed the series starts from
+} BlockKey;
+
+GameConfig config;              // Base settings; the seed starts every point's series
+KernelLevel kernel_level;
+Param params[16];
+int num_params = 0;
+
+GameConfig* points;             // Valid grid points
+int* point_values;              // The swept values of each point, num_params per point
+int num_points = 0, invalid_points = 0;
+long blocks_per_point;
+long total_blocks;
+int result_size;                // int64_t counts per block: R_WINS + num_teams
+int64_t* results;               // Per block, point by point
+const char* cache_dir = DEFAULT_CACHE_DIR;
+atomic_long next_block;
+atomic_int cache_failed;
+
+// Per-worker match, set up again whenever the worker moves on to another point; on cache
+// lines of its own, like the tournament's workers
+typedef struct {
+    _Alignas(CACHE_LINE) Match match;
+    int point;
+    long played, cached;
+} Worker;
+
+// ##################################
+// Loads game configuration values from a file provided by the user (same format as the referee)
+// ##################################
+void read_config(const char* filename) {
+    char error[256];
+    if (config_load(filename, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// ##################################
+// Parses "key=values", where values is a comma-separated list of numbers and ranges
+// "lo:hi" or "lo:hi:step". Returns -1 if it is not one.
+// ##################################
+int parse_param(const char* text, Param* p) {
+    const char* equals = strchr(text, '=');
+    GameConfig scratch = config;
+    if (!equals || equals == text) return -1;
+    char* key = strndup(text, equals - text);
+    if (strcmp(key, "seed") == 0 || strcmp(key, "num_teams") == 0 || config_set(&scratch, key, 0) < 0) {
+        free(key);
+        return -1;
+    }
+    p->key = key;
+    p->values = malloc(MAX_VALUES * sizeof(int));
+    p->count = 0;
+
+    char* list = strdup(equals + 1);
+    char* save = NULL;
+    for (char* item = strtok_r(list, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        int lo, hi, step = 1, n;
+        char extra;
+        n = sscanf(item, "%d:%d:%d%c", &lo, &hi, &step, &extra);
+        if (n == 1) hi = lo;
+        if (n < 1 || n > 3 || step <= 0 || hi < lo) {
+            free(list);
+            return -1;
+        }
+        for (long v = lo; v <= hi; v += step) {
+            if (p->count == MAX_VALUES) {
+                free(list);
+                return -1;
+            }
+            p->values[p->count++] = (int)v;
+        }
+    }
+    free(list);
+    return p->count > 0 ? 0 : -1;
+}
+
+// ##################################
+// Lists the grid points: every combination of the swept values applied to the base
+// settings. Combinations that fail validation (say, a minimum above its maximum) are
+// counted and left out.
+// ##################################
+void build_points() {
+    long grid = 1;
+    for (int k = 0; k < num_params; k++) {
+        grid *= params[k].count;
+        if (grid > MAX_POINTS) {
+            fprintf(stderr, "Error: More than %d points to sweep\n", MAX_POINTS);
+            exit(EXIT_FAILURE);
+        }
+    }
+    points = malloc(grid * sizeof(GameConfig));
+    point_values = malloc(grid * (num_params + 1) * sizeof(int));
+    char error[256];
+    for (long g = 0; g < grid; g++) {
+        GameConfig cfg = config;
+        int* values = point_values + num_points * num_params;
+        long rest = g;
+        for (int k = num_params - 1; k >= 0; k--) {
+            values[k] = params[k].values[rest % params[k].count];
+            config_set(&cfg, params[k].key, values[k]);
+            rest /= params[k].count;
+        }
+        if (config_validate(&cfg, error, sizeof(error)) < 0) invalid_points++;
+        else points[num_points++] = cfg;
+    }
+}
+
+// ##################################
+// Plays one match and adds it to a block's counts
+// ##################################
+void play_match(Worker* w, long n, int64_t* r) {
+    Match* m = &w->match;
+    if (match_start(m, match_seed(config.seed, n)) < 0) {
+        perror("Failed to build rank index");
+        exit(EXIT_FAILURE);
+    }
+
+    int result;
+    do {
+        result = match_tick(m);
+        if (result == MATCH_PLAYING) continue;
+        r[R_ROUND_TICKS] += m->round_length;
+        if (!m->round_winner) r[R_TIED_ROUNDS]++;
+    } while (result != MATCH_GAME_OVER);
+
+    if (m->end == MATCH_END_TWO_IN_ROW) r[R_TWO_IN_ROW]++;
+    else if (m->end == MATCH_END_OUT_OF_TIME) r[R_OUT_OF_TIME]++;
+    if (m->final_winner) r[R_WINS + m->final_winner - 1]++;
+    else r[R_TIES]++;
+    r[R_MATCHES]++;
+    r[R_ROUNDS] += m->round;
+    r[R_FALLS] += m->falls;
+}
+
+// ##################################
+// Gets block b: from the cache if an earlier sweep played it, else by playing its
+// matches, after which it is cached for the next sweep
+// ##################################
+void run_block(Worker* w, long b) {
+    int p = b / blocks_per_point;
+    long block = b % blocks_per_point;
+    int64_t* r = results + b * result_size;
+    size_t size = result_size * sizeof(int64_t);
+
+    BlockKey key;
+    memset(&key, 0, sizeof(key));       // Padding is hashed too
+    key.rules_version = RULES_VERSION;
+    key.block_size = SWEEP_BLOCK;
+    key.block = block;
+    key.config = points[p];
+    if (cache_dir && result_cache_get(cache_dir, &key, sizeof(key), r, size)) {
+        w->cached++;
+        return;
+    }
+
+    if (w->point != p) {
+        if (w->point >= 0) match_free(&w->match);
+        if (match_init(&w->match, &points[p], kernel_level) < 0) {
+            perror("Failed to allocate players");
+            exit(EXIT_FAILURE);
+        }
+        w->point = p;
+    }
+    memset(r, 0, size);
+    for (long n = block * SWEEP_BLOCK; n < (block + 1) * SWEEP_BLOCK; n++) play_match(w, n, r);
+    w->played++;
+
+    if (cache_dir && result_cache_put(cache_dir, &key, sizeof(key), r, size) < 0 &&
+        atomic_exchange(&cache_failed, 1) == 0)
+        perror("Failed to write result cache");
+}
+
+// Claims blocks one at a time until none are left; blocks of a point are claimed in a row
+void* worker_main(void* arg) {
+    Worker* w = arg;
+    long b;
+    while ((b = atomic_fetch_add(&next_block, 1)) < total_blocks) run_block(w, b);
+    if (w->point >= 0) match_free(&w->match);
+    return NULL;
+}
+
+// ##################################
+// Balance report. A point is balanced when the win rates of its best and worst team are
+// within the tolerance; the interval is for that difference, as both rates come from the
+// same matches.
+// ##################################
+typedef struct {
+    int point;
+    int64_t r[R_WINS + 64];
+    double spread, half;
+} Row;
+
+int by_spread(const void* a, const void* b) {
+    const Row* x = a;
+    const Row* y = b;
+    return (x->spread > y->spread) - (x->spread < y->spread);
+}
+
+// Column width of a swept setting
+int param_width(int k) {
+    int length = strlen(params[k].key);
+    return length > 6 ? length : 6;
+}
+
+// One line of the table; balanced points are starred
+void print_point(const Row* row, double within) {
+    const int64_t* r = row->r;
+    double n = r[R_MATCHES];
+    printf("%s", row->spread <= within ? "* " : "  ");
+    for (int k = 0; k < num_params; k++)
+        printf("%*d  ", param_width(k), point_values[row->point * num_params + k]);
+    printf("%8ld", (long)r[R_MATCHES]);
+    for (int t = 0; t < config.num_teams; t++) printf("  %6.2f%%", 100 * r[R_WINS + t] / n);
+    printf("  %6.2f%%  %6.2f%%  %5.2f%%  %6.2f  %8.1f\n", 100 * r[R_TIES] / n, 100 * row->spread, 100 * row->half,
+           r[R_ROUNDS] / n, r[R_ROUNDS] ? (double)r[R_ROUND_TICKS] / r[R_ROUNDS] : 0.0);
+}
+
+void report(double within, int top, int threads, double seconds, long played, long cached) {
+    int teams = config.num_teams;
+    Row* rows = calloc(num_points, sizeof(Row));
+    int balanced = 0;
+    for (int p = 0; p < num_points; p++) {
+        Row* row = &rows[p];
+        row->point = p;
+        for (long b = 0; b < blocks_per_point; b++) {
+            const int64_t* r = results + (p * blocks_per_point + b) * result_size;
+            for (int k = 0; k < result_size; k++) row->r[k] += r[k];
+        }
+        double n = row->r[R_MATCHES], best = 0, worst = 1;
+        for (int t = 0; t < teams; t++) {
+            double rate = row->r[R_WINS + t] / n;
+            if (rate > best) best = rate;
+            if (rate < worst) worst = rate;
+        }
+        row->spread = best - worst;
+        double var = (best + worst - row->spread * row->spread) / n;
+        row->half = Z95 * sqrt(var > 0 ? var : 0);
+        balanced += row->spread <= within;
+    }
+    qsort(rows, num_points, sizeof(Row), by_spread);
+
+    printf("\nPoints: %d (%d invalid left out), %ld matches each\n", num_points, invalid_points,
+           blocks_per_point * SWEEP_BLOCK);
+    printf("Blocks: %ld of %d matches, %ld from cache, %ld played on %d threads in %.2f s (%.0f matches/s, %s kernel)\n",
+           played + cached, SWEEP_BLOCK, cached, played, threads, seconds, played * SWEEP_BLOCK / seconds,
+           tick_kernel_name(kernel_level));
+
+    printf("\n  ");
+    for (int k = 0; k < num_params; k++) printf("%*s  ", param_width(k), params[k].key);
+    printf("%8s", "matches");
+    for (int t = 0; t < teams; t++) {
+        char label[16];
+        sprintf(label, "team %d", t + 1);
+        printf("  %7s", label);
+    }
+    printf("  %7s  %7s  %6s  %6s  %8s\n", "tie", "spread", "ci95", "rounds", "ticks/rd");
+    for (int k = 0; k < num_points && k < top; k++) print_point(&rows[k], within);
+
+    printf("\nBalanced (team win rates within %.2f%%): %d of %d points%s\n", 100 * within, balanced, num_points,
+           balanced > top ? ", the closest shown" : "");
+    free(rows);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <config_file> [<key>=<values> ...] [matches <n>] [threads <n>] "
+                        "[cache <dir>|nocache] [within <percent>] [top <n>]\n", argv[0]);
+        return 1;
+    }
+
+    read_config(argv[1]);
+    long matches = 10240;
+    int threads = 0, top = 20;
+    double within = 0.01;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "matches") == 0 && i + 1 < argc) matches = atol(argv[++i]);
+        else if (strcmp(argv[i], "threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "cache") == 0 && i + 1 < argc) cache_dir = argv[++i];
+        else if (strcmp(argv[i], "nocache") == 0) cache_dir = NULL;
+        else if (strcmp(argv[i], "within") == 0 && i + 1 < argc) within = atof(argv[++i]) / 100;
+        else if (strcmp(argv[i], "top") == 0 && i + 1 < argc) top = atoi(argv[++i]);
+        else if (strchr(argv[i], '=') && num_params < (int)(sizeof(params) / sizeof(params[0])) &&
+                 parse_param(argv[i], &params[num_params]) == 0) num_params++;
+        else {
+            fprintf(stderr, "Error: Bad option '%s' (expected <key>=<values> with a key among energy_min, "
+                            "energy_max, decrease_min, decrease_max, recovery_min, recovery_max, threshold, "
+                            "duration, rounds, tick_ms and team_size, and values like 400,500 or 400:600:50; "
+                            "or matches <n>, threads <n>, cache <dir>, nocache, within <percent>, top <n>)\n",
+                    argv[i]);
+            return 1;
+        }
+    }
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (matches <= 0 || threads <= 0 || within < 0 || top <= 0) {
+        fprintf(stderr, "Error: matches, threads and top must be positive\n");
+        return 1;
+    }
+
+    // A random seed still works, but only a fixed one finds earlier results in the cache
+    kernel_level = tick_kernel_best();
+    if (config.seed == 0) config.seed = (unsigned int)(time(NULL) ^ getpid());
+    printf("Seed: %u\n", config.seed);
+    if (cache_dir && result_cache_open(cache_dir) < 0) {
+        perror("Failed to open result cache");
+        exit(EXIT_FAILURE);
+    }
+
+    build_points();
+    if (num_points == 0) {
+        fprintf(stderr, "Error: No valid point to sweep\n");
+        return 1;
+    }
+    blocks_per_point = (matches + SWEEP_BLOCK - 1) / SWEEP_BLOCK;
+    total_blocks = blocks_per_point * num_points;
+    result_size = R_WINS + config.num_teams;
+    if (config.num_teams > 64 || !(results = calloc(total_blocks, result_size * sizeof(int64_t)))) {
+        fprintf(stderr, "Error: Sweep too large\n");
+        return 1;
+    }
+    fflush(stdout);
+
+    Worker* workers = aligned_alloc(CACHE_LINE, threads * sizeof(Worker));
+    memset(workers, 0, threads * sizeof(Worker));
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    atomic_init(&next_block, 0);
+    atomic_init(&cache_failed, 0);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int k = 0; k < threads; k++) {
+        workers[k].point = -1;
+        if (pthread_create(&ids[k], NULL, worker_main, &workers[k]) != 0) {
+            perror("Failed to start worker");
+            exit(EXIT_FAILURE);
+        }
+    }
+    long played = 0, cached = 0;
+    for (int k = 0; k < threads; k++) {
+        pthread_join(ids[k], NULL);
+        played += workers[k].played;
+        cached += workers[k].cached;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    report(within, top, threads, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, played, cached);
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "constants.h"
+#include "rules.h"
+#include "tick_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNEL_X86 1
+#endif
+
+KernelLevel tick_kernel_best(void) {
+#ifdef KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return KERNEL_SSE41;
+#endif
+    return KERNEL_SCALAR;
+}
+
+const char* tick_kernel_name(KernelLevel level) {
+    switch (level) {
+        case KERNEL_AVX2: return "avx2";
+        case KERNEL_SSE41: return "sse4.1";
+        default: return "scalar";
+    }
+}
+
+// Scalar path: the rules themselves, one player at a time
+static void round_scalar(PlayerStore* s, int first, int count, const GameConfig* cfg) {
+    for (int i = first; i < first + count; i++) player_round(s, i, cfg);
+}
+
+#ifdef KERNEL_X86
+
+// ##################################
+// AVX2: 8 players per step
+// ##################################
+
+__attribute__((target("avx2")))
+static inline __m256i hash_avx2(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)RULES_HASH_MUL1));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+    x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)RULES_HASH_MUL2));
+    return _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+}
+
+// min + (value * span) >> 32 in every lane (see draw_range)
+__attribute__((target("avx2")))
+static inline __m256i range_avx2(__m256i value, __m256i min, __m256i span) {
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(value, span), 32);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), _mm256_srli_epi64(span, 32));
+    return _mm256_add_epi32(min, _mm256_blend_epi32(even, odd, 0xaa));
+}
+
+__attribute__((target("avx2")))
+static int round_avx2(PlayerStore* s, int first, int count, const GameConfig* cfg) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i tick_mul = _mm256_set1_epi32((int)RULES_TICK_MUL);
+    const __m256i second_draw = _mm256_set1_epi32((int)RULES_DRAW_MUL);
+    const __m256i dec_min = _mm256_set1_epi32(cfg->decrease_min);
+    const __m256i dec_span = _mm256_set1_epi32(cfg->decrease_max - cfg->decrease_min + 1);
+    const __m256i rec_min = _mm256_set1_epi32(cfg->recovery_min);
+    const __m256i rec_span = _mm256_set1_epi32(cfg->recovery_max - cfg->recovery_min + 1);
+    const __m256i energy_min = _mm256_set1_epi32(cfg->energy_min);
+    const __m256i energy_span = _mm256_set1_epi32(cfg->energy_max - cfg->energy_min + 1);
+    const __m256i fall_span = _mm256_set1_epi32(100);
+    const __m256i fall_chance = _mm256_set1_epi32(FALL_CHANCE);
+
+    int i = first;
+    for (; i + 8 <= first + count; i += 8) {
+        __m256i energy = _mm256_loadu_si256((__m256i*)&s->energy[i]);
+        __m256i active = _mm256_loadu_si256((__m256i*)&s->active[i]);
+        __m256i recovery = _mm256_loadu_si256((__m256i*)&s->recovery[i]);
+        __m256i key = _mm256_loadu_si256((__m256i*)&s->key[i]);
+        __m256i tick = _mm256_add_epi32(_mm256_loadu_si256((__m256i*)&s->ticks[i]), one);
+
+        // Both draws of this tick; every lane needs at most these two
+        __m256i base = hash_avx2(_mm256_xor_si256(key, _mm256_mullo_epi32(tick, tick_mul)));
+        __m256i v1 = hash_avx2(base);
+        __m256i v2 = hash_avx2(_mm256_add_epi32(base, second_draw));
+
+        __m256i fallen = _mm256_cmpeq_epi32(active, zero);
+        __m256i standing = _mm256_xor_si256(fallen, _mm256_set1_epi32(-1));
+        __m256i draw_recovery = _mm256_and_si256(fallen, _mm256_cmpeq_epi32(recovery, zero));
+
+        // First draw: the decrease (standing) or the recovery time (just fallen)
+        __m256i x1 = range_avx2(v1, _mm256_blendv_epi8(rec_min, dec_min, standing),
+                                _mm256_blendv_epi8(rec_span, dec_span, standing));
+
+        recovery = _mm256_blendv_epi8(recovery, x1, draw_recovery);
+        __m256i counted = _mm256_sub_epi32(recovery, one);
+        __m256i recovers = _mm256_andnot_si256(_mm256_cmpgt_epi32(counted, zero), fallen);
+
+        // Second draw: the fall roll (standing) or the recovered energy (recovering now)
+        __m256i x2 = range_avx2(v2, _mm256_blendv_epi8(energy_min, one, standing),
+                                _mm256_blendv_epi8(energy_span, fall_span, standing));
+
+        // Standing players: skip a decrease that would knock them down, then maybe fall
+        __m256i lowered = _mm256_sub_epi32(energy, x1);
+        __m256i pulled = _mm256_blendv_epi8(energy, lowered, _mm256_cmpgt_epi32(lowered, zero));
+        __m256i falls = _mm256_andnot_si256(_mm256_cmpgt_epi32(x2, fall_chance), standing);
+
+        // Fallen players: count down, and get energy back when the count runs out
+        __m256i restored = _mm256_blendv_epi8(energy, _mm256_add_epi32(energy, x2), recovers);
+
+        energy = _mm256_blendv_epi8(restored, pulled, standing);
+        energy = _mm256_andnot_si256(falls, energy);
+        active = _mm256_blendv_epi8(active, one, recovers);
+        active = _mm256_andnot_si256(falls, active);
+        recovery = _mm256_blendv_epi8(recovery, counted, fallen);
+        recovery = _mm256_andnot_si256(_mm256_or_si256(falls, recovers), recovery);
+
+        _mm256_storeu_si256((__m256i*)&s->energy[i], energy);
+        _mm256_storeu_si256((__m256i*)&s->active[i], active);
+        _mm256_storeu_si256((__m256i*)&s->recovery[i], recovery);
+        _mm256_storeu_si256((__m256i*)&s->ticks[i], tick);
+    }
+    return i;
+}
+
+// ##################################
+// SSE4.1: 4 players per step, same steps as the AVX2 path
+// ##################################
+
+__attribute__((target("sse4.1")))
+static inline __m128i hash_sse41(__m128i x) {
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = _mm_mullo_epi32(x, _mm_set1_epi32((int)RULES_HASH_MUL1));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = _mm_mullo_epi32(x, _mm_set1_epi32((int)RULES_HASH_MUL2));
+    return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i range_sse41(__m128i value, __m128i min, __m128i span) {
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(value, span), 32);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(value, 32), _mm_srli_epi64(span, 32));
+    return _mm_add_epi32(min, _mm_blend_epi16(even, odd, 0xcc));
+}
+
+__attribute__((target("sse4.1")))
+static int round_sse41(PlayerStore* s, int first, int count, const GameConfig* cfg) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i tick_mul = _mm_set1_epi32((int)RULES_TICK_MUL);
+    const __m128i second_draw = _mm_set1_epi32((int)RULES_DRAW_MUL);
+    const __m128i dec_min = _mm_set1_epi32(cfg->decrease_min);
+    const __m128i dec_span = _mm_set1_epi32(cfg->decrease_max - cfg->decrease_min + 1);
+    const __m128i rec_min = _mm_set1_epi32(cfg->recovery_min);
+    const __m128i rec_span = _mm_set1_epi32(cfg->recovery_max - cfg->recovery_min + 1);
+    const __m128i energy_min = _mm_set1_epi32(cfg->energy_min);
+    const __m128i energy_span = _mm_set1_epi32(cfg->energy_max - cfg->energy_min + 1);
+    const __m128i fall_span = _mm_set1_epi32(100);
+    const __m128i fall_chance = _mm_set1_epi32(FALL_CHANCE);
+
+    int i = first;
+    for (; i + 4 <= first + count; i += 4) {
+        __m128i energy = _mm_loadu_si128((__m128i*)&s->energy[i]);
+        __m128i active = _mm_loadu_si128((__m128i*)&s->active[i]);
+        __m128i recovery = _mm_loadu_si128((__m128i*)&s->recovery[i]);
+        __m128i key = _mm_loadu_si128((__m128i*)&s->key[i]);
+        __m128i tick = _mm_add_epi32(_mm_loadu_si128((__m128i*)&s->ticks[i]), one);
+
+        __m128i base = hash_sse41(_mm_xor_si128(key, _mm_mullo_epi32(tick, tick_mul)));
+        __m128i v1 = hash_sse41(base);
+        __m128i v2 = hash_sse41(_mm_add_epi32(base, second_draw));
+
+        __m128i fallen = _mm_cmpeq_epi32(active, zero);
+        __m128i standing = _mm_xor_si128(fallen, _mm_set1_epi32(-1));
+        __m128i draw_recovery = _mm_and_si128(fallen, _mm_cmpeq_epi32(recovery, zero));
+
+        __m128i x1 = range_sse41(v1, _mm_blendv_epi8(rec_min, dec_min, standing),
+                                 _mm_blendv_epi8(rec_span, dec_span, standing));
+
+        recovery = _mm_blendv_epi8(recovery, x1, draw_recovery);
+        __m128i counted = _mm_sub_epi32(recovery, one);
+        __m128i recovers = _mm_andnot_si128(_mm_cmpgt_epi32(counted, zero), fallen);
+
+        __m128i x2 = range_sse41(v2, _mm_blendv_epi8(energy_min, one, standing),
+                                 _mm_blendv_epi8(energy_span, fall_span, standing));
+
+        __m128i lowered = _mm_sub_epi32(energy, x1);
+        __m128i pulled = _mm_blendv_epi8(energy, lowered, _mm_cmpgt_epi32(lowered, zero));
+        __m128i falls = _mm_andnot_si128(_mm_cmpgt_epi32(x2, fall_chance), standing);
+
+        __m128i restored = _mm_blendv_epi8(energy, _mm_add_epi32(energy, x2), recovers);
+
+        energy = _mm_blendv_epi8(restored, pulled, standing);
+        energy = _mm_andnot_si128(falls, energy);
+        active = _mm_blendv_epi8(active, one, recovers);
+        active = _mm_andnot_si128(falls, active);
+        recovery = _mm_blendv_epi8(recovery, counted, fallen);
+        recovery = _mm_andnot_si128(_mm_or_si128(falls, recovers), recovery);
+
+        _mm_storeu_si128((__m128i*)&s->energy[i], energy);
+        _mm_storeu_si128((__m128i*)&s->active[i], active);
+        _mm_storeu_si128((__m128i*)&s->recovery[i], recovery);
+        _mm_storeu_si128((__m128i*)&s->ticks[i], tick);
+    }
+    return i;
+}
+
+#endif
+
+// ##################################
+// Runs the vector path over whole blocks and the scalar rules over the remainder
+// ##################################
+void tick_kernel_round(PlayerStore* s, int first, int count, const GameConfig* cfg, KernelLevel level) {
+    int done = first;
+#ifdef KERNEL_X86
+    if (level == KERNEL_AVX2) done = round_avx2(s, first, count, cfg);
+    else if (level == KERNEL_SSE41) done = round_sse41(s, first, count, cfg);
+#endif
+    round_scalar(s, done, first + count - done, cfg);
+}
+
+// Plain loop; the compiler vectorizes it on its own
+void tick_kernel_effort(PlayerStore* s, int first, int count) {
+    for (int i = first; i < first + count; i++)
+        s->effort[i] = s->active[i] ? s->energy[i] * s->position[i] : 0;
+}
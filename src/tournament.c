@@ -0,0 +1,247 @@
+#include "header.h"
+#include "constants.h"
+#include "structs.h"
+#include "config.h"
+#include "match.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// ##################################
+// Headless tournament: plays many independent matches with the referee's rules on the
+// virtual clock, spread over all cores, and reports how often each team wins.
+// ##################################
+
+// Matches a worker claims at a time from the shared counter
+#define MATCH_BATCH 64
+
+// z for 95% confidence intervals
+#define Z95 1.959964
+
+GameConfig config;
+int num_players;
+long game_ticks;
+KernelLevel kernel_level;
+
+long total_matches;
+atomic_long next_match;
+
+// Results one worker collects; merged once every worker is done
+typedef struct {
+    long matches;
+    long* wins;             // Final winner per team
+    long ties;
+    long* round_wins;       // Round winner per team
+    long rounds;
+    long tied_rounds;
+    long duration_ends;     // Matches stopped by the game duration
+    long early_ends;        // Matches ended by two wins in a row
+    long* round_length;     // Histogram of round lengths in ticks (0 .. game_ticks)
+    long* match_rounds;     // Histogram of rounds played per match
+    long falls;
+    double falls_sq;        // Sum of squared falls per match, for the interval
+    long player_ticks;
+} Tally;
+
+// Per-worker match, reused from one match to the next. Each worker starts on a cache line
+// of its own: its tally is written at every round end, right next to the match config the
+// next worker reads on every tick.
+typedef struct {
+    _Alignas(CACHE_LINE) Match match;
+    Tally tally;
+} Worker;
+
+// ##################################
+// Loads game configuration values from a file provided by the user (same format as the referee)
+// ##################################
+void read_config(const char* filename) {
+    char error[256];
+    if (config_load(filename, &config, error, sizeof(error)) < 0) {
+        fprintf(stderr, "Error: %s\n", error);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void worker_init(Worker* w) {
+    memset(w, 0, sizeof(*w));
+    if (match_init(&w->match, &config, kernel_level) < 0) {
+        perror("Failed to allocate players");
+        exit(EXIT_FAILURE);
+    }
+    w->tally.wins = calloc(config.num_teams, sizeof(long));
+    w->tally.round_wins = calloc(config.num_teams, sizeof(long));
+    w->tally.round_length = calloc(game_ticks + 1, sizeof(long));
+    w->tally.match_rounds = calloc(config.rounds_to_win + 1, sizeof(long));
+}
+
+// ##################################
+// Plays one match (see match.h) and adds its rounds and result to the worker's tally
+// ##################################
+void play_match(Worker* w, long match) {
+    Match* m = &w->match;
+    Tally* tally = &w->tally;
+    if (match_start(m, match_seed(config.seed, match)) < 0) {
+        perror("Failed to build rank index");
+        exit(EXIT_FAILURE);
+    }
+
+    int result;
+    do {
+        result = match_tick(m);
+        if (result == MATCH_PLAYING) continue;
+
+        tally->round_length[m->round_length]++;
+        tally->player_ticks += (long)m->round_length * num_players;
+        if (m->round_winner) tally->round_wins[m->round_winner - 1]++;
+        else tally->tied_rounds++;
+    } while (result != MATCH_GAME_OVER);
+
+    if (m->end == MATCH_END_TWO_IN_ROW) tally->early_ends++;
+    else if (m->end == MATCH_END_OUT_OF_TIME) tally->duration_ends++;
+    if (m->final_winner) tally->wins[m->final_winner - 1]++;
+    else tally->ties++;
+
+    tally->matches++;
+    tally->rounds += m->round;
+    tally->match_rounds[m->round]++;
+    tally->falls += m->falls;
+    tally->falls_sq += (double)m->falls * m->falls;
+}
+
+// Claims batches of matches until none are left
+void* worker_main(void* arg) {
+    Worker* w = arg;
+    while (1) {
+        long first = atomic_fetch_add(&next_match, MATCH_BATCH);
+        if (first >= total_matches) break;
+        long last = first + MATCH_BATCH < total_matches ? first + MATCH_BATCH : total_matches;
+        for (long m = first; m < last; m++) play_match(w, m);
+    }
+    return NULL;
+}
+
+// Adds one worker's results into another's
+void merge_tally(Tally* into, const Tally* from) {
+    into->matches += from->matches;
+    into->ties += from->ties;
+    into->rounds += from->rounds;
+    into->tied_rounds += from->tied_rounds;
+    into->duration_ends += from->duration_ends;
+    into->early_ends += from->early_ends;
+    into->falls += from->falls;
+    into->falls_sq += from->falls_sq;
+    into->player_ticks += from->player_ticks;
+    for (int t = 0; t < config.num_teams; t++) {
+        into->wins[t] += from->wins[t];
+        into->round_wins[t] += from->round_wins[t];
+    }
+    for (long k = 0; k <= game_ticks; k++) into->round_length[k] += from->round_length[k];
+    for (int k = 0; k <= config.rounds_to_win; k++) into->match_rounds[k] += from->match_rounds[k];
+}
+
+// Prints a proportion with its 95% Wilson score interval
+void print_rate(const char* label, long hits, long n) {
+    double p = (double)hits / n;
+    double denom = 1 + Z95 * Z95 / n;
+    double centre = (p + Z95 * Z95 / (2.0 * n)) / denom;
+    double half = Z95 * sqrt(p * (1 - p) / n + Z95 * Z95 / (4.0 * n * n)) / denom;
+    printf("%-16s %10ld  %6.2f%%  [%6.2f%%, %6.2f%%]\n", label, hits, 100 * p,
+           100 * (centre - half), 100 * (centre + half));
+}
+
+// Smallest round length (in ticks) that covers the given fraction of rounds
+long round_length_percentile(const Tally* tally, double fraction) {
+    long target = (long)ceil(fraction * tally->rounds), seen = 0;
+    for (long k = 0; k <= game_ticks; k++) {
+        seen += tally->round_length[k];
+        if (seen >= target && seen > 0) return k;
+    }
+    return game_ticks;
+}
+
+void report(const Tally* tally, int threads, double seconds) {
+    long n = tally->matches;
+    char label[32];
+
+    printf("\nMatches: %ld on %d threads in %.2f s (%.0f matches/s, %.0f player-ticks/s, %s kernel)\n",
+           n, threads, seconds, n / seconds, tally->player_ticks / seconds, tick_kernel_name(kernel_level));
+
+    printf("\n%-16s %10s  %7s  %s\n", "Final result", "matches", "rate", "95% interval");
+    for (int t = 0; t < config.num_teams; t++) {
+        sprintf(label, "Team %d wins", t + 1);
+        print_rate(label, tally->wins[t], n);
+    }
+    print_rate("Tie", tally->ties, n);
+    print_rate("Two in a row", tally->early_ends, n);
+    print_rate("Out of time", tally->duration_ends, n);
+
+    printf("\n%-16s %10s  %7s  %s\n", "Rounds", "rounds", "rate", "95% interval");
+    for (int t = 0; t < config.num_teams; t++) {
+        sprintf(label, "Team %d wins", t + 1);
+        print_rate(label, tally->round_wins[t], tally->rounds);
+    }
+    print_rate("No winner", tally->tied_rounds, tally->rounds);
+
+    printf("\nRounds per match:");
+    for (int k = 1; k <= config.rounds_to_win; k++)
+        printf("  %d: %.2f%%", k, 100.0 * tally->match_rounds[k] / n);
+    printf("\n");
+
+    double mean_length = 0;
+    for (long k = 0; k <= game_ticks; k++) mean_length += (double)k * tally->round_length[k];
+    mean_length /= tally->rounds;
+    printf("Round length (ticks): mean %.2f  p50 %ld  p90 %ld  p99 %ld  max %ld\n", mean_length,
+           round_length_percentile(tally, 0.50), round_length_percentile(tally, 0.90),
+           round_length_percentile(tally, 0.99), round_length_percentile(tally, 1.0));
+
+    double mean_falls = (double)tally->falls / n;
+    double var = n > 1 ? (tally->falls_sq - n * mean_falls * mean_falls) / (n - 1) : 0;
+    double half = Z95 * sqrt(var > 0 ? var / n : 0);
+    printf("Falls per match: %.3f  [%.3f, %.3f]  (%.4f per player-tick)\n", mean_falls,
+           mean_falls - half, mean_falls + half, (double)tally->falls / tally->player_ticks);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s <config_file> [matches] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    read_config(argv[1]);
+    total_matches = (argc > 2) ? atol(argv[2]) : 100000;
+    int threads = (argc > 3) ? atoi(argv[3]) : 0;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (total_matches <= 0 || threads <= 0) {
+        fprintf(stderr, "Error: matches and threads must be positive\n");
+        return 1;
+    }
+
+    num_players = config.team_size * config.num_teams;
+    game_ticks = (config.game_duration * 1000L + config.tick_ms - 1) / config.tick_ms;
+    kernel_level = tick_kernel_best();
+    if (config.seed == 0) config.seed = (unsigned int)(time(NULL) ^ getpid());
+    printf("Seed: %u\n", config.seed);
+    fflush(stdout);
+
+    Worker* workers = aligned_alloc(CACHE_LINE, threads * sizeof(Worker));
+    pthread_t* ids = malloc(threads * sizeof(pthread_t));
+    for (int k = 0; k < threads; k++) worker_init(&workers[k]);
+    atomic_init(&next_match, 0);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int k = 0; k < threads; k++) {
+        if (pthread_create(&ids[k], NULL, worker_main, &workers[k]) != 0) {
+            perror("Failed to start worker");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int k = 0; k < threads; k++) pthread_join(ids[k], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (int k = 1; k < threads; k++) merge_tally(&workers[0].tally, &workers[k].tally);
+    report(&workers[0].tally, threads,
+           (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    return 0;
+}
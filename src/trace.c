@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+TraceBuffer* trace_buffer = NULL;
+static TraceBuffer buffer;
+static __thread uint32_t thread_id;
+
+static const struct {
+    const char* name;
+    const char* category;
+    const char* arg;            // What the argument is called in the trace
+} names[TRACE_NAMES] = {
+    [TRACE_TICK]       = { "tick",             "referee", "tick" },
+    [TRACE_WAIT]       = { "wait for tick",    "referee", "tick" },
+    [TRACE_RANKING]    = { "ranking",          "referee", "tick" },
+    [TRACE_EXCHANGE]   = { "exchange",         "referee", "tick" },
+    [TRACE_REPLIES]    = { "replies complete", "referee", "tick" },
+    [TRACE_LATE]       = { "late replies",     "referee", "players" },
+    [TRACE_PUBLISH]    = { "publish",          "referee", "tick" },
+    [TRACE_ROUND_END]  = { "round end",        "referee", "round" },
+    [TRACE_REQUEST]    = { "tick request",     "request", "tick" },
+    [TRACE_PLAY]       = { "play tick",        "player",  "tick" },
+    [TRACE_REPLY_SENT] = { "reply sent",       "player",  "tick" },
+    [TRACE_SNAPSHOT]   = { "snapshot",         "bus",     "clock_tick" },
+    [TRACE_BUS_READ]   = { "read snapshots",   "visual",  "clock_tick" },
+    [TRACE_FRAME]      = { "frame",            "visual",  "clock_tick" },
+};
+
+int trace_start(const char* process) {
+    const char* dir = getenv(TRACE_ENV);
+    if (!dir || trace_buffer) return 0;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%d.trace", dir, (int)getpid());
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    size_t length = sizeof(TraceHeader) + (size_t)TRACE_CAPACITY * sizeof(TraceEvent);
+    if (fd < 0) return -1;
+    if (ftruncate(fd, length) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    void* map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    // The file is sparse: pages only get written as events come in
+    buffer.header = map;
+    buffer.events = (TraceEvent*)(buffer.header + 1);
+    buffer.length = length;
+    buffer.header->magic = TRACE_MAGIC;
+    buffer.header->version = TRACE_VERSION;
+    buffer.header->pid = getpid();
+    buffer.header->capacity = TRACE_CAPACITY;
+    snprintf(buffer.header->process, sizeof(buffer.header->process), "%s", process);
+    trace_buffer = &buffer;
+    return 0;
+}
+
+void trace_record(TraceName name, char phase, int64_t arg, uint64_t id) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (!thread_id) thread_id = syscall(SYS_gettid);
+
+    uint64_t k = atomic_fetch_add_explicit(&trace_buffer->header->count, 1, memory_order_relaxed);
+    if (k >= TRACE_CAPACITY) return;
+    TraceEvent* e = &trace_buffer->events[k];
+    e->ts = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    e->id = id;
+    e->arg = arg;
+    e->tid = thread_id;
+    e->name = name;
+    atomic_store_explicit(&e->phase, phase, memory_order_release);
+}
+
+void trace_stop(void) {
+    if (!trace_buffer) return;
+    munmap(buffer.header, buffer.length);
+    trace_buffer = NULL;
+}
+
+// ##################################
+// Merging: every buffer in the directory is mapped, the earliest event becomes time 0,
+// and the events are written out process by process. Chrome's viewer sorts them itself.
+// ##################################
+typedef struct {
+    TraceHeader* header;
+    size_t length;
+    uint64_t count;             // Events recorded, dropped ones left out
+} MappedBuffer;
+
+static int map_buffer(const char* path, MappedBuffer* b) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(TraceHeader)) {
+        close(fd);
+        return -1;
+    }
+    b->header = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (b->header == MAP_FAILED) return -1;
+    b->length = st.st_size;
+    b->count = atomic_load(&b->header->count);
+    size_t room = (b->length - sizeof(TraceHeader)) / sizeof(TraceEvent);
+    if (b->header->magic != TRACE_MAGIC || b->header->version != TRACE_VERSION) b->count = 0;
+    if (b->count > room) b->count = room;
+    return 0;
+}
+
+static void write_event(FILE* out, const TraceHeader* h, const TraceEvent* e, char phase, uint64_t base) {
+    uint64_t ts = e->ts - base;
+    fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%u",
+            names[e->name].name, names[e->name].category, phase, (unsigned long long)(ts / 1000),
+            (unsigned long long)(ts % 1000), h->pid, e->tid);
+    if (phase == TRACE_FLOW_START || phase == TRACE_FLOW_STEP || phase == TRACE_FLOW_END)
+        fprintf(out, ",\"id\":\"0x%llx\"", (unsigned long long)e->id);
+    if (phase == TRACE_FLOW_END) fprintf(out, ",\"bp\":\"e\"");
+    if (phase == TRACE_INSTANT) fprintf(out, ",\"s\":\"t\"");
+    fprintf(out, ",\"args\":{\"%s\":%lld}}", names[e->name].arg, (long long)e->arg);
+}
+
+int trace_merge(const char* dir, const char* path) {
+    DIR* d = opendir(dir);
+    if (!d) return -1;
+    int num_buffers = 0, room = 16;
+    MappedBuffer* buffers = malloc(room * sizeof(MappedBuffer));
+    char file[PATH_MAX];
+    struct dirent* entry;
+    while ((entry = readdir(d))) {
+        const char* dot = strrchr(entry->d_name, '.');
+        if (!dot || strcmp(dot, ".trace") != 0) continue;
+        snprintf(file, sizeof(file), "%s/%s", dir, entry->d_name);
+        if (num_buffers == room) buffers = realloc(buffers, (room *= 2) * sizeof(MappedBuffer));
+        if (map_buffer(file, &buffers[num_buffers]) == 0) num_buffers++;
+        unlink(file);
+    }
+    closedir(d);
+    rmdir(dir);
+
+    uint64_t base = UINT64_MAX;
+    for (int k = 0; k < num_buffers; k++) {
+        const TraceEvent* events = (const TraceEvent*)(buffers[k].header + 1);
+        for (uint64_t i = 0; i < buffers[k].count; i++) {
+            if (events[i].phase && events[i].ts < base) base = events[i].ts;
+        }
+    }
+
+    FILE* out = fopen(path, "we");
+    if (out) {
+        // The process names lead, so every event after them can start with its comma
+        fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        for (int k = 0; k < num_buffers; k++) {
+            const TraceHeader* h = buffers[k].header;
+            uint64_t dropped = atomic_load(&h->count) - buffers[k].count;
+            fprintf(out, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"",
+                    k ? "," : "", h->pid, h->process);
+            if (dropped) fprintf(out, ",\"dropped_events\":%llu", (unsigned long long)dropped);
+            fprintf(out, "}}");
+        }
+        for (int k = 0; k < num_buffers; k++) {
+            const TraceHeader* h = buffers[k].header;
+            const TraceEvent* events = (const TraceEvent*)(h + 1);
+            for (uint64_t i = 0; i < buffers[k].count; i++) {
+                char phase = atomic_load_explicit(&events[i].phase, memory_order_acquire);
+                if (phase) write_event(out, h, &events[i], phase, base);     // 0: cut off mid-write
+            }
+        }
+        fprintf(out, "\n]}\n");
+    }
+    int saved = errno;
+    int result = out && fclose(out) == 0 ? 0 : -1;
+    if (result < 0 && out) saved = errno;
+
+    for (int k = 0; k < num_buffers; k++) munmap(buffers[k].header, buffers[k].length);
+    free(buffers);
+    errno = saved;
+    return result;
+}
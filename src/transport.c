@@ -0,0 +1,153 @@
+#include "header.h"
+#include "transport.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+int transport_parse(const char* family, const char* text, TransportAddress* address) {
+    memset(address, 0, sizeof(*address));
+    if (strcmp(family, "unix") == 0) {
+        address->family = TRANSPORT_FAMILY_UNIX;
+        if (!*text || strlen(text) >= sizeof(address->path)) {
+            errno = EINVAL;
+            return -1;
+        }
+        strcpy(address->path, text);
+        return 0;
+    }
+
+    // tcp: the port follows the last colon, so "[::1]:7000" and "host:7000" both work
+    const char* colon = strrchr(text, ':');
+    if (strcmp(family, "tcp") != 0 || !colon || !colon[1] || (size_t)(colon - text) >= sizeof(address->host) ||
+        strlen(colon + 1) >= sizeof(address->port)) {
+        errno = EINVAL;
+        return -1;
+    }
+    address->family = TRANSPORT_FAMILY_TCP;
+    const char* host = text;
+    size_t length = colon - text;
+    if (length >= 2 && host[0] == '[' && host[length - 1] == ']') {
+        host++;
+        length -= 2;
+    }
+    memcpy(address->host, host, length);
+    address->host[length] = '\0';
+    strcpy(address->port, colon + 1);
+    return 0;
+}
+
+// Small frames go out as soon as they are written
+static void set_nodelay(int fd, const TransportAddress* address) {
+    int on = 1;
+    if (address->family == TRANSPORT_FAMILY_TCP) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static struct addrinfo* resolve(const TransportAddress* address, int passive) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    if (passive) hints.ai_flags = AI_PASSIVE;
+    const char* host = address->host;
+    if (passive && (!*host || strcmp(host, "*") == 0)) host = NULL;
+
+    struct addrinfo* list = NULL;
+    int error = getaddrinfo(host, address->port, &hints, &list);
+    if (error != 0) {
+        errno = error == EAI_SYSTEM ? errno : EHOSTUNREACH;
+        return NULL;
+    }
+    return list;
+}
+
+int transport_listen(const TransportAddress* address) {
+    if (address->family == TRANSPORT_FAMILY_UNIX) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        strcpy(addr.sun_path, address->path);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(address->path);
+        if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 128) < 0) {
+            int saved = errno;
+            if (fd >= 0) close(fd);
+            errno = saved;
+            return -1;
+        }
+        return fd;
+    }
+
+    struct addrinfo* list = resolve(address, 1);
+    if (!list) return -1;
+    int fd = -1;
+    for (struct addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, 128) < 0) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    return fd;
+}
+
+int transport_accept(int listen_fd) {
+    int fd;
+    while ((fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC)) < 0 && errno == EINTR);
+    if (fd < 0) return -1;
+
+    // The listening socket's family decides whether there is a Nagle delay to turn off
+    struct sockaddr_storage local;
+    socklen_t length = sizeof(local);
+    if (getsockname(fd, (struct sockaddr*)&local, &length) == 0 && local.ss_family != AF_UNIX) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+int transport_connect(const TransportAddress* address) {
+    if (address->family == TRANSPORT_FAMILY_UNIX) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        strcpy(addr.sun_path, address->path);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        return fd;
+    }
+
+    struct addrinfo* list = resolve(address, 0);
+    if (!list) return -1;
+    int fd = -1;
+    for (struct addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    if (fd >= 0) set_nodelay(fd, address);
+    return fd;
+}
+
+void transport_unlisten(int listen_fd, const TransportAddress* address) {
+    close(listen_fd);
+    if (address->family == TRANSPORT_FAMILY_UNIX) unlink(address->path);
+}
+
+void transport_format(const TransportAddress* address, char* text, int size) {
+    if (address->family == TRANSPORT_FAMILY_UNIX) snprintf(text, size, "unix %s", address->path);
+    else if (strchr(address->host, ':')) snprintf(text, size, "tcp [%s]:%s", address->host, address->port);
+    else snprintf(text, size, "tcp %s:%s", address->host, address->port);
+}
@@ -1,62 +1,135 @@
+#define GL_GLEXT_PROTOTYPES // Vertex buffer objects
 #include <GL/glut.h>
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
-#include <fcntl.h>
+#include <time.h>
 #include "structs.h"
+#include "player_store.h"
+#include "recording.h"
+#include "state_bus.h"
+#include "trace.h"
 // Global variables for game state
 float rope_offset = 0.0f; // Offset for the rope position
 int team1_score = 0; // Score for Team 1
 int team2_score = 0; // Score for Team 2
 int current_round = 1; // Current round number
+int current_clock = 0; // Clock tick of the last snapshot taken in (for tracing)
 int round_winner = 0; // Winner of the current round (0 = tie, 1 = Team 1, 2 = Team 2)
 int game_over = 0; // Flag to indicate if the game is over
 int final_winner = 0; // Final winner of the game (0 = tie, 1 = Team 1, 2 = Team 2)
-int consecutive_wins = 0; // Tracks consecutive wins by a team
 
-int team1_effort = 0; // Total effort of Team 1
-int team2_effort = 0; // Total effort of Team 2
-int player_energy[8] = {0}; // Energy values for each player
-int player_positions[8] = {0}; // Positions for each player
+int team_size = DEFAULT_TEAM_SIZE; // Players per team (from the referee)
+int num_teams = DEFAULT_NUM_TEAMS; // Number of teams (from the referee)
+int num_players; // team_size * num_teams
+PlayerStore store; // Energy and position of every player
 
-// Player positions (x-coordinates for Team 1 and Team 2)
-float team1_x[4], team2_x[4];
+int team1_effort = 0; // Total effort of the left side (odd-numbered teams)
+int team2_effort = 0; // Total effort of the right side (even-numbered teams)
 
+// Player x-coordinates within a team, and the spacing between players
+float* player_x;
+float player_spacing = 80;
 
-float team_y[2] = {150, 150}; // Y-coordinate for both teams
+float team_y = 150; // Y-coordinate of the first pair of teams
+float lane_height = 120; // Extra height for every further pair of teams
 
 int flash_toggle = 0; // Toggle for flashing effect when the game ends
 int flash_count = 0; // Counter for flashing effect
 
 // Function prototypes (declarations)
 void flash_timer(int value);
-void next_round(int value);
-void read_player_data();
 
-// File descriptors for pipes
-int player_read_pipes[8];
+// Live mode: snapshots published by the referee, polled without blocking
+#define BUS_POLL_MS 16
+StateBus bus;
+BusReader bus_reader;
+PlayerStats* bus_stats;
+
+// Replay mode: plays a recording instead of reading the live pipes
+int replaying = 0;
+Replay replay;
+int replay_pos = 0; // Next frame to show
+float replay_speed = 1.0f; // 2 = twice as fast as the match was played
+int replay_paused = 0;
+
+// ##################################
+// Retained renderer: the scene (ground, rope, every player) is kept in two vertex buffers,
+// one for triangles and one for lines, and only rebuilt when the game state changes. Each
+// frame is then two draw calls whatever the team size. Text goes through one display list
+// per glyph, so a string is a single glCallLists.
+// ##################################
+#define HEAD_SEGMENTS 16
+#define HEAD_VERTICES (HEAD_SEGMENTS * 3)
+#define BODY_VERTICES 10
+#define GROUND_VERTICES 6
+#define ROPE_VERTICES 2
+
+typedef struct {
+    float x, y;
+    GLubyte r, g, b, a;
+} Vertex;
+
+float head_circle[HEAD_SEGMENTS + 1][2]; // Unit circle, computed once
+Vertex* triangles;
+Vertex* lines;
+int num_triangles, num_lines; // Vertices in each buffer
+GLuint triangle_buffer, line_buffer;
+int scene_dirty = 1; // Set whenever the state behind the buffers changes
+
+// Glyph cache: one display list and the width of every character of the font
+GLuint glyph_lists;
+int glyph_width[256];
+
+// Labels above each player, rebuilt only when the values they show change
+typedef struct {
+    int energy, position;
+    int energy_len, position_len;
+    float energy_width, position_width;
+    char energy_text[20], position_text[20];
+} PlayerLabel;
+PlayerLabel* labels;
+
+// Width of a string in the cached font; also returns its length
+float text_width(const char* str, int* len) {
+    float width = 0;
+    int n = 0;
+    for (; str[n]; n++) width += glyph_width[(unsigned char)str[n]];
+    *len = n;
+    return width;
+}
+
+// Draws a string of known length starting at (x, y)
+void draw_text_run(float x, float y, const char* str, int len) {
+    glColor3f(0, 0, 0);
+    glRasterPos2f(x, y);
+    glListBase(glyph_lists);
+    glCallLists(len, GL_UNSIGNED_BYTE, str);
+}
 
 // Function to draw centered text
 void draw_centered_text(float x, float y, const char* str) {
-    void* font = GLUT_BITMAP_HELVETICA_18;
-    float width = 0;
-    for (int i = 0; i < strlen(str); i++)
-        width += glutBitmapWidth(font, str[i]);
-    glColor3f(0, 0, 0);
-    glRasterPos2f(x - width / 2, y);
-    for (int i = 0; i < strlen(str); i++)
-        glutBitmapCharacter(font, str[i]);
+    int len;
+    float width = text_width(str, &len);
+    draw_text_run(x - width / 2, y, str, len);
 }
 
-// Function to update the display based on current game state
-void update_display() {
+// Adds up the pull of each side: even team indices pull left, odd ones right
+void sum_efforts() {
     team1_effort = team2_effort = 0;
-    for (int i = 0; i < 4; i++) {
-        team1_effort += player_energy[i]; // Calculate total effort for Team 1
-        team2_effort += player_energy[i + 4]; // Calculate total effort for Team 2
+    for (int i = 0; i < num_players; i++) {
+        if ((i / team_size) % 2 == 0) team1_effort += store.energy[i];
+        else team2_effort += store.energy[i];
     }
+}
+
+// Function to update the display based on current game state
+void update_display() {
+    sum_efforts();
+    scene_dirty = 1;
     glutPostRedisplay(); // Trigger redrawing
 }
 
@@ -65,6 +138,7 @@ void move_rope() {
     rope_offset += (team1_effort - team2_effort) / 100.0f;
     if (rope_offset > 200) rope_offset = 200; // Limit maximum offset
     if (rope_offset < -200) rope_offset = -200; // Limit minimum offset
+    scene_dirty = 1;
     glutPostRedisplay(); // Trigger redrawing
 }
 
@@ -86,144 +160,245 @@ void flash_timer(int value) {
         glutTimerFunc(200, flash_timer, 0);
 }
 
-// Simulate a new round by reading real data from pipes
-void simulate_round(int value) {
-    read_player_data(); // Read player data from pipes
-    update_display(); // Update display with new data
-    glutTimerFunc(3000, next_round, 0); // Process the round result after 1 second
+// Counts a round result for its side and moves the rope
+void apply_round_result(int winner) {
+    round_winner = winner;
+    if (winner) {
+        if ((winner - 1) % 2 == 0) team1_score++;
+        else team2_score++;
+    }
+    move_rope();
 }
 
-// Function to process the result of the current round
-void next_round(int value) {
-    team1_effort = team2_effort = 0;
-    for (int i = 0; i < 4; i++) {
-        team1_effort += player_energy[i]; // Calculate total effort for Team 1
-        team2_effort += player_energy[i + 4]; // Calculate total effort for Team 2
+// ##################################
+// Live mode: drains every snapshot published since the last poll, so round results and
+// the end of the game are never missed. A slow frame never holds up the referee.
+// ##################################
+void bus_timer(int value) {
+    BusSnapshot snapshot;
+    trace(TRACE_BUS_READ, TRACE_BEGIN, current_clock, 0);
+    while (!game_over && bus_reader_next(&bus_reader, &snapshot, bus_stats)) {
+        trace(TRACE_SNAPSHOT, TRACE_FLOW_END, snapshot.clock_tick, bus_reader.next - 1);
+        current_clock = snapshot.clock_tick;
+        if (snapshot.event == BUS_GAME_OVER) {
+            end_game(snapshot.winner);
+            break;
+        }
+        for (int i = 0; i < num_players; i++) {
+            store.energy[i] = bus_stats[i].energy;
+            store.position[i] = bus_stats[i].position;
+        }
+        current_round = snapshot.round;
+        update_display();
+        if (snapshot.event == BUS_ROUND_END) apply_round_result(snapshot.winner);
+    }
+    trace(TRACE_BUS_READ, TRACE_END, current_clock, 0);
+    if (!game_over) glutTimerFunc(BUS_POLL_MS, bus_timer, 0);
+}
+
+// ##################################
+// Replay: shows one recorded tick per timer call, scaled by the replay speed. Round
+// results come from the recording's round index, so the rope and scores match the match.
+// ##################################
+
+// Milliseconds of match time scaled to the replay speed
+int replay_delay(int ms) {
+    int delay = (int)(ms / replay_speed);
+    return delay > 0 ? delay : 1;
+}
+
+// Copies a recorded tick into the store
+void show_frame(int k) {
+    const RecordFrame* frame = replay_frame(&replay, k);
+    const PlayerStats* stats = replay_players(frame);
+    for (int i = 0; i < num_players; i++) {
+        store.energy[i] = stats[i].energy;
+        store.position[i] = stats[i].position;
     }
+    current_round = frame->round;
+}
 
-    // Determine the winner of the round
-    if (team1_effort > team2_effort) {
-        round_winner = 1; // Team 1 wins the round
-        team1_score++;
-    } else if (team2_effort > team1_effort) {
-        round_winner = 2; // Team 2 wins the round
-        team2_score++;
-    } else {
-        round_winner = 0; // Tie
+// Scores and rope as they were before round r
+void rewind_to_round(int r) {
+    team1_score = team2_score = 0;
+    round_winner = 0;
+    rope_offset = 0;
+    for (int k = 1; k < r; k++) {
+        int winner = replay_round(&replay, k)->winner;
+        if (winner) {
+            if ((winner - 1) % 2 == 0) team1_score++;
+            else team2_score++;
+        }
+        round_winner = winner;
     }
+    replay_pos = replay_round(&replay, r)->first_frame;
+}
 
-    // Check for consecutive wins
-    if (round_winner == 1 || round_winner == 2) {
-        consecutive_wins++;
-    } else {
-        consecutive_wins = 0;
+void replay_timer(int value) {
+    if (game_over) return;
+    if (replay_paused) {
+        glutTimerFunc(100, replay_timer, 0);
+        return;
     }
 
-    // Move the rope based on the round result
-    move_rope();
+    show_frame(replay_pos++);
+    update_display();
 
-    // Check if the game should end
-    if (consecutive_wins >= 2 || current_round >= 4) {
-        final_winner = (team1_score > team2_score) ? 1 : (team2_score > team1_score) ? 2 : 0;
-        end_game(final_winner);
-    } else {
-        current_round++; // Move to the next round
-        glutTimerFunc(2000, simulate_round, 0); // Start a new round after 2 seconds
+    // Last tick of a round: apply its result, then pause as the referee did
+    int round_ends = replay_pos >= replay.num_frames ||
+                     replay_frame(&replay, replay_pos)->round != current_round;
+    if (round_ends && current_round <= replay.num_rounds)
+        apply_round_result(replay_round(&replay, current_round)->winner);
+
+    if (replay_pos >= replay.num_frames) {
+        end_game(replay.header->final_winner);
+        return;
     }
+    glutTimerFunc(replay_delay(round_ends ? ROUND_PAUSE_MS : replay.header->config.tick_ms), replay_timer, 0);
 }
 
-// Function to read player data from pipes
-void read_player_data() {
-    for (int i = 0; i < 8; i++) {
-        PlayerStats stats;
-        read(player_read_pipes[i], &stats, sizeof(PlayerStats));
-        player_energy[i] = stats.energy;
-        player_positions[i] = stats.position;
+// Space pauses, + and - change the speed, n and p jump to the next or previous round
+void replay_keys(unsigned char key, int x, int y) {
+    if (key == ' ') replay_paused = !replay_paused;
+    else if (key == '+') replay_speed *= 2;
+    else if (key == '-') replay_speed /= 2;
+    else if ((key == 'n' || key == 'p') && replay.num_rounds > 0 && !game_over) {
+        int r = replay_frame(&replay, replay_pos > 0 ? replay_pos - 1 : 0)->round + (key == 'n' ? 1 : -1);
+        if (r >= 1 && r <= replay.num_rounds) {
+            rewind_to_round(r);
+            show_frame(replay_pos);
+            update_display();
+        }
     }
 }
 
-// Function to draw a stickman player
-void draw_stickman_player(float x, float y, int energy, int position, int team) {
-    if (energy == 0) {
-        glColor3f(0.5, 0.5, 0.5); // Gray color for fallen players
-    } else if (team == 1) {
-        glColor3f(0.2, 0.4, 1.0); // Blue for Team 1
-    } else {
-        glColor3f(1.0, 0.3, 0.3); // Red for Team 2
+// Appends a vertex to a buffer being built
+static inline Vertex* put_vertex(Vertex* v, float x, float y, const GLubyte color[3]) {
+    v->x = x;
+    v->y = y;
+    v->r = color[0];
+    v->g = color[1];
+    v->b = color[2];
+    v->a = 255;
+    return v + 1;
+}
+
+// Function to draw a stickman player: a filled head and five lines, written into the batches
+void build_stickman_player(Vertex** tri, Vertex** line, float x, float y, int energy, int team) {
+    static const GLubyte fallen[3] = { 128, 128, 128 }; // Gray color for fallen players
+    static const GLubyte blue[3] = { 51, 102, 255 };     // Blue for Team 1
+    static const GLubyte red[3] = { 255, 77, 77 };       // Red for Team 2
+    const GLubyte* color = energy == 0 ? fallen : team == 1 ? blue : red;
+
+    Vertex* t = *tri;
+    for (int k = 0; k < HEAD_SEGMENTS; k++) {
+        t = put_vertex(t, x, y + 30, color);
+        t = put_vertex(t, x + 10 * head_circle[k][0], y + 30 + 10 * head_circle[k][1], color);
+        t = put_vertex(t, x + 10 * head_circle[k + 1][0], y + 30 + 10 * head_circle[k + 1][1], color);
     }
+    *tri = t;
+
+    Vertex* l = *line;
+    l = put_vertex(l, x, y + 20, color); l = put_vertex(l, x, y - 20, color);          // Body
+    l = put_vertex(l, x, y + 10, color); l = put_vertex(l, x - 15, y, color);          // Left arm
+    l = put_vertex(l, x, y + 10, color); l = put_vertex(l, x + 15, y, color);          // Right arm
+    l = put_vertex(l, x, y - 20, color); l = put_vertex(l, x - 10, y - 40, color);     // Left leg
+    l = put_vertex(l, x, y - 20, color); l = put_vertex(l, x + 10, y - 40, color);     // Right leg
+    *line = l;
+}
 
-    glBegin(GL_POLYGON);
-    for (int i = 0; i < 100; i++) {
-        float theta = 2.0f * M_PI * i / 100;
-        glVertex2f(x + 10 * cos(theta), y + 30 + 10 * sin(theta));
+// Refreshes a player's label strings if the values changed since they were built
+void update_label(int i) {
+    PlayerLabel* label = &labels[i];
+    if (label->energy != store.energy[i]) {
+        label->energy = store.energy[i];
+        sprintf(label->energy_text, "Energy: %d", label->energy);
+        label->energy_width = text_width(label->energy_text, &label->energy_len);
+    }
+    if (label->position != store.position[i]) {
+        label->position = store.position[i];
+        sprintf(label->position_text, "Pos: %d", label->position);
+        label->position_width = text_width(label->position_text, &label->position_len);
     }
-    glEnd();
-
-    glBegin(GL_LINES);
-        glVertex2f(x, y + 20); glVertex2f(x, y - 20); // Body
-        glVertex2f(x, y + 10); glVertex2f(x - 15, y); // Left arm
-        glVertex2f(x, y + 10); glVertex2f(x + 15, y); // Right arm
-        glVertex2f(x, y - 20); glVertex2f(x - 10, y - 40); // Left leg
-        glVertex2f(x, y - 20); glVertex2f(x + 10, y - 40); // Right leg
-    glEnd();
-
-    char str[20];
-    sprintf(str, "Pos: %d", position); // Display position value
-    draw_centered_text(x, y + 70, str);
-
-    sprintf(str, "Energy: %d", energy); // Display energy value above the player
-    draw_centered_text(x, y + 50, str);
 }
 
-// Function to draw the rope
-void draw_rope() {
-    glColor3f(0.5f, 0.3f, 0.1f); // Brown color for the rope
-    glBegin(GL_LINES);
-        glVertex2f(200 + rope_offset, 140); // Start of the rope (left side)
-        glVertex2f(1000 + rope_offset, 140); // End of the rope (right side)
-    glEnd();
+// X and y of a player: even team indices on the left, odd ones on the right, one lane per pair
+void player_origin(int i, float* x, float* y) {
+    int team = i / team_size;
+    *x = player_x[i % team_size] + (team % 2 ? 400 : 0) + rope_offset / 2;
+    *y = team_y + (team / 2) * lane_height;
 }
 
-// Function to draw the ground
-void draw_ground() {
-    glColor3f(0.8f, 0.8f, 0.8f); // Gray color for the ground
-    glBegin(GL_POLYGON);
-        glVertex2f(0, 110); glVertex2f(1000, 110); // Top edge
-        glVertex2f(1000, 100); glVertex2f(0, 100); // Bottom edge
-    glEnd();
+// ##################################
+// Rebuilds both vertex buffers from the current state and uploads them
+// ##################################
+void build_scene() {
+    static const GLubyte ground[3] = { 204, 204, 204 }; // Gray color for the ground
+    static const GLubyte rope[3] = { 128, 77, 26 };     // Brown color for the rope
+    Vertex* tri = triangles;
+    Vertex* line = lines;
+
+    tri = put_vertex(tri, 0, 110, ground); tri = put_vertex(tri, 1000, 110, ground);
+    tri = put_vertex(tri, 1000, 100, ground); tri = put_vertex(tri, 0, 110, ground);
+    tri = put_vertex(tri, 1000, 100, ground); tri = put_vertex(tri, 0, 100, ground);
+
+    line = put_vertex(line, 200 + rope_offset, 140, rope); // Start of the rope (left side)
+    line = put_vertex(line, 1000 + rope_offset, 140, rope); // End of the rope (right side)
+
+    for (int i = 0; i < num_players; i++) {
+        float x, y;
+        player_origin(i, &x, &y);
+        build_stickman_player(&tri, &line, x, y, store.energy[i], (i / team_size) % 2 + 1);
+        if (player_spacing >= 60) update_label(i);
+    }
+
+    num_triangles = tri - triangles;
+    num_lines = line - lines;
+    glBindBuffer(GL_ARRAY_BUFFER, triangle_buffer);
+    glBufferData(GL_ARRAY_BUFFER, num_triangles * sizeof(Vertex), triangles, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, line_buffer);
+    glBufferData(GL_ARRAY_BUFFER, num_lines * sizeof(Vertex), lines, GL_STREAM_DRAW);
+    scene_dirty = 0;
 }
 
-// Main display function
-void display() {
+void draw_buffer(GLuint buffer, GLenum mode, int count) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), (void*)offsetof(Vertex, r));
+    glDrawArrays(mode, 0, count);
+}
+
+// Draws the frame into the back buffer
+void render_frame() {
     glClear(GL_COLOR_BUFFER_BIT); // Clear the screen
-    draw_ground(); // Draw the ground
 
     if (game_over) {
         // Flashing effect when the game is over
         glColor3f(flash_toggle ? 1.0f : 0.6f, 1.0f, flash_toggle ? 0.6f : 0.6f);
-        glBegin(GL_POLYGON);
-            glVertex2f(0, 0); glVertex2f(500, 0); glVertex2f(500, 700); glVertex2f(0, 700);
-        glEnd();
-
+        glRectf(0, 0, 500, 700);
         glColor3f(1.0f, flash_toggle ? 0.8f : 0.6f, flash_toggle ? 0.8f : 0.6f);
-        glBegin(GL_POLYGON);
-            glVertex2f(500, 0); glVertex2f(1000, 0); glVertex2f(1000, 700); glVertex2f(500, 700);
-        glEnd();
+        glRectf(500, 0, 1000, 700);
 
         // Display win/lose messages
-        const char* win_text = (final_winner == 1) ? "Team 1 WINS!" : (final_winner == 2) ? "Team 2 WINS!" : "It's a TIE!";
-        const char* lose_text = (final_winner == 1) ? "Team 2 LOSES" : (final_winner == 2) ? "Team 1 LOSES" : "Both TIED";
+        char win_text[32], lose_text[32];
+        if (final_winner) sprintf(win_text, "Team %d WINS!", final_winner);
+        else strcpy(win_text, "It's a TIE!");
+        if (!final_winner) strcpy(lose_text, "Both TIED");
+        else if (num_teams == 2) sprintf(lose_text, "Team %d LOSES", 3 - final_winner);
+        else strcpy(lose_text, "Other teams LOSE");
         draw_centered_text(250, 350, win_text);
         draw_centered_text(750, 350, lose_text);
-        glFlush();
         return;
     }
 
+    if (scene_dirty) build_scene();
+
     // Display game information
     char buffer[100];
     sprintf(buffer, "Round: %d", current_round);
     draw_centered_text(500, 650, buffer);
-    sprintf(buffer, "Winner: %s", round_winner == 1 ? "Team 1" : round_winner == 2 ? "Team 2" : "---");
+    if (round_winner) sprintf(buffer, "Winner: Team %d", round_winner);
+    else strcpy(buffer, "Winner: ---");
     draw_centered_text(500, 620, buffer);
     sprintf(buffer, "Score – Team 1: %d | Team 2: %d", team1_score, team2_score);
     draw_centered_text(500, 590, buffer);
@@ -233,57 +408,181 @@ void display() {
     sprintf(buffer, "Team 2 Effort: %d", team2_effort);
     draw_centered_text(750, 550, buffer);
 
-    draw_rope(); // Draw the rope
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    draw_buffer(triangle_buffer, GL_TRIANGLES, num_triangles);
+    draw_buffer(line_buffer, GL_LINES, num_lines);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Labels only fit while the players are spread out
+    if (player_spacing < 60) return;
+    for (int i = 0; i < num_players; i++) {
+        PlayerLabel* label = &labels[i];
+        float x, y;
+        player_origin(i, &x, &y);
+        draw_text_run(x - label->position_width / 2, y + 70, label->position_text, label->position_len);
+        draw_text_run(x - label->energy_width / 2, y + 50, label->energy_text, label->energy_len);
+    }
+}
+
+// Main display function
+void display() {
+    trace(TRACE_FRAME, TRACE_BEGIN, current_clock, 0);
+    render_frame();
+    glutSwapBuffers();
+    trace(TRACE_FRAME, TRACE_END, current_clock, 0);
+}
 
-    // Draw players for Team 1
-    for (int i = 0; i < 4; i++) {
-        draw_stickman_player(team1_x[i] + rope_offset / 2, team_y[0], player_energy[i], player_positions[i], 1);
+// Sets up the per-team layout and the buffers for team_size * num_teams players
+void layout_players(int new_team_size, int new_num_teams) {
+    team_size = new_team_size;
+    num_teams = new_num_teams;
+    num_players = team_size * num_teams;
+    player_store_free(&store);
+    if (team_size <= 0 || num_teams <= 0 || player_store_init(&store, num_players) < 0) {
+        fprintf(stderr, "Error: Invalid team layout\n");
+        exit(EXIT_FAILURE);
     }
 
-    // Draw players for Team 2
-    for (int i = 0; i < 4; i++) {
-        draw_stickman_player(team2_x[i] + rope_offset / 2, team_y[1], player_energy[i + 4], player_positions[i + 4], 2);
+    // Spread each team over 240 pixels, 80 apart at most
+    player_spacing = 80;
+    if (team_size > 1 && 240.0f / (team_size - 1) < player_spacing)
+        player_spacing = 240.0f / (team_size - 1);
+    free(player_x);
+    player_x = malloc(team_size * sizeof(float));
+    for (int i = 0; i < team_size; i++) {
+        player_x[i] = 300 + i * player_spacing; // جرّب قيم أكبر للمباعدة
     }
 
-    glFlush(); // Render everything
+    free(triangles);
+    free(lines);
+    free(labels);
+    triangles = malloc((GROUND_VERTICES + num_players * HEAD_VERTICES) * sizeof(Vertex));
+    lines = malloc((ROPE_VERTICES + num_players * BODY_VERTICES) * sizeof(Vertex));
+    labels = malloc(num_players * sizeof(PlayerLabel));
+    for (int i = 0; i < num_players; i++) labels[i].energy = labels[i].position = -1;
+    scene_dirty = 1;
 }
 
-// Main function
-int main(int argc, char** argv) {
-    for (int i = 0; i < 4; i++) {
-        team1_x[i] = 300 + i * 80; // جرّب قيم أكبر للمباعدة
-        team2_x[i] = 700 + i * 80;
+// Builds the glyph cache and the vertex buffers once the GL context exists
+void init_renderer() {
+    for (int k = 0; k <= HEAD_SEGMENTS; k++) {
+        float theta = 2.0f * M_PI * k / HEAD_SEGMENTS;
+        head_circle[k][0] = cos(theta);
+        head_circle[k][1] = sin(theta);
+    }
+
+    void* font = GLUT_BITMAP_HELVETICA_18;
+    glyph_lists = glGenLists(256);
+    for (int c = 0; c < 256; c++) {
+        glyph_width[c] = c ? glutBitmapWidth(font, c) : 0;
+        glNewList(glyph_lists + c, GL_COMPILE);
+        if (c) glutBitmapCharacter(font, c);
+        glEndList();
     }
 
-    // Open pipes for communication with players
-    for (int i = 0; i < 8; i++) {
-        char pipe_name[50];
-        sprintf(pipe_name, "/tmp/player_pipe_%d", i);
-        player_read_pipes[i] = open(pipe_name, O_RDONLY);
-        if (player_read_pipes[i] < 0) {
-            perror("Failed to open player pipe");
+    glGenBuffers(1, &triangle_buffer);
+    glGenBuffers(1, &line_buffer);
+}
+
+// ##################################
+// Benchmark: renders frames with every player changing each frame (so the buffers are
+// rebuilt every time) and reports the frame time for 8, 100 and 1000 players. Needs an
+// X display; on a headless machine run it under Xvfb (software GL).
+// ##################################
+void run_benchmark(int frames) {
+    int counts[] = { 8, 100, 1000 };
+    printf("%8s %12s %10s\n", "players", "ms/frame", "fps");
+    for (int k = 0; k < 3; k++) {
+        layout_players(counts[k] / 2, 2);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int f = 0; f < frames; f++) {
+            for (int i = 0; i < num_players; i++) {
+                store.energy[i] = (i * 7 + f) % 100;
+                store.position[i] = i % team_size + 1;
+            }
+            current_round = f;
+            update_display();
+            display();
+            glFinish();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ms = ((end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6) / frames;
+        printf("%8d %12.3f %10.1f\n", num_players, ms, 1000 / ms);
+    }
+}
+
+// Main function
+int main(int argc, char** argv) {
+    int bench_frames = 0;
+
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        // Benchmark mode sets up its own layouts
+        bench_frames = (argc >= 3) ? atoi(argv[2]) : 300;
+        if (bench_frames <= 0) bench_frames = 300;
+    } else if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+        // Replay mode reads the team layout from the recording
+        if (replay_open(&replay, argv[2]) < 0) {
+            perror("Failed to open recording");
+            exit(EXIT_FAILURE);
+        }
+        if (replay.num_frames == 0) {
+            fprintf(stderr, "Error: Recording has no ticks\n");
             exit(EXIT_FAILURE);
         }
+        replaying = 1;
+        team_size = replay.header->config.team_size;
+        num_teams = replay.header->config.num_teams;
+        if (argc >= 4) replay_speed = atof(argv[3]);
+        if (replay_speed <= 0) replay_speed = 1.0f;
+    } else if (argc == 2) {
+        // Live mode: the referee passes the name of its state bus, which holds the team layout
+        if (state_bus_open(&bus, argv[1]) < 0) {
+            perror("Failed to open state bus");
+            exit(EXIT_FAILURE);
+        }
+        team_size = bus.header->team_size;
+        num_teams = bus.header->num_teams;
+        bus_reader_init(&bus_reader, &bus);
+        if (trace_start("visual") < 0) perror("Failed to start tracing");
+    } else {
+        fprintf(stderr, "Usage: %s <state_bus> | replay <recording> [speed] | bench [frames]\n", argv[0]);
+        exit(EXIT_FAILURE);
     }
+    layout_players(team_size, num_teams);
+    bus_stats = malloc(num_players * sizeof(PlayerStats));
 
     // Initialize GLUT
     glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB); // Single buffer mode with RGB colors
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB); // Double buffered, RGB colors
     glutInitWindowSize(1000, 700); // Window size
     glutInitWindowPosition(100, 100); // Window position
     glutCreateWindow("Rope Pulling Game"); // Create the window
 
     gluOrtho2D(0, 1000, 0, 700); // Set orthographic projection
     glClearColor(1, 1, 1, 1); // Set background color to white
+    init_renderer();
+
+    if (bench_frames) {
+        run_benchmark(bench_frames);
+        return 0;
+    }
+
     glutDisplayFunc(display); // Set display function
 
-    glutTimerFunc(1000, simulate_round, 0); // Start the first round
+    if (replaying) {
+        glutKeyboardFunc(replay_keys);
+        glutTimerFunc(0, replay_timer, 0);
+    } else {
+        glutTimerFunc(0, bus_timer, 0);
+    }
     glutMainLoop(); // Enter the main loop
 
-    // Close pipes
-    for (int i = 0; i < 8; i++) {
-        close(player_read_pipes[i]);
-    }
+    if (replaying) replay_close(&replay);
+    else state_bus_close(&bus);
 
     return 0;
 }